@@ -167,6 +167,7 @@ static int restore_tty;
 
 #if HAVE_THREADS
 static void free_input_threads(void);
+static void free_output_threads(void);
 #endif
 
 /* sub2video hack:
@@ -521,6 +522,10 @@ static void ffmpeg_cleanup(int ret)
         av_log(NULL, AV_LOG_INFO, "bench: maxrss=%ikB\n", maxrss);
     }
 
+#if HAVE_THREADS
+    free_output_threads();
+#endif
+
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
         avfilter_graph_free(&fg->graph);
@@ -653,6 +658,7 @@ static void ffmpeg_cleanup(int ret)
                    av_err2str(AVERROR(errno)));
     }
     av_freep(&vstats_filename);
+    av_freep(&filter_thread_type);
 
     av_freep(&input_streams);
     av_freep(&input_files);
@@ -717,19 +723,47 @@ static void update_benchmark(const char *fmt, ...)
     }
 }
 
+static int64_t stage_clock(void)
+{
+    return progress_json ? av_gettime_relative() : 0;
+}
+
+static void stage_stats_add(StageStats *st, int64_t time)
+{
+    if (!progress_json)
+        return;
+
+    st->nb_samples++;
+    st->time_total += time;
+    st->time_max    = FFMAX(st->time_max, time);
+    st->time_hist[FFMIN(av_log2(av_clip64(time, 1, INT_MAX)), STAGE_HIST_SIZE - 1)]++;
+}
+
+static void stage_stats_queue(StageStats *st, int depth)
+{
+    if (!progress_json)
+        return;
+
+    st->has_queue   = 1;
+    st->queue_depth = depth;
+    st->queue_max   = FFMAX(st->queue_max, depth);
+    st->queue_hist[depth > 0 ? FFMIN(av_log2(depth) + 1, STAGE_QUEUE_HIST_SIZE - 1) : 0]++;
+}
+
 static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream, OSTFinished others)
 {
     int i;
     for (i = 0; i < nb_output_streams; i++) {
         OutputStream *ost2 = output_streams[i];
-        ost2->finished |= ost == ost2 ? this_stream : others;
+        atomic_fetch_or(&ost2->finished, ost == ost2 ? this_stream : others);
     }
 }
 
-static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int unqueue)
+static int write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int unqueue)
 {
     AVFormatContext *s = of->ctx;
     AVStream *st = ost->st;
+    int64_t mux_start;
     int ret;
 
     /*
@@ -743,7 +777,7 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
     if (!(st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && ost->encoding_needed) && !unqueue) {
         if (ost->frame_number >= ost->max_frames) {
             av_packet_unref(pkt);
-            return;
+            return 0;
         }
         ost->frame_number++;
     }
@@ -763,22 +797,29 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
                 av_log(NULL, AV_LOG_ERROR,
                        "Too many packets buffered for output stream %d:%d.\n",
                        ost->file_index, ost->st->index);
-                exit_program(1);
+                ret = AVERROR(ENOSPC);
+                goto fail;
             }
             ret = av_fifo_realloc2(ost->muxing_queue, new_size);
             if (ret < 0)
-                exit_program(1);
+                goto fail;
         }
+        if (!pkt->buf)
+            ost->packets_copied++;
         ret = av_packet_make_refcounted(pkt);
         if (ret < 0)
-            exit_program(1);
+            goto fail;
         tmp_pkt = av_packet_alloc();
-        if (!tmp_pkt)
-            exit_program(1);
+        if (!tmp_pkt) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
         av_packet_move_ref(tmp_pkt, pkt);
         ost->muxing_queue_data_size += tmp_pkt->size;
         av_fifo_generic_write(ost->muxing_queue, &tmp_pkt, sizeof(tmp_pkt), NULL);
-        return;
+        stage_stats_queue(&ost->stage_stats[STAGE_MUX],
+                          av_fifo_size(ost->muxing_queue) / sizeof(tmp_pkt));
+        return 0;
     }
 
     if ((st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && video_sync_method == VSYNC_DROP) ||
@@ -835,7 +876,8 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
                        ost->file_index, ost->st->index, ost->last_mux_dts, pkt->dts);
                 if (exit_on_error) {
                     av_log(NULL, AV_LOG_FATAL, "aborting.\n");
-                    exit_program(1);
+                    ret = AVERROR(EINVAL);
+                    goto fail;
                 }
                 av_log(s, loglevel, "changing to %"PRId64". This may result "
                        "in incorrect timestamps in the output file.\n",
@@ -863,20 +905,27 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
               );
     }
 
+    mux_start = stage_clock();
     ret = av_interleaved_write_frame(s, pkt);
+    stage_stats_add(&ost->stage_stats[STAGE_MUX], stage_clock() - mux_start);
     if (ret < 0) {
         print_error("av_interleaved_write_frame()", ret);
         main_return_code = 1;
         close_all_output_streams(ost, MUXER_FINISHED | ENCODER_FINISHED, ENCODER_FINISHED);
     }
     av_packet_unref(pkt);
+    return 0;
+
+fail:
+    av_packet_unref(pkt);
+    return ret;
 }
 
 static void close_output_stream(OutputStream *ost)
 {
     OutputFile *of = output_files[ost->file_index];
 
-    ost->finished |= ENCODER_FINISHED;
+    atomic_fetch_or(&ost->finished, ENCODER_FINISHED);
     if (of->shortest) {
         int64_t end = av_rescale_q(ost->sync_opts - ost->first_pts, ost->enc_ctx->time_base, AV_TIME_BASE_Q);
         of->recording_time = FFMIN(of->recording_time, end);
@@ -893,9 +942,12 @@ static void close_output_stream(OutputStream *ost)
  * If eof is set, instead indicate EOF to all bitstream filters and
  * therefore flush any delayed packets to the output.  A blank packet
  * must be supplied in this case.
+ *
+ * Return a negative error code if the transcoding must be aborted. This is
+ * left to the caller, as this may run on the muxing thread of the file.
  */
-static void output_packet(OutputFile *of, AVPacket *pkt,
-                          OutputStream *ost, int eof)
+static int output_packet(OutputFile *of, AVPacket *pkt,
+                         OutputStream *ost, int eof)
 {
     int ret = 0;
 
@@ -905,19 +957,21 @@ static void output_packet(OutputFile *of, AVPacket *pkt,
         if (ret < 0)
             goto finish;
         while ((ret = av_bsf_receive_packet(ost->bsf_ctx, pkt)) >= 0)
-            write_packet(of, pkt, ost, 0);
+            if ((ret = write_packet(of, pkt, ost, 0)) < 0)
+                return ret;
         if (ret == AVERROR(EAGAIN))
             ret = 0;
     } else if (!eof)
-        write_packet(of, pkt, ost, 0);
+        return write_packet(of, pkt, ost, 0);
 
 finish:
     if (ret < 0 && ret != AVERROR_EOF) {
         av_log(NULL, AV_LOG_ERROR, "Error applying bitstream filters to an output "
                "packet for stream #%d:%d.\n", ost->file_index, ost->index);
         if(exit_on_error)
-            exit_program(1);
+            return ret;
     }
+    return 0;
 }
 
 static int check_recording_time(OutputStream *ost)
@@ -1001,11 +1055,354 @@ static int init_output_stream_wrapper(OutputStream *ost, AVFrame *frame,
     return ret;
 }
 
+static void mux_lock(OutputFile *of)
+{
+#if HAVE_THREADS
+    if (of->mux_thread_running)
+        pthread_mutex_lock(&of->mux_lock);
+#endif
+}
+
+static void mux_unlock(OutputFile *of)
+{
+#if HAVE_THREADS
+    if (of->mux_thread_running)
+        pthread_mutex_unlock(&of->mux_lock);
+#endif
+}
+
+#if HAVE_THREADS
+typedef struct MuxMessage {
+    OutputStream *ost;
+    /* encoded packet in the encoder time base, NULL signals the end of the stream */
+    AVPacket *pkt;
+} MuxMessage;
+
+static void mux_message_free(void *msg)
+{
+    av_packet_free(&((MuxMessage *)msg)->pkt);
+}
+
+static void enc_message_free(void *msg)
+{
+    av_frame_free((AVFrame **)msg);
+}
+
+static void *mux_thread(void *arg)
+{
+    OutputFile *of = arg;
+    AVPacket *eof_pkt = av_packet_alloc();
+    MuxMessage msg;
+    int ret = eof_pkt ? 0 : AVERROR(ENOMEM);
+
+    while (ret >= 0) {
+        OutputStream *ost;
+
+        ret = av_thread_message_queue_recv(of->mux_queue, &msg, 0);
+        if (ret < 0)
+            break;
+        ost = msg.ost;
+
+        /* the muxing time base may still change until the header is written,
+         * so the packets are only rescaled once the muxer lock is held */
+        pthread_mutex_lock(&of->mux_lock);
+        stage_stats_queue(&ost->stage_stats[STAGE_MUX],
+                          av_thread_message_queue_nb_elems(of->mux_queue));
+        if (!msg.pkt) {
+            ret = output_packet(of, eof_pkt, ost, 1);
+        } else if (!(atomic_load(&ost->finished) & MUXER_FINISHED)) {
+            av_packet_rescale_ts(msg.pkt, ost->enc_ctx->time_base, ost->mux_timebase);
+            ret = output_packet(of, msg.pkt, ost, 0);
+        }
+        pthread_mutex_unlock(&of->mux_lock);
+
+        av_packet_free(&msg.pkt);
+        /* exiting is left to the main thread, see check_mux_threads() */
+        if (ret < 0)
+            atomic_store(&of->mux_error, ret);
+    }
+
+    av_packet_free(&eof_pkt);
+    av_thread_message_queue_set_err_send(of->mux_queue, ret);
+
+    return (void *)(intptr_t)(ret == AVERROR_EOF ? 0 : ret);
+}
+
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    OutputFile    *of = output_files[ost->file_index];
+    AVCodecContext *enc = ost->enc_ctx;
+    AVPacket *pkt = ost->pkt;
+    const char *desc = av_get_media_type_string(enc->codec_type);
+    int ret = 0;
+
+    while (ret >= 0) {
+        AVFrame *frame;
+        int64_t pts, enc_time, t;
+        int eof;
+
+        ret = av_thread_message_queue_recv(ost->enc_queue, &frame, 0);
+        if (ret < 0)
+            break;
+
+        mux_lock(of);
+        stage_stats_queue(&ost->stage_stats[STAGE_ENCODE],
+                          av_thread_message_queue_nb_elems(ost->enc_queue));
+        mux_unlock(of);
+
+        eof = !frame;
+        pts = frame ? frame->pts : AV_NOPTS_VALUE;
+        if (frame && enc->codec_type == AVMEDIA_TYPE_VIDEO &&
+            !ost->frame_aspect_ratio.num)
+            enc->sample_aspect_ratio = frame->sample_aspect_ratio;
+
+        t = stage_clock();
+        ret = avcodec_send_frame(enc, frame);
+        enc_time = stage_clock() - t;
+        av_frame_free(&frame);
+
+        while (ret >= 0) {
+            MuxMessage msg = { ost };
+
+            av_packet_unref(pkt);
+            t = stage_clock();
+            ret = avcodec_receive_packet(enc, pkt);
+            enc_time += stage_clock() - t;
+            if (ret == AVERROR(EAGAIN)) {
+                ret = 0;
+                break;
+            }
+            if (ret < 0)
+                break;
+
+            if (ost->logfile && enc->stats_out)
+                fprintf(ost->logfile, "%s", enc->stats_out);
+
+            if (enc->codec_type == AVMEDIA_TYPE_VIDEO &&
+                pkt->pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+                pkt->pts = pts;
+
+            msg.pkt = av_packet_alloc();
+            if (!msg.pkt) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            av_packet_move_ref(msg.pkt, pkt);
+            ret = av_thread_message_queue_send(of->mux_queue, &msg, 0);
+            if (ret < 0)
+                av_packet_free(&msg.pkt);
+        }
+
+        if (!eof) {
+            mux_lock(of);
+            stage_stats_add(&ost->stage_stats[STAGE_ENCODE], enc_time);
+            mux_unlock(of);
+        }
+
+        if (ret == AVERROR_EOF && eof) {
+            MuxMessage msg = { ost, NULL };
+            ret = av_thread_message_queue_send(of->mux_queue, &msg, 0);
+            if (ret >= 0)
+                break;
+        }
+        /* a muxer thread failure has already been reported */
+        if (ret < 0 && ret != AVERROR_EOF && ret != AVERROR_EXIT &&
+            !atomic_load(&of->mux_error))
+            av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
+                   desc, av_err2str(ret));
+    }
+
+    av_thread_message_queue_set_err_send(ost->enc_queue, ret < 0 ? ret : AVERROR_EOF);
+
+    return (void *)(intptr_t)ret;
+}
+
+/*
+ * Return the error of a muxer thread that hit a fatal error. The muxer
+ * threads cannot exit the program themselves, so this is done by the main
+ * thread.
+ */
+static int check_mux_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_files; i++) {
+        int err = atomic_load(&output_files[i]->mux_error);
+        if (err < 0)
+            return err;
+    }
+    return 0;
+}
+
+static int init_encoder_thread(OutputStream *ost)
+{
+    int ret;
+
+    if (!ost->pkt && !(ost->pkt = av_packet_alloc()))
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_alloc(&ost->enc_queue, pipeline_queue_size,
+                                        sizeof(AVFrame *));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(ost->enc_queue, enc_message_free);
+
+    if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        av_thread_message_queue_free(&ost->enc_queue);
+        return AVERROR(ret);
+    }
+    ost->enc_thread_running = 1;
+
+    return 0;
+}
+
+/*
+ * Hand a frame over to the encoder thread of ost, starting the thread on
+ * first use. A NULL frame flushes the encoder and terminates the thread.
+ */
+static int encoder_thread_send(OutputStream *ost, AVFrame *frame)
+{
+    AVFrame *queue_frame = NULL;
+    int ret;
+
+    if (!ost->enc_thread_running && (ret = init_encoder_thread(ost)) < 0)
+        return ret;
+
+    if (frame && !(queue_frame = av_frame_clone(frame)))
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_send(ost->enc_queue, &queue_frame, 0);
+    if (ret < 0) {
+        av_frame_free(&queue_frame);
+        /* the encoder thread stopped because its muxer thread failed */
+        if (check_mux_threads() < 0)
+            exit_program(1);
+    }
+    return ret;
+}
+
+static int join_encoder_thread(OutputStream *ost)
+{
+    void *thread_ret;
+
+    if (!ost->enc_thread_running)
+        return 0;
+
+    pthread_join(ost->enc_thread, &thread_ret);
+    ost->enc_thread_running = 0;
+    av_thread_message_queue_free(&ost->enc_queue);
+
+    return (intptr_t)thread_ret;
+}
+
+static int init_mux_threads(void)
+{
+    int i, ret;
+
+    if (vstats_filename) {
+        av_log(NULL, AV_LOG_WARNING, "-vstats is not supported with "
+               "-pipeline_threads, encoding in the main thread\n");
+        pipeline_threads = 0;
+        return 0;
+    }
+    if (pipeline_queue_size <= 0) {
+        av_log(NULL, AV_LOG_ERROR, "Invalid pipeline queue size: %d\n",
+               pipeline_queue_size);
+        return AVERROR(EINVAL);
+    }
+
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+
+        ret = av_thread_message_queue_alloc(&of->mux_queue, pipeline_queue_size,
+                                            sizeof(MuxMessage));
+        if (ret < 0)
+            return ret;
+        av_thread_message_queue_set_free_func(of->mux_queue, mux_message_free);
+
+        if ((ret = pthread_mutex_init(&of->mux_lock, NULL))) {
+            av_thread_message_queue_free(&of->mux_queue);
+            return AVERROR(ret);
+        }
+
+        atomic_init(&of->mux_error, 0);
+        if ((ret = pthread_create(&of->mux_thread, NULL, mux_thread, of))) {
+            av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+            pthread_mutex_destroy(&of->mux_lock);
+            av_thread_message_queue_free(&of->mux_queue);
+            return AVERROR(ret);
+        }
+        of->mux_thread_running = 1;
+    }
+
+    return 0;
+}
+
+static int join_mux_thread(OutputFile *of)
+{
+    void *thread_ret;
+
+    if (!of->mux_thread_running)
+        return 0;
+
+    /* the thread drains the remaining packets before it sees the error */
+    av_thread_message_queue_set_err_recv(of->mux_queue, AVERROR_EOF);
+    pthread_join(of->mux_thread, &thread_ret);
+    of->mux_thread_running = 0;
+    pthread_mutex_destroy(&of->mux_lock);
+    av_thread_message_queue_free(&of->mux_queue);
+
+    return (intptr_t)thread_ret;
+}
+
+static int finish_mux_threads(void)
+{
+    int i, ret = 0;
+
+    for (i = 0; i < nb_output_files; i++) {
+        int err = join_mux_thread(output_files[i]);
+        if (err < 0)
+            ret = err;
+    }
+    return ret;
+}
+
+/* Abort all encoder and muxer threads, dropping whatever is still queued. */
+static void free_output_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+        if (of && of->mux_thread_running)
+            av_thread_message_queue_set_err_send(of->mux_queue, AVERROR_EXIT);
+    }
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+        if (!ost || !ost->enc_thread_running)
+            continue;
+        av_thread_message_queue_set_err_recv(ost->enc_queue, AVERROR_EXIT);
+        av_thread_message_flush(ost->enc_queue);
+        join_encoder_thread(ost);
+    }
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+        if (!of || !of->mux_thread_running)
+            continue;
+        av_thread_message_flush(of->mux_queue);
+        join_mux_thread(of);
+    }
+}
+#endif
+
 static void do_audio_out(OutputFile *of, OutputStream *ost,
                          AVFrame *frame)
 {
     AVCodecContext *enc = ost->enc_ctx;
     AVPacket *pkt = ost->pkt;
+    int64_t enc_time, t;
     int ret;
 
     adjust_frame_pts_to_encoder_tb(of, ost, frame);
@@ -1027,13 +1424,25 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
                enc->time_base.num, enc->time_base.den);
     }
 
+#if HAVE_THREADS
+    if (pipeline_threads) {
+        if (encoder_thread_send(ost, frame) < 0)
+            goto error;
+        return;
+    }
+#endif
+
+    t = stage_clock();
     ret = avcodec_send_frame(enc, frame);
+    enc_time = stage_clock() - t;
     if (ret < 0)
         goto error;
 
     while (1) {
         av_packet_unref(pkt);
+        t = stage_clock();
         ret = avcodec_receive_packet(enc, pkt);
+        enc_time += stage_clock() - t;
         if (ret == AVERROR(EAGAIN))
             break;
         if (ret < 0)
@@ -1050,8 +1459,10 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
                    av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &enc->time_base));
         }
 
-        output_packet(of, pkt, ost, 0);
+        if (output_packet(of, pkt, ost, 0) < 0)
+            exit_program(1);
     }
+    stage_stats_add(&ost->stage_stats[STAGE_ENCODE], enc_time);
 
     return;
 error:
@@ -1064,7 +1475,7 @@ static void do_subtitle_out(OutputFile *of,
                             AVSubtitle *sub)
 {
     int subtitle_out_max_size = 1024 * 1024;
-    int subtitle_out_size, nb, i;
+    int subtitle_out_size, nb, i, ret;
     AVCodecContext *enc;
     AVPacket *pkt = ost->pkt;
     int64_t pts;
@@ -1138,7 +1549,11 @@ static void do_subtitle_out(OutputFile *of,
                 pkt->pts += av_rescale_q(sub->end_display_time, (AVRational){ 1, 1000 }, ost->mux_timebase);
         }
         pkt->dts = pkt->pts;
-        output_packet(of, pkt, ost, 0);
+        mux_lock(of);
+        ret = output_packet(of, pkt, ost, 0);
+        mux_unlock(of);
+        if (ret < 0)
+            exit_program(1);
     }
 }
 
@@ -1293,6 +1708,7 @@ static void do_video_out(OutputFile *of,
         AVFrame *in_picture;
         int forced_keyframe = 0;
         double pts_time;
+        int64_t enc_time, t;
 
         if (i < nb0_frames && ost->last_frame) {
             in_picture = ost->last_frame;
@@ -1364,7 +1780,20 @@ static void do_video_out(OutputFile *of,
 
         ost->frames_encoded++;
 
+#if HAVE_THREADS
+        if (pipeline_threads) {
+            if (encoder_thread_send(ost, in_picture) < 0)
+                goto error;
+            av_frame_remove_side_data(in_picture, AV_FRAME_DATA_A53_CC);
+            ost->sync_opts++;
+            ost->frame_number++;
+            continue;
+        }
+#endif
+
+        t = stage_clock();
         ret = avcodec_send_frame(enc, in_picture);
+        enc_time = stage_clock() - t;
         if (ret < 0)
             goto error;
         // Make sure Closed Captions will not be duplicated
@@ -1372,7 +1801,9 @@ static void do_video_out(OutputFile *of,
 
         while (1) {
             av_packet_unref(pkt);
+            t = stage_clock();
             ret = avcodec_receive_packet(enc, pkt);
+            enc_time += stage_clock() - t;
             update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
             if (ret == AVERROR(EAGAIN))
                 break;
@@ -1399,13 +1830,15 @@ static void do_video_out(OutputFile *of,
             }
 
             frame_size = pkt->size;
-            output_packet(of, pkt, ost, 0);
+            if (output_packet(of, pkt, ost, 0) < 0)
+                exit_program(1);
 
             /* if two pass, output log */
             if (ost->logfile && enc->stats_out) {
                 fprintf(ost->logfile, "%s", enc->stats_out);
             }
         }
+        stage_stats_add(&ost->stage_stats[STAGE_ENCODE], enc_time);
         ost->sync_opts++;
         /*
          * For video, number of frames in == number of packets out.
@@ -1485,11 +1918,11 @@ static void finish_output_stream(OutputStream *ost)
     OutputFile *of = output_files[ost->file_index];
     int i;
 
-    ost->finished = ENCODER_FINISHED | MUXER_FINISHED;
+    atomic_store(&ost->finished, ENCODER_FINISHED | MUXER_FINISHED);
 
     if (of->shortest) {
         for (i = 0; i < of->ctx->nb_streams; i++)
-            output_streams[of->ost_index + i]->finished = ENCODER_FINISHED | MUXER_FINISHED;
+            atomic_store(&output_streams[of->ost_index + i]->finished, ENCODER_FINISHED | MUXER_FINISHED);
     }
 }
 
@@ -1549,14 +1982,15 @@ static int reap_filters(int flush)
                 }
                 break;
             }
-            if (ost->finished) {
+            if (atomic_load(&ost->finished)) {
                 av_frame_unref(filtered_frame);
                 continue;
             }
 
             switch (av_buffersink_get_type(filter)) {
             case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
+                /* with -pipeline_threads the encoder thread does this */
+                if (!ost->frame_aspect_ratio.num && !pipeline_threads)
                     enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
 
                 do_video_out(of, ost, filtered_frame);
@@ -1682,6 +2116,9 @@ static void print_final_stats(int64_t total_size)
 
             av_log(NULL, AV_LOG_VERBOSE, "%"PRIu64" packets muxed (%"PRIu64" bytes); ",
                    ost->packets_written, ost->data_size);
+            if (!ost->encoding_needed)
+                av_log(NULL, AV_LOG_VERBOSE, "%"PRIu64" packets copied; ",
+                       ost->packets_copied);
 
             av_log(NULL, AV_LOG_VERBOSE, "\n");
         }
@@ -1699,6 +2136,113 @@ static void print_final_stats(int64_t total_size)
     }
 }
 
+static void print_stage_stats_json(AVBPrint *bp, const char *name, const StageStats *st,
+                                   int *first)
+{
+    int i, nb_buckets = 0;
+
+    if (!st->nb_samples && !st->has_queue)
+        return;
+
+    for (i = 0; i < STAGE_HIST_SIZE; i++)
+        if (st->time_hist[i])
+            nb_buckets = i + 1;
+
+    av_bprintf(bp, "%s\"%s\":{\"count\":%"PRIu64",\"time_us\":%"PRId64
+               ",\"avg_us\":%.1f,\"max_us\":%"PRId64",\"hist\":[",
+               *first ? "" : ",", name, st->nb_samples, st->time_total,
+               st->nb_samples ? (double)st->time_total / st->nb_samples : 0.0,
+               st->time_max);
+    for (i = 0; i < nb_buckets; i++)
+        av_bprintf(bp, "%s%"PRIu64, i ? "," : "", st->time_hist[i]);
+    av_bprintf(bp, "]");
+    if (st->has_queue) {
+        nb_buckets = 0;
+        for (i = 0; i < STAGE_QUEUE_HIST_SIZE; i++)
+            if (st->queue_hist[i])
+                nb_buckets = i + 1;
+
+        av_bprintf(bp, ",\"queue\":%d,\"queue_max\":%d,\"queue_hist\":[",
+                   st->queue_depth, st->queue_max);
+        for (i = 0; i < nb_buckets; i++)
+            av_bprintf(bp, "%s%"PRIu64, i ? "," : "", st->queue_hist[i]);
+        av_bprintf(bp, "]");
+    }
+    av_bprintf(bp, "}");
+    *first = 0;
+}
+
+/*
+ * Write one line of JSON with the totals of print_report() and the per
+ * stream statistics of every pipeline stage to the progress URL.
+ */
+static void print_progress_json(AVBPrint *bp, int is_last_report, int64_t elapsed,
+                                int64_t total_size, int64_t pts,
+                                double bitrate, double speed)
+{
+    static const char *const stage_names[STAGE_NB] = {
+        [STAGE_DEMUX]  = "demux",
+        [STAGE_DECODE] = "decode",
+        [STAGE_FILTER] = "filter",
+        [STAGE_ENCODE] = "encode",
+        [STAGE_MUX]    = "mux",
+    };
+    int i, j, first;
+
+    av_bprintf(bp, "{\"progress\":\"%s\",\"elapsed_us\":%"PRId64,
+               is_last_report ? "end" : "continue", elapsed);
+    if (total_size < 0) av_bprintf(bp, ",\"total_size\":null");
+    else                av_bprintf(bp, ",\"total_size\":%"PRId64, total_size);
+    if (pts == AV_NOPTS_VALUE) av_bprintf(bp, ",\"out_time_us\":null");
+    else                       av_bprintf(bp, ",\"out_time_us\":%"PRId64, pts);
+    if (bitrate < 0) av_bprintf(bp, ",\"bitrate_kbps\":null");
+    else             av_bprintf(bp, ",\"bitrate_kbps\":%.1f", bitrate);
+    if (speed < 0) av_bprintf(bp, ",\"speed\":null");
+    else           av_bprintf(bp, ",\"speed\":%.3f", speed);
+    av_bprintf(bp, ",\"dup_frames\":%d,\"drop_frames\":%d",
+               nb_frames_dup, nb_frames_drop);
+
+    av_bprintf(bp, ",\"inputs\":[");
+    for (i = 0, first = 1; i < nb_input_streams; i++) {
+        InputStream *ist = input_streams[i];
+        int first_stage = 1;
+
+        if (ist->discard)
+            continue;
+        av_bprintf(bp, "%s{\"file\":%d,\"stream\":%d,\"type\":\"%s\""
+                   ",\"packets\":%"PRIu64",\"frames\":%"PRIu64",\"stages\":{",
+                   first ? "" : ",", ist->file_index, ist->st->index,
+                   av_get_media_type_string(ist->dec_ctx->codec_type) ?
+                   av_get_media_type_string(ist->dec_ctx->codec_type) : "unknown",
+                   ist->nb_packets, ist->frames_decoded);
+        for (j = STAGE_DEMUX; j <= STAGE_FILTER; j++)
+            print_stage_stats_json(bp, stage_names[j], &ist->stage_stats[j], &first_stage);
+        av_bprintf(bp, "}}");
+        first = 0;
+    }
+
+    av_bprintf(bp, "],\"outputs\":[");
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+        OutputFile    *of = output_files[ost->file_index];
+        int first_stage = 1;
+
+        mux_lock(of);
+        av_bprintf(bp, "%s{\"file\":%d,\"stream\":%d,\"type\":\"%s\""
+                   ",\"frames\":%"PRIu64",\"packets\":%"PRIu64
+                   ",\"copied_packets\":%"PRIu64",\"stages\":{",
+                   i ? "," : "", ost->file_index, ost->index,
+                   av_get_media_type_string(ost->enc_ctx->codec_type) ?
+                   av_get_media_type_string(ost->enc_ctx->codec_type) : "unknown",
+                   ost->frames_encoded, ost->packets_written, ost->packets_copied);
+        for (j = STAGE_ENCODE; j <= STAGE_MUX; j++)
+            print_stage_stats_json(bp, stage_names[j], &ost->stage_stats[j], &first_stage);
+        av_bprintf(bp, "}}");
+        mux_unlock(of);
+    }
+    av_bprintf(bp, "]}\n");
+}
+
 static void print_report(int is_last_report, int64_t timer_start, int64_t cur_time)
 {
     AVBPrint buf, buf_script;
@@ -1736,17 +2280,21 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
 
     oc = output_files[0]->ctx;
 
+    mux_lock(output_files[0]);
     total_size = avio_size(oc->pb);
     if (total_size <= 0) // FIXME improve avio_size() so it works with non seekable output too
         total_size = avio_tell(oc->pb);
+    mux_unlock(output_files[0]);
 
     vid = 0;
     av_bprint_init(&buf, 0, AV_BPRINT_SIZE_AUTOMATIC);
-    av_bprint_init(&buf_script, 0, AV_BPRINT_SIZE_AUTOMATIC);
+    av_bprint_init(&buf_script, 0, AV_BPRINT_SIZE_UNLIMITED);
     for (i = 0; i < nb_output_streams; i++) {
         float q = -1;
         ost = output_streams[i];
         enc = ost->enc_ctx;
+        /* the counters and quality stats are updated by the muxer thread */
+        mux_lock(output_files[ost->file_index]);
         if (!ost->stream_copy)
             q = ost->quality / (float) FF_QP2LAMBDA;
 
@@ -1822,6 +2370,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
 
         if (is_last_report)
             nb_frames_drop += ost->last_dropped;
+        mux_unlock(output_files[ost->file_index]);
     }
 
     secs = FFABS(pts) / AV_TIME_BASE;
@@ -1890,8 +2439,13 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     av_bprint_finalize(&buf, NULL);
 
     if (progress_avio) {
-        av_bprintf(&buf_script, "progress=%s\n",
-                   is_last_report ? "end" : "continue");
+        if (progress_json) {
+            av_bprint_clear(&buf_script);
+            print_progress_json(&buf_script, is_last_report, cur_time - timer_start,
+                                total_size, pts, bitrate, speed);
+        } else
+            av_bprintf(&buf_script, "progress=%s\n",
+                       is_last_report ? "end" : "continue");
         avio_write(progress_avio, buf_script.str,
                    FFMIN(buf_script.len, buf_script.size - 1));
         avio_flush(progress_avio);
@@ -1969,6 +2523,20 @@ static void flush_encoders(void)
         if (enc->codec_type != AVMEDIA_TYPE_VIDEO && enc->codec_type != AVMEDIA_TYPE_AUDIO)
             continue;
 
+#if HAVE_THREADS
+        if (pipeline_threads) {
+            ret = encoder_thread_send(ost, NULL);
+            if (ret >= 0)
+                ret = join_encoder_thread(ost);
+            if (ret < 0) {
+                av_log(NULL, AV_LOG_FATAL, "Flushing encoder of stream %d:%d failed: %s\n",
+                       ost->file_index, ost->index, av_err2str(ret));
+                exit_program(1);
+            }
+            continue;
+        }
+#endif
+
         for (;;) {
             const char *desc = NULL;
             AVPacket *pkt = ost->pkt;
@@ -2012,16 +2580,18 @@ static void flush_encoders(void)
                 fprintf(ost->logfile, "%s", enc->stats_out);
             }
             if (ret == AVERROR_EOF) {
-                output_packet(of, pkt, ost, 1);
+                if (output_packet(of, pkt, ost, 1) < 0)
+                    exit_program(1);
                 break;
             }
-            if (ost->finished & MUXER_FINISHED) {
+            if (atomic_load(&ost->finished) & MUXER_FINISHED) {
                 av_packet_unref(pkt);
                 continue;
             }
             av_packet_rescale_ts(pkt, enc->time_base, ost->mux_timebase);
             pkt_size = pkt->size;
-            output_packet(of, pkt, ost, 0);
+            if (output_packet(of, pkt, ost, 0) < 0)
+                exit_program(1);
             if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO && vstats_filename) {
                 do_video_stats(ost, pkt_size);
             }
@@ -2040,7 +2610,7 @@ static int check_output_constraints(InputStream *ist, OutputStream *ost)
     if (ost->source_index != ist_index)
         return 0;
 
-    if (ost->finished)
+    if (atomic_load(&ost->finished))
         return 0;
 
     if (of->start_time != AV_NOPTS_VALUE && ist->pts < of->start_time)
@@ -2056,11 +2626,16 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
     int64_t start_time = (of->start_time == AV_NOPTS_VALUE) ? 0 : of->start_time;
     int64_t ost_tb_start_time = av_rescale_q(start_time, AV_TIME_BASE_Q, ost->mux_timebase);
     AVPacket *opkt = ost->pkt;
+    int ret;
 
     av_packet_unref(opkt);
     // EOF: flush output bitstream filters.
     if (!pkt) {
-        output_packet(of, opkt, ost, 1);
+        mux_lock(of);
+        ret = output_packet(of, opkt, ost, 1);
+        mux_unlock(of);
+        if (ret < 0)
+            exit_program(1);
         return;
     }
 
@@ -2098,6 +2673,10 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
     if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO)
         ost->sync_opts++;
 
+    /* Packets from the demuxer are normally reference counted, so that only
+     * a new reference to the payload is created here. */
+    if (!pkt->buf)
+        ost->packets_copied++;
     if (av_packet_ref(opkt, pkt) < 0)
         exit_program(1);
 
@@ -2121,7 +2700,11 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
 
     opkt->duration = av_rescale_q(pkt->duration, ist->st->time_base, ost->mux_timebase);
 
-    output_packet(of, opkt, ost, 0);
+    mux_lock(of);
+    ret = output_packet(of, opkt, ost, 0);
+    mux_unlock(of);
+    if (ret < 0)
+        exit_program(1);
 }
 
 int guess_input_channel_layout(InputStream *ist)
@@ -2303,6 +2886,7 @@ static int decode(AVCodecContext *avctx, AVFrame *frame, int *got_frame, AVPacke
 
 static int send_frame_to_filters(InputStream *ist, AVFrame *decoded_frame)
 {
+    int64_t filter_start = stage_clock();
     int i, ret;
     AVFrame *f;
 
@@ -2324,6 +2908,7 @@ static int send_frame_to_filters(InputStream *ist, AVFrame *decoded_frame)
             break;
         }
     }
+    stage_stats_add(&ist->stage_stats[STAGE_FILTER], stage_clock() - filter_start);
     return ret;
 }
 
@@ -2333,6 +2918,7 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
     AVFrame *decoded_frame;
     AVCodecContext *avctx = ist->dec_ctx;
     int ret, err = 0;
+    int64_t decode_start;
     AVRational decoded_frame_tb;
 
     if (!ist->decoded_frame && !(ist->decoded_frame = av_frame_alloc()))
@@ -2342,7 +2928,9 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
     decoded_frame = ist->decoded_frame;
 
     update_benchmark(NULL);
+    decode_start = stage_clock();
     ret = decode(avctx, decoded_frame, got_output, pkt);
+    stage_stats_add(&ist->stage_stats[STAGE_DECODE], stage_clock() - decode_start);
     update_benchmark("decode_audio %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
@@ -2396,6 +2984,7 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
     int i, ret = 0, err = 0;
     int64_t best_effort_timestamp;
     int64_t dts = AV_NOPTS_VALUE;
+    int64_t decode_start;
 
     // With fate-indeo3-2, we're getting 0-sized packets before EOF for some
     // reason. This seems like a semi-critical bug. Don't trigger EOF, and
@@ -2425,7 +3014,9 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
     }
 
     update_benchmark(NULL);
+    decode_start = stage_clock();
     ret = decode(ist->dec_ctx, decoded_frame, got_output, pkt);
+    stage_stats_add(&ist->stage_stats[STAGE_DECODE], stage_clock() - decode_start);
     update_benchmark("decode_video %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
@@ -3037,8 +3628,10 @@ static int check_init_output_file(OutputFile *of, int file_index)
 
     of->ctx->interrupt_callback = int_cb;
 
+    mux_lock(of);
     ret = avformat_write_header(of->ctx, &of->opts);
     if (ret < 0) {
+        mux_unlock(of);
         av_log(NULL, AV_LOG_ERROR,
                "Could not write header for output file #%d "
                "(incorrect codec parameters ?): %s\n",
@@ -3066,10 +3659,15 @@ static int check_init_output_file(OutputFile *of, int file_index)
             AVPacket *pkt;
             av_fifo_generic_read(ost->muxing_queue, &pkt, sizeof(pkt), NULL);
             ost->muxing_queue_data_size -= pkt->size;
-            write_packet(of, pkt, ost, 1);
+            ret = write_packet(of, pkt, ost, 1);
             av_packet_free(&pkt);
+            if (ret < 0) {
+                mux_unlock(of);
+                return ret;
+            }
         }
     }
+    mux_unlock(of);
 
     return 0;
 }
@@ -3916,11 +4514,18 @@ static int need_output(void)
         OutputStream *ost    = output_streams[i];
         OutputFile *of       = output_files[ost->file_index];
         AVFormatContext *os  = output_files[ost->file_index]->ctx;
+        int finished, max_frames_reached;
 
-        if (ost->finished ||
-            (os->pb && avio_tell(os->pb) >= of->limit_filesize))
+        /* the muxer thread updates the counters and writes to os->pb */
+        mux_lock(of);
+        finished = atomic_load(&ost->finished) ||
+                   (os->pb && avio_tell(os->pb) >= of->limit_filesize);
+        max_frames_reached = ost->frame_number >= ost->max_frames;
+        mux_unlock(of);
+
+        if (finished)
             continue;
-        if (ost->frame_number >= ost->max_frames) {
+        if (max_frames_reached) {
             int j;
             for (j = 0; j < of->ctx->nb_streams; j++)
                 close_output_stream(output_streams[of->ost_index + j]);
@@ -3946,18 +4551,24 @@ static OutputStream *choose_output(void)
 
     for (i = 0; i < nb_output_streams; i++) {
         OutputStream *ost = output_streams[i];
-        int64_t opts = ost->st->cur_dts == AV_NOPTS_VALUE ? INT64_MIN :
-                       av_rescale_q(ost->st->cur_dts, ost->st->time_base,
-                                    AV_TIME_BASE_Q);
-        if (ost->st->cur_dts == AV_NOPTS_VALUE)
+        int64_t cur_dts, opts;
+
+        /* cur_dts is updated by the muxer thread */
+        mux_lock(output_files[ost->file_index]);
+        cur_dts = ost->st->cur_dts;
+        mux_unlock(output_files[ost->file_index]);
+
+        opts = cur_dts == AV_NOPTS_VALUE ? INT64_MIN :
+               av_rescale_q(cur_dts, ost->st->time_base, AV_TIME_BASE_Q);
+        if (cur_dts == AV_NOPTS_VALUE)
             av_log(NULL, AV_LOG_DEBUG,
                 "cur_dts is invalid st:%d (%d) [init:%d i_done:%d finish:%d] (this is harmless if it occurs once at the start per stream)\n",
-                ost->st->index, ost->st->id, ost->initialized, ost->inputs_done, ost->finished);
+                ost->st->index, ost->st->id, ost->initialized, ost->inputs_done, atomic_load(&ost->finished));
 
         if (!ost->initialized && !ost->inputs_done)
             return ost->unavailable ? NULL : ost;
 
-        if (!ost->finished && opts < opts_min) {
+        if (!atomic_load(&ost->finished) && opts < opts_min) {
             opts_min = opts;
             ost_min  = ost->unavailable ? NULL : ost;
         }
@@ -4344,9 +4955,11 @@ static int process_input(int file_index)
     int ret, thread_ret, i, j;
     int64_t duration;
     int64_t pkt_dts;
+    int64_t demux_start;
     int disable_discontinuity_correction = copy_ts;
 
     is  = ifile->ctx;
+    demux_start = stage_clock();
     ret = get_input_packet(ifile, &pkt);
 
     if (ret == AVERROR(EAGAIN)) {
@@ -4430,6 +5043,13 @@ static int process_input(int file_index)
     ist->data_size += pkt->size;
     ist->nb_packets++;
 
+    stage_stats_add(&ist->stage_stats[STAGE_DEMUX], stage_clock() - demux_start);
+#if HAVE_THREADS
+    if (ifile->thread_queue_size)
+        stage_stats_queue(&ist->stage_stats[STAGE_DEMUX],
+                          av_thread_message_queue_nb_elems(ifile->in_thread_queue));
+#endif
+
     if (ist->discard)
         goto discard_packet;
 
@@ -4786,6 +5406,13 @@ static int transcode(void)
 #if HAVE_THREADS
     if ((ret = init_input_threads()) < 0)
         goto fail;
+    if (pipeline_threads && (ret = init_mux_threads()) < 0)
+        goto fail;
+#else
+    if (pipeline_threads) {
+        av_log(NULL, AV_LOG_WARNING, "-pipeline_threads requires thread support, ignoring\n");
+        pipeline_threads = 0;
+    }
 #endif
 
     while (!received_sigterm) {
@@ -4807,6 +5434,10 @@ static int transcode(void)
             av_log(NULL, AV_LOG_ERROR, "Error while filtering: %s\n", av_err2str(ret));
             break;
         }
+#if HAVE_THREADS
+        if ((ret = check_mux_threads()) < 0)
+            goto fail;
+#endif
 
         /* dump report by using the output first video and audio streams */
         print_report(0, timer_start, cur_time);
@@ -4823,6 +5454,10 @@ static int transcode(void)
         }
     }
     flush_encoders();
+#if HAVE_THREADS
+    if ((ret = finish_mux_threads()) < 0)
+        goto fail;
+#endif
 
     term_exit();
 
@@ -4882,6 +5517,7 @@ static int transcode(void)
  fail:
 #if HAVE_THREADS
     free_input_threads();
+    free_output_threads();
 #endif
 
     if (output_streams) {
@@ -21,6 +21,7 @@
 
 #include "config.h"
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <signal.h>
@@ -297,6 +298,32 @@ typedef struct FilterGraph {
     int         nb_outputs;
 } FilterGraph;
 
+enum StageID {
+    STAGE_DEMUX,
+    STAGE_DECODE,
+    STAGE_FILTER,
+    STAGE_ENCODE,
+    STAGE_MUX,
+    STAGE_NB
+};
+
+#define STAGE_HIST_SIZE 24
+#define STAGE_QUEUE_HIST_SIZE 16
+
+/* processing statistics of one pipeline stage of a stream, only collected
+ * for -progress_format json */
+typedef struct StageStats {
+    uint64_t nb_samples;
+    int64_t  time_total;                 ///< time spent in the stage in microseconds
+    int64_t  time_max;
+    uint64_t time_hist[STAGE_HIST_SIZE]; ///< time per sample, bucket n counts [2^n, 2^(n+1)) microseconds
+    int      has_queue;                  ///< the stage is fed through a queue
+    int      queue_depth;                ///< queue depth at the last sample
+    int      queue_max;
+    uint64_t queue_hist[STAGE_QUEUE_HIST_SIZE]; ///< queue depth per sample, bucket 0 counts an empty
+                                                ///< queue and bucket n > 0 counts [2^(n-1), 2^n) items
+} StageStats;
+
 typedef struct InputStream {
     int file_index;
     AVStream *st;
@@ -395,6 +422,8 @@ typedef struct InputStream {
     int nb_dts_buffer;
 
     int got_output;
+
+    StageStats stage_stats[STAGE_NB];
 } InputStream;
 
 typedef struct InputFile {
@@ -521,7 +550,8 @@ typedef struct OutputStream {
     AVDictionary *swr_opts;
     AVDictionary *resample_opts;
     char *apad;
-    OSTFinished finished;        /* no more packets should be written for this stream */
+    atomic_int finished;         /* OSTFinished flags, no more packets should be written for this stream;
+                                    also set by the muxing threads of -pipeline_threads */
     int unavailable;                     /* true if the steram is unavailable (possibly temporarily) */
     int stream_copy;
 
@@ -544,6 +574,9 @@ typedef struct OutputStream {
     uint64_t data_size;
     // number of packets send to the muxer
     uint64_t packets_written;
+    // number of packets whose payload had to be copied on the way to the
+    // muxer because it was not reference counted
+    uint64_t packets_copied;
     // number of frames/samples sent to the encoder
     uint64_t frames_encoded;
     uint64_t samples_encoded;
@@ -570,6 +603,14 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+    StageStats stage_stats[STAGE_NB];
+
+#if HAVE_THREADS
+    AVThreadMessageQueue *enc_queue;    /* frames waiting for the encoder thread */
+    pthread_t enc_thread;               /* thread encoding this stream */
+    int enc_thread_running;             /* the encoder thread has been started and not joined */
+#endif
 } OutputStream;
 
 typedef struct OutputFile {
@@ -583,6 +624,14 @@ typedef struct OutputFile {
     int shortest;
 
     int header_written;
+
+#if HAVE_THREADS
+    AVThreadMessageQueue *mux_queue;    /* encoded packets waiting for the muxer thread */
+    pthread_t mux_thread;               /* thread writing packets to this file */
+    pthread_mutex_t mux_lock;           /* serializes access to the muxer */
+    int mux_thread_running;             /* the muxer thread has been started and not joined */
+    atomic_int mux_error;               /* fatal error of the muxer thread, handled by the main thread */
+#endif
 } OutputFile;
 
 extern InputStream **input_streams;
@@ -626,13 +675,18 @@ extern int qp_hist;
 extern int stdin_interaction;
 extern int frame_bits_per_raw_sample;
 extern AVIOContext *progress_avio;
+extern int progress_json;
 extern float max_error_rate;
 extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern char *filter_thread_type;
 extern int vstats_version;
 extern int auto_conversion_filters;
+extern int pipeline_threads;
+extern int pipeline_queue_size;
+extern int filter_sharing;
 
 extern const AVIOInterruptCB int_cb;
 
@@ -658,6 +712,7 @@ int configure_filtergraph(FilterGraph *fg);
 void check_filter_outputs(void);
 int filtergraph_is_simple(FilterGraph *fg);
 int init_simple_filtergraph(InputStream *ist, OutputStream *ost);
+int share_simple_filtergraph(OutputStream *ost);
 int init_complex_filtergraph(FilterGraph *fg);
 
 void sub2video_update(InputStream *ist, int64_t heartbeat_pts, AVSubtitle *sub);
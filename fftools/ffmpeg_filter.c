@@ -210,6 +210,114 @@ int init_simple_filtergraph(InputStream *ist, OutputStream *ost)
     return 0;
 }
 
+static int dicts_equal(const AVDictionary *a, const AVDictionary *b)
+{
+    char *sa = NULL, *sb = NULL;
+    int ret;
+
+    if (av_dict_get_string(a, &sa, '=', ':') < 0 ||
+        av_dict_get_string(b, &sb, '=', ':') < 0)
+        exit_program(1);
+    ret = !strcmp(sa, sb);
+    av_free(sa);
+    av_free(sb);
+    return ret;
+}
+
+static int pix_fmt_lists_equal(const int *a, const int *b)
+{
+    if (!a || !b)
+        return a == b;
+    for (; *a != AV_PIX_FMT_NONE && *a == *b; a++, b++)
+        ;
+    return *a == *b;
+}
+
+static int encoder_supports_pix_fmt(const AVCodec *codec, enum AVPixelFormat pix_fmt)
+{
+    const enum AVPixelFormat *p;
+
+    if (!codec || !codec->pix_fmts)
+        return 1;
+    for (p = codec->pix_fmts; *p != AV_PIX_FMT_NONE; p++)
+        if (*p == pix_fmt)
+            return 1;
+    return 0;
+}
+
+/* Check whether the simple filtergraphs feeding a and b produce identical frames. */
+static int simple_filtergraph_output_equal(OutputStream *a, OutputStream *b)
+{
+    OutputFilter *fa = a->filter, *fb = b->filter;
+    AVDictionaryEntry *sa = av_dict_get(a->encoder_opts, "strict", NULL, 0);
+    AVDictionaryEntry *sb = av_dict_get(b->encoder_opts, "strict", NULL, 0);
+
+    if (a->source_index != b->source_index            ||
+        strcmp(a->avfilter, b->avfilter)              ||
+        fa->width  != fb->width                       ||
+        fa->height != fb->height                      ||
+        fa->format != fb->format                      ||
+        a->keep_pix_fmt != b->keep_pix_fmt            ||
+        a->autoscale    != b->autoscale               ||
+        !dicts_equal(a->sws_dict, b->sws_dict))
+        return 0;
+
+    /* an explicitly requested pixel format is only replaced if the
+     * encoder cannot handle it, otherwise the encoders must agree */
+    if (fa->format != AV_PIX_FMT_NONE &&
+        encoder_supports_pix_fmt(a->enc, fa->format) &&
+        encoder_supports_pix_fmt(b->enc, fb->format))
+        return 1;
+
+    return a->enc == b->enc &&
+           pix_fmt_lists_equal(fa->formats, fb->formats) &&
+           !strcmp(sa ? sa->value : "", sb ? sb->value : "");
+}
+
+int share_simple_filtergraph(OutputStream *ost)
+{
+    FilterGraph *fg = ost->filter->graph, *shared = NULL;
+    InputStream *ist = fg->inputs[0]->ist;
+    int i;
+
+    if (!filtergraph_is_simple(fg) ||
+        ost->enc_ctx->codec_type != AVMEDIA_TYPE_VIDEO ||
+        ist->dec_ctx->codec_type != AVMEDIA_TYPE_VIDEO)
+        return 0;
+
+    for (i = 0; i < ist->nb_filters && !shared; i++) {
+        FilterGraph *cand = ist->filters[i]->graph;
+        if (cand != fg && filtergraph_is_simple(cand) &&
+            simple_filtergraph_output_equal(cand->outputs[0]->ost, ost))
+            shared = cand;
+    }
+    if (!shared)
+        return 0;
+
+    /* the graph of ost was the last one created, drop it and hand its
+     * output over to the shared graph */
+    av_assert0(filtergraphs[nb_filtergraphs - 1] == fg &&
+               ist->filters[ist->nb_filters - 1] == fg->inputs[0]);
+    nb_filtergraphs--;
+    ist->nb_filters--;
+
+    GROW_ARRAY(shared->outputs, shared->nb_outputs);
+    shared->outputs[shared->nb_outputs - 1] = ost->filter;
+    ost->filter->graph = shared;
+
+    av_fifo_freep(&fg->inputs[0]->frame_queue);
+    av_freep(&fg->inputs[0]);
+    av_freep(&fg->inputs);
+    av_freep(&fg->outputs);
+    av_freep(&fg);
+
+    av_log(NULL, AV_LOG_VERBOSE, "Output stream #%d:%d shares the filtergraph of "
+           "output stream #%d:%d\n", ost->file_index, ost->index,
+           shared->outputs[0]->ost->file_index, shared->outputs[0]->ost->index);
+
+    return 1;
+}
+
 static char *describe_filter_link(FilterGraph *fg, AVFilterInOut *inout, int in)
 {
     AVFilterContext *ctx = inout->filter_ctx;
@@ -437,16 +545,23 @@ static int configure_output_video_filter(FilterGraph *fg, OutputFilter *ofilter,
     OutputFile    *of = output_files[ost->file_index];
     AVFilterContext *last_filter = out->filter_ctx;
     int pad_idx = out->pad_idx;
-    int ret;
+    int i, ret;
     char name[255];
+    int shared = filtergraph_is_simple(fg) && fg->nb_outputs > 1;
 
-    snprintf(name, sizeof(name), "out_%d_%d", ost->file_index, ost->index);
-    ret = avfilter_graph_create_filter(&ofilter->filter,
-                                       avfilter_get_by_name("buffersink"),
-                                       name, NULL, NULL, fg->graph);
+    /* a simple filtergraph with several outputs feeds output streams which
+     * all need the same frames, so one conversion chain is split to all */
+    for (i = 0; i < (shared ? fg->nb_outputs : 1); i++) {
+        OutputFilter *o = shared ? fg->outputs[i] : ofilter;
 
-    if (ret < 0)
-        return ret;
+        snprintf(name, sizeof(name), "out_%d_%d", o->ost->file_index, o->ost->index);
+        ret = avfilter_graph_create_filter(&o->filter,
+                                           avfilter_get_by_name("buffersink"),
+                                           name, NULL, NULL, fg->graph);
+
+        if (ret < 0)
+            return ret;
+    }
 
     if ((ofilter->width || ofilter->height) && ofilter->ost->autoscale) {
         char args[255];
@@ -510,6 +625,41 @@ static int configure_output_video_filter(FilterGraph *fg, OutputFilter *ofilter,
         pad_idx = 0;
     }
 
+    if (shared) {
+        AVFilterContext *split;
+        char args[16];
+
+        snprintf(name, sizeof(name), "split_out_%d_%d",
+                 ost->file_index, ost->index);
+        snprintf(args, sizeof(args), "%d", fg->nb_outputs);
+        ret = avfilter_graph_create_filter(&split, avfilter_get_by_name("split"),
+                                           name, args, NULL, fg->graph);
+        if (ret < 0)
+            return ret;
+        if ((ret = avfilter_link(last_filter, pad_idx, split, 0)) < 0)
+            return ret;
+
+        for (i = 0; i < fg->nb_outputs; i++) {
+            OutputStream *o = fg->outputs[i]->ost;
+
+            of          = output_files[o->file_index];
+            last_filter = split;
+            pad_idx     = i;
+
+            snprintf(name, sizeof(name), "trim_out_%d_%d",
+                     o->file_index, o->index);
+            ret = insert_trim(of->start_time, of->recording_time,
+                              &last_filter, &pad_idx, name);
+            if (ret < 0)
+                return ret;
+
+            if ((ret = avfilter_link(last_filter, pad_idx, fg->outputs[i]->filter, 0)) < 0)
+                return ret;
+        }
+
+        return 0;
+    }
+
     snprintf(name, sizeof(name), "trim_out_%d_%d",
              ost->file_index, ost->index);
     ret = insert_trim(of->start_time, of->recording_time,
@@ -983,7 +1133,7 @@ static void cleanup_filtergraph(FilterGraph *fg)
 int configure_filtergraph(FilterGraph *fg)
 {
     AVFilterInOut *inputs, *outputs, *cur;
-    int ret, i, simple = filtergraph_is_simple(fg);
+    int ret, i, threads_set, simple = filtergraph_is_simple(fg);
     const char *graph_desc = simple ? fg->outputs[0]->ost->avfilter :
                                       fg->graph_desc;
 
@@ -991,6 +1141,13 @@ int configure_filtergraph(FilterGraph *fg)
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
 
+    if (filter_thread_type &&
+        (ret = av_opt_set(fg->graph, "thread_type", filter_thread_type, 0)) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Invalid filter thread type '%s'\n",
+               filter_thread_type);
+        goto fail;
+    }
+
     if (simple) {
         OutputStream *ost = fg->outputs[0]->ost;
         char args[512];
@@ -1024,9 +1181,20 @@ int configure_filtergraph(FilterGraph *fg)
         if (strlen(args))
             args[strlen(args) - 1] = '\0';
 
-        e = av_dict_get(ost->encoder_opts, "threads", NULL, 0);
-        if (e)
+        /* a graph shared by several outputs (-filter_sharing) runs with the
+         * most threads any of their encoders asks for, 0 (auto) included */
+        for (i = 0, threads_set = 0; i < fg->nb_outputs; i++) {
+            int nb_threads = fg->graph->nb_threads;
+
+            e = av_dict_get(fg->outputs[i]->ost->encoder_opts, "threads", NULL, 0);
+            if (!e)
+                continue;
             av_opt_set(fg->graph, "threads", e->value, 0);
+            if (threads_set && (!nb_threads ||
+                                (fg->graph->nb_threads && fg->graph->nb_threads < nb_threads)))
+                fg->graph->nb_threads = nb_threads;
+            threads_set = 1;
+        }
     } else {
         fg->graph->nb_threads = filter_complex_nbthreads;
     }
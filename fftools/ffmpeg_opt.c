@@ -34,6 +34,7 @@
 #include "libavutil/avstring.h"
 #include "libavutil/avutil.h"
 #include "libavutil/channel_layout.h"
+#include "libavutil/cpu.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/fifo.h"
 #include "libavutil/mathematics.h"
@@ -173,9 +174,14 @@ int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
 int filter_nbthreads = 0;
 int filter_complex_nbthreads = 0;
+char *filter_thread_type = NULL;
 int vstats_version = 2;
 int auto_conversion_filters = 1;
 int64_t stats_period = 500000;
+int pipeline_threads = 0;
+int pipeline_queue_size = 8;
+int filter_sharing = 0;
+int progress_json = 0;
 
 
 static int intra_only         = 0;
@@ -2001,7 +2007,7 @@ static OutputStream *new_attachment_stream(OptionsContext *o, AVFormatContext *o
 {
     OutputStream *ost = new_output_stream(o, oc, AVMEDIA_TYPE_ATTACHMENT, source_index);
     ost->stream_copy = 1;
-    ost->finished    = 1;
+    atomic_store(&ost->finished, 1);
     return ost;
 }
 
@@ -2581,6 +2587,9 @@ loop_end:
                 }
                 break;
             }
+
+            if (filter_sharing)
+                share_simple_filtergraph(ost);
         }
     }
 
@@ -3423,6 +3432,32 @@ static int opt_progress(void *optctx, const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_progress_format(void *optctx, const char *opt, const char *arg)
+{
+    if (!strcmp(arg, "kv")) {
+        progress_json = 0;
+    } else if (!strcmp(arg, "json")) {
+        progress_json = 1;
+    } else {
+        av_log(NULL, AV_LOG_ERROR, "Invalid progress format '%s', "
+               "expected 'kv' or 'json'.\n", arg);
+        return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
+static int opt_shared_threads(void *optctx, const char *opt, const char *arg)
+{
+    int ret = av_set_shared_thread_pool(parse_number_or_die(opt, arg, OPT_INT, 0, INT_MAX));
+
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Failed to create the shared thread pool: %s\n",
+               av_err2str(ret));
+        return ret;
+    }
+    return 0;
+}
+
 #define OFFSET(x) offsetof(OptionsContext, x)
 const OptionDef options[] = {
     /* main options */
@@ -3501,6 +3536,8 @@ const OptionDef options[] = {
       "add timings for each task" },
     { "progress",       HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_progress },
       "write program-readable progress information", "url" },
+    { "progress_format", HAS_ARG | OPT_EXPERT,                       { .func_arg = opt_progress_format },
+      "set the format of the progress information (kv or json)", "format" },
     { "stdin",          OPT_BOOL | OPT_EXPERT,                       { &stdin_interaction },
       "enable or disable interaction on standard input" },
     { "timelimit",      HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_timelimit },
@@ -3568,6 +3605,8 @@ const OptionDef options[] = {
         "set stream filtergraph", "filter_graph" },
     { "filter_threads",  HAS_ARG | OPT_INT,                          { &filter_nbthreads },
         "number of non-complex filter threads" },
+    { "filter_sharing",  OPT_BOOL | OPT_EXPERT,                      { &filter_sharing },
+        "share one filtergraph between video outputs which need identical frames" },
     { "filter_script",  HAS_ARG | OPT_STRING | OPT_SPEC | OPT_OUTPUT, { .off = OFFSET(filter_scripts) },
         "read stream filtergraph description from a file", "filename" },
     { "reinit_filter",  HAS_ARG | OPT_INT | OPT_SPEC | OPT_INPUT,    { .off = OFFSET(reinit_filters) },
@@ -3576,8 +3615,16 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", HAS_ARG | OPT_INT,                   { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "filter_thread_type", HAS_ARG | OPT_STRING | OPT_EXPERT,        { &filter_thread_type },
+        "set the allowed threading types of all filtergraphs", "flags" },
+    { "shared_threads", HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_shared_threads },
+        "run the slice threads of all decoders, encoders and filtergraphs on one pool of threads", "nb_threads" },
     { "lavfi",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
+    { "pipeline_threads", OPT_BOOL | OPT_EXPERT,                     { &pipeline_threads },
+        "run each encoder and each muxer in its own thread" },
+    { "pipeline_queue_size", HAS_ARG | OPT_INT | OPT_EXPERT,         { &pipeline_queue_size },
+        "maximum number of frames or packets queued between pipeline threads", "size" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
         "read complex filtergraph description from a file", "filename" },
     { "auto_conversion_filters", OPT_BOOL | OPT_EXPERT,              { &auto_conversion_filters },
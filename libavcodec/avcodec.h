@@ -1776,6 +1776,7 @@ typedef struct AVCodecContext {
      * Which multithreading methods to use.
      * Use of FF_THREAD_FRAME will increase decoding delay by one frame per thread,
      * so clients which cannot provide future frames should not use it.
+     * See frame_threads for limiting that delay.
      *
      * - encoding: Set by user, otherwise the default is used.
      * - decoding: Set by user, otherwise the default is used.
@@ -2382,6 +2383,24 @@ typedef struct AVCodecContext {
      * - decoding: unused
      */
     int (*get_encode_buffer)(struct AVCodecContext *s, AVPacket *pkt, int flags);
+
+    /**
+     * Number of frames decoded in parallel when frame and slice threading
+     * are combined.
+     *
+     * If set to a value larger than 0 and both FF_THREAD_FRAME and
+     * FF_THREAD_SLICE are allowed by thread_type, decoders supporting it
+     * decode frame_threads frames at once, each of them using
+     * thread_count / frame_threads slice threads. The decoding delay
+     * introduced by threading is then frame_threads - 1 frames instead of
+     * thread_count - 1. A value of 1 selects slice threading only.
+     *
+     * 0 (the default) uses a single threading type, see thread_type.
+     *
+     * - encoding: unused
+     * - decoding: Set by user.
+     */
+    int frame_threads;
 } AVCodecContext;
 
 #if FF_API_CODEC_GET_SET
@@ -37,6 +37,8 @@
 #include "profiles.h"
 #include "thread.h"
 
+#define ROW_JOBS_PER_THREAD 4
+
 typedef struct RowContext {
     DECLARE_ALIGNED(32, int16_t, blocks)[12][64];
     int luma_scale[64];
@@ -60,6 +62,7 @@ typedef struct DNXHDContext {
     enum AVPixelFormat pix_fmt;
     unsigned int mb_width, mb_height;
     uint32_t mb_scan_index[512];
+    int rows_per_job;                   ///< number of MB rows decoded by each execute2() job
     int data_offset;                    // End of mb_scan_index, where macroblocks start
     int cur_field;                      ///< current interlaced field
     VLC ac_vlc, dc_vlc, run_vlc;
@@ -612,6 +615,19 @@ static int dnxhd_decode_row(AVCodecContext *avctx, void *data,
     return 0;
 }
 
+static int dnxhd_decode_rows(AVCodecContext *avctx, void *data,
+                             int jobnr, int threadnb)
+{
+    const DNXHDContext *ctx = avctx->priv_data;
+    int y   = jobnr * ctx->rows_per_job;
+    int end = FFMIN(y + ctx->rows_per_job, ctx->mb_height);
+
+    for (; y < end; y++)
+        dnxhd_decode_row(avctx, data, y, threadnb);
+
+    return 0;
+}
+
 static int dnxhd_decode_frame(AVCodecContext *avctx, void *data,
                               int *got_frame, AVPacket *avpkt)
 {
@@ -621,7 +637,7 @@ static int dnxhd_decode_frame(AVCodecContext *avctx, void *data,
     ThreadFrame frame = { .f = data };
     AVFrame *picture = data;
     int first_field = 1;
-    int ret, i;
+    int ret, i, nb_jobs;
 
     ff_dlog(avctx, "frame size %d\n", buf_size);
 
@@ -658,7 +674,11 @@ decode_coding_unit:
 
     ctx->buf_size = buf_size - ctx->data_offset;
     ctx->buf = buf + ctx->data_offset;
-    avctx->execute2(avctx, dnxhd_decode_row, picture, NULL, ctx->mb_height);
+    /* decode a few rows per job, limiting the threading overhead with the
+     * many rows of large pictures */
+    ctx->rows_per_job = FFMAX(1, ctx->mb_height / (avctx->thread_count * ROW_JOBS_PER_THREAD));
+    nb_jobs = (ctx->mb_height + ctx->rows_per_job - 1) / ctx->rows_per_job;
+    avctx->execute2(avctx, dnxhd_decode_rows, picture, NULL, nb_jobs);
 
     if (first_field && picture->interlaced_frame) {
         buf      += ctx->cid_table->coding_unit_size;
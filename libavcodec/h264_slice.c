@@ -2457,68 +2457,90 @@ static int fill_filter_caches(const H264Context *h, H264SliceContext *sl, int mb
     return 0;
 }
 
-static void loop_filter(const H264Context *h, H264SliceContext *sl, int start_x, int end_x)
+static av_always_inline void loop_filter_mbs(const H264Context *h, H264SliceContext *sl,
+                                             int start_x, int end_x,
+                                             int backup, int filter)
 {
     uint8_t *dest_y, *dest_cb, *dest_cr;
     int linesize, uvlinesize, mb_x, mb_y;
     const int end_mb_y       = sl->mb_y + FRAME_MBAFF(h);
-    const int old_slice_type = sl->slice_type;
     const int pixel_shift    = h->pixel_shift;
     const int block_h        = 16 >> h->chroma_y_shift;
 
-    if (h->postpone_filter)
-        return;
-
-    if (sl->deblocking_filter) {
-        for (mb_x = start_x; mb_x < end_x; mb_x++)
-            for (mb_y = end_mb_y - FRAME_MBAFF(h); mb_y <= end_mb_y; mb_y++) {
-                int mb_xy, mb_type;
-                mb_xy         = sl->mb_xy = mb_x + mb_y * h->mb_stride;
-                mb_type       = h->cur_pic.mb_type[mb_xy];
-
-                if (FRAME_MBAFF(h))
-                    sl->mb_mbaff               =
-                    sl->mb_field_decoding_flag = !!IS_INTERLACED(mb_type);
-
-                sl->mb_x = mb_x;
-                sl->mb_y = mb_y;
-                dest_y  = h->cur_pic.f->data[0] +
-                          ((mb_x << pixel_shift) + mb_y * sl->linesize) * 16;
-                dest_cb = h->cur_pic.f->data[1] +
-                          (mb_x << pixel_shift) * (8 << CHROMA444(h)) +
-                          mb_y * sl->uvlinesize * block_h;
-                dest_cr = h->cur_pic.f->data[2] +
-                          (mb_x << pixel_shift) * (8 << CHROMA444(h)) +
-                          mb_y * sl->uvlinesize * block_h;
-                // FIXME simplify above
-
-                if (MB_FIELD(sl)) {
-                    linesize   = sl->mb_linesize   = sl->linesize   * 2;
-                    uvlinesize = sl->mb_uvlinesize = sl->uvlinesize * 2;
-                    if (mb_y & 1) { // FIXME move out of this function?
-                        dest_y  -= sl->linesize   * 15;
-                        dest_cb -= sl->uvlinesize * (block_h - 1);
-                        dest_cr -= sl->uvlinesize * (block_h - 1);
-                    }
-                } else {
-                    linesize   = sl->mb_linesize   = sl->linesize;
-                    uvlinesize = sl->mb_uvlinesize = sl->uvlinesize;
+    for (mb_x = start_x; mb_x < end_x; mb_x++)
+        for (mb_y = end_mb_y - FRAME_MBAFF(h); mb_y <= end_mb_y; mb_y++) {
+            int mb_xy, mb_type;
+            mb_xy         = sl->mb_xy = mb_x + mb_y * h->mb_stride;
+            mb_type       = h->cur_pic.mb_type[mb_xy];
+
+            if (FRAME_MBAFF(h))
+                sl->mb_mbaff               =
+                sl->mb_field_decoding_flag = !!IS_INTERLACED(mb_type);
+
+            sl->mb_x = mb_x;
+            sl->mb_y = mb_y;
+            dest_y  = h->cur_pic.f->data[0] +
+                      ((mb_x << pixel_shift) + mb_y * sl->linesize) * 16;
+            dest_cb = h->cur_pic.f->data[1] +
+                      (mb_x << pixel_shift) * (8 << CHROMA444(h)) +
+                      mb_y * sl->uvlinesize * block_h;
+            dest_cr = h->cur_pic.f->data[2] +
+                      (mb_x << pixel_shift) * (8 << CHROMA444(h)) +
+                      mb_y * sl->uvlinesize * block_h;
+            // FIXME simplify above
+
+            if (MB_FIELD(sl)) {
+                linesize   = sl->mb_linesize   = sl->linesize   * 2;
+                uvlinesize = sl->mb_uvlinesize = sl->uvlinesize * 2;
+                if (mb_y & 1) { // FIXME move out of this function?
+                    dest_y  -= sl->linesize   * 15;
+                    dest_cb -= sl->uvlinesize * (block_h - 1);
+                    dest_cr -= sl->uvlinesize * (block_h - 1);
                 }
+            } else {
+                linesize   = sl->mb_linesize   = sl->linesize;
+                uvlinesize = sl->mb_uvlinesize = sl->uvlinesize;
+            }
+            if (backup)
                 backup_mb_border(h, sl, dest_y, dest_cb, dest_cr, linesize,
                                  uvlinesize, 0);
-                if (fill_filter_caches(h, sl, mb_type))
-                    continue;
-                sl->chroma_qp[0] = get_chroma_qp(h->ps.pps, 0, h->cur_pic.qscale_table[mb_xy]);
-                sl->chroma_qp[1] = get_chroma_qp(h->ps.pps, 1, h->cur_pic.qscale_table[mb_xy]);
-
-                if (FRAME_MBAFF(h)) {
-                    ff_h264_filter_mb(h, sl, mb_x, mb_y, dest_y, dest_cb, dest_cr,
-                                      linesize, uvlinesize);
-                } else {
-                    ff_h264_filter_mb_fast(h, sl, mb_x, mb_y, dest_y, dest_cb,
-                                           dest_cr, linesize, uvlinesize);
-                }
+            if (!filter || fill_filter_caches(h, sl, mb_type))
+                continue;
+            sl->chroma_qp[0] = get_chroma_qp(h->ps.pps, 0, h->cur_pic.qscale_table[mb_xy]);
+            sl->chroma_qp[1] = get_chroma_qp(h->ps.pps, 1, h->cur_pic.qscale_table[mb_xy]);
+
+            if (FRAME_MBAFF(h)) {
+                ff_h264_filter_mb(h, sl, mb_x, mb_y, dest_y, dest_cb, dest_cr,
+                                  linesize, uvlinesize);
+            } else {
+                ff_h264_filter_mb_fast(h, sl, mb_x, mb_y, dest_y, dest_cb,
+                                       dest_cr, linesize, uvlinesize);
             }
+        }
+}
+
+static void loop_filter(const H264Context *h, H264SliceContext *sl, int start_x, int end_x)
+{
+    const int end_mb_y       = sl->mb_y + FRAME_MBAFF(h);
+    const int old_slice_type = sl->slice_type;
+
+    if (h->postpone_filter)
+        return;
+
+    if (sl->deblocking_filter) {
+        /* With the loop filter on its own thread, only save the unfiltered
+         * borders needed by the intra prediction of the next MB row. */
+#if HAVE_THREADS
+        if (sl->deblock_thread) {
+            H264DeblockThread *dt = sl->deblock_thread;
+
+            loop_filter_mbs(h, sl, start_x, end_x, 1, 0);
+            pthread_mutex_lock(&dt->mutex);
+            dt->end_x = end_x;
+            pthread_mutex_unlock(&dt->mutex);
+        } else
+#endif
+            loop_filter_mbs(h, sl, start_x, end_x, 1, 1);
     }
     sl->slice_type  = old_slice_type;
     sl->mb_x         = end_x;
@@ -2547,6 +2569,20 @@ static void decode_finish_row(const H264Context *h, H264SliceContext *sl)
     int height         =  16      << FRAME_MBAFF(h);
     int deblock_border = (16 + 4) << FRAME_MBAFF(h);
 
+#if HAVE_THREADS
+    /* the loop filter thread draws and reports the row once filtered */
+    if (sl->deblock_thread) {
+        H264DeblockThread *dt = sl->deblock_thread;
+
+        pthread_mutex_lock(&dt->mutex);
+        dt->rows++;
+        dt->end_x = 0;
+        pthread_cond_signal(&dt->cond);
+        pthread_mutex_unlock(&dt->mutex);
+        return;
+    }
+#endif
+
     if (sl->deblocking_filter) {
         if ((top + height) >= pic_height)
             height += deblock_border;
@@ -2564,13 +2600,33 @@ static void decode_finish_row(const H264Context *h, H264SliceContext *sl)
 
     ff_h264_draw_horiz_band(h, sl, top, height);
 
-    if (h->droppable || sl->h264->slice_ctx[0].er.error_occurred)
+    /* slices decoded in parallel may finish out of order, their progress
+     * is reported by report_slices_progress() once all of them are done */
+    if (h->droppable || sl->h264->slice_ctx[0].er.error_occurred ||
+        h->nb_slice_ctx_queued > 1)
         return;
 
     ff_thread_report_progress(&h->cur_pic_ptr->tf, top + height - 1,
                               h->picture_structure == PICT_BOTTOM_FIELD);
 }
 
+/**
+ * Report progress for the rows above the last MB row reached by a batch
+ * of slices decoded in parallel (frame and slice threading combined).
+ */
+static void report_slices_progress(const H264Context *h)
+{
+    int mb_y           = FFMIN(h->mb_y, h->mb_height) & ~FRAME_MBAFF(h);
+    int deblock_border = (16 + 4) << FRAME_MBAFF(h);
+    int bottom         = 16 * (mb_y >> FIELD_PICTURE(h)) - deblock_border;
+
+    if (h->droppable || h->slice_ctx[0].er.error_occurred || bottom <= 0)
+        return;
+
+    ff_thread_report_progress(&h->cur_pic_ptr->tf, bottom - 1,
+                              h->picture_structure == PICT_BOTTOM_FIELD);
+}
+
 static void er_add_slice(H264SliceContext *sl,
                          int startx, int starty,
                          int endx, int endy, int status)
@@ -2792,6 +2848,67 @@ finish:
     return 0;
 }
 
+#if HAVE_THREADS
+/**
+ * Decode a single slice with its loop filter running on a second thread.
+ * Job 0 reconstructs the slice, job 1 filters each MB row once the
+ * reconstruction is two rows ahead, as the intra prediction of a row still
+ * needs the unfiltered row above it. The filter job then draws the row and
+ * reports the progress to the frame threads.
+ */
+static int decode_slice_deblock_thread(AVCodecContext *avctx, void *arg,
+                                       int jobnr, int threadnr)
+{
+    H264Context *h          = arg;
+    H264SliceContext *sl    = &h->slice_ctx[0];
+    H264SliceContext *lf_sl = h->deblock_sl;
+    H264DeblockThread *dt   = &h->deblock_progress;
+    const int step          = 1 + FIELD_OR_MBAFF_PICTURE(h);
+    const int slice_type    = lf_sl->slice_type;
+    int start_x             = lf_sl->mb_x;
+    int mb_y                = lf_sl->mb_y;
+    int row;
+
+    if (!jobnr) {
+        int ret = decode_slice(avctx, sl);
+
+        pthread_mutex_lock(&dt->mutex);
+        dt->done = 1;
+        pthread_cond_signal(&dt->cond);
+        pthread_mutex_unlock(&dt->mutex);
+        return ret;
+    }
+
+    for (row = 0;; row++) {
+        int rows, end_x;
+
+        pthread_mutex_lock(&dt->mutex);
+        while (dt->rows < row + 2 && !dt->done)
+            pthread_cond_wait(&dt->cond, &dt->mutex);
+        rows  = dt->rows;
+        end_x = dt->end_x;
+        pthread_mutex_unlock(&dt->mutex);
+
+        lf_sl->mb_y = mb_y;
+        if (row >= rows) {
+            /* the slice is finished, filter its incomplete last row */
+            if (end_x > start_x)
+                loop_filter_mbs(h, lf_sl, start_x, end_x, 0, 1);
+            break;
+        }
+        loop_filter_mbs(h, lf_sl, start_x, h->mb_width, 0, 1);
+        lf_sl->mb_y       = mb_y;
+        lf_sl->slice_type = slice_type;
+        decode_finish_row(h, lf_sl);
+
+        start_x = 0;
+        mb_y   += step;
+    }
+
+    return 0;
+}
+#endif
+
 /**
  * Call decode_slice() for each context.
  *
@@ -2817,6 +2934,35 @@ int ff_h264_execute_decode_slices(H264Context *h)
         h->slice_ctx[0].next_slice_idx = h->mb_width * h->mb_height;
         h->postpone_filter = 0;
 
+#if HAVE_THREADS
+        if (h->deblock_thread && h->slice_ctx[0].deblocking_filter &&
+            (avctx->active_thread_type & FF_THREAD_SLICE)) {
+            H264SliceContext *lf_sl;
+            int rets[2];
+
+            sl = &h->slice_ctx[0];
+            if (!h->deblock_sl) {
+                h->deblock_sl = av_malloc(sizeof(*h->deblock_sl));
+                if (!h->deblock_sl) {
+                    ret = AVERROR(ENOMEM);
+                    goto finish;
+                }
+            }
+            h->deblock_progress.rows  =
+            h->deblock_progress.end_x =
+            h->deblock_progress.done  = 0;
+
+            lf_sl  = h->deblock_sl;
+            *lf_sl = *sl;
+            lf_sl->linesize   = h->cur_pic_ptr->f->linesize[0];
+            lf_sl->uvlinesize = h->cur_pic_ptr->f->linesize[1];
+            sl->deblock_thread = &h->deblock_progress;
+
+            avctx->execute2(avctx, decode_slice_deblock_thread, h, rets, 2);
+            sl->deblock_thread = NULL;
+            ret = rets[0];
+        } else
+#endif
         ret = decode_slice(avctx, &h->slice_ctx[0]);
         h->mb_y = h->slice_ctx[0].mb_y;
         if (ret < 0)
@@ -2873,6 +3019,9 @@ int ff_h264_execute_decode_slices(H264Context *h)
                 }
             }
         }
+
+        if (avctx->active_thread_type & FF_THREAD_FRAME)
+            report_slices_progress(h);
     }
 
 finish:
@@ -277,7 +277,7 @@ int ff_h264_slice_context_init(H264Context *h, H264SliceContext *sl)
 
 static int h264_init_context(AVCodecContext *avctx, H264Context *h)
 {
-    int i;
+    int i, ret;
 
     h->avctx                 = avctx;
     h->cur_chroma_format_idc = -1;
@@ -307,6 +307,15 @@ static int h264_init_context(AVCodecContext *avctx, H264Context *h)
         return AVERROR(ENOMEM);
     }
 
+#if HAVE_THREADS
+    if ((ret = pthread_mutex_init(&h->deblock_progress.mutex, NULL)))
+        return AVERROR(ret);
+    h->deblock_progress.pthread_init_cnt++;
+    if ((ret = pthread_cond_init(&h->deblock_progress.cond, NULL)))
+        return AVERROR(ret);
+    h->deblock_progress.pthread_init_cnt++;
+#endif
+
     for (i = 0; i < H264_MAX_PICTURE_COUNT; i++) {
         h->DPB[i].f = av_frame_alloc();
         if (!h->DPB[i].f)
@@ -343,8 +352,16 @@ static av_cold int h264_decode_end(AVCodecContext *avctx)
 
     h->cur_pic_ptr = NULL;
 
+#if HAVE_THREADS
+    if (h->deblock_progress.pthread_init_cnt > 0)
+        pthread_mutex_destroy(&h->deblock_progress.mutex);
+    if (h->deblock_progress.pthread_init_cnt > 1)
+        pthread_cond_destroy(&h->deblock_progress.cond);
+    h->deblock_progress.pthread_init_cnt = 0;
+#endif
     av_freep(&h->slice_ctx);
     h->nb_slice_ctx = 0;
+    av_freep(&h->deblock_sl);
 
     ff_h264_sei_uninit(&h->sei);
     ff_h264_ps_uninit(&h->ps);
@@ -1032,6 +1049,7 @@ static const AVOption h264_options[] = {
     { "nal_length_size", "nal_length_size", OFFSET(nal_length_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 4, 0 },
     { "enable_er", "Enable error resilience on damaged frames (unsafe)", OFFSET(enable_er), AV_OPT_TYPE_BOOL, { .i64 = -1 }, -1, 1, VD },
     { "x264_build", "Assume this x264 version if no x264 version found in any SEI", OFFSET(x264_build), AV_OPT_TYPE_INT, {.i64 = -1}, -1, INT_MAX, VD },
+    { "deblock_thread", "Run the loop filter of single-slice pictures on its own slice thread", OFFSET(deblock_thread), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, VD },
     { NULL },
 };
 
@@ -1079,7 +1097,8 @@ AVCodec ff_h264_decoder = {
                                NULL
                            },
     .caps_internal         = FF_CODEC_CAP_INIT_THREADSAFE | FF_CODEC_CAP_EXPORTS_CROPPING |
-                             FF_CODEC_CAP_ALLOCATE_PROGRESS | FF_CODEC_CAP_INIT_CLEANUP,
+                             FF_CODEC_CAP_ALLOCATE_PROGRESS | FF_CODEC_CAP_INIT_CLEANUP |
+                             FF_CODEC_CAP_FRAME_SLICE_THREADS,
     .flush                 = h264_decode_flush,
     .update_thread_context = ONLY_IF_THREADS_ENABLED(ff_h264_update_thread_context),
     .profiles              = NULL_IF_CONFIG_SMALL(ff_h264_profiles),
@@ -181,6 +181,21 @@ typedef struct H264Ref {
     H264Picture *parent;
 } H264Ref;
 
+/**
+ * Progress of the reconstruction of a slice whose loop filter runs on its
+ * own thread. All fields are protected by mutex.
+ */
+typedef struct H264DeblockThread {
+    int rows;                       ///< number of completely reconstructed MB rows
+    int end_x;                      ///< end of the last, incomplete MB row of the slice
+    int done;                       ///< reconstruction of the slice is finished
+#if HAVE_THREADS
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    unsigned pthread_init_cnt;      ///< number of successfully initialized mutexes/conditions
+#endif
+} H264DeblockThread;
+
 typedef struct H264SliceContext {
     struct H264Context *h264;
     GetBitContext gb;
@@ -336,6 +351,11 @@ typedef struct H264SliceContext {
     int delta_poc[2];
     int curr_pic_num;
     int max_pic_num;
+
+    /* Set while the loop filter of this slice runs on a separate slice
+     * thread, lagging behind its reconstruction
+     * (see decode_slice_deblock_thread()). */
+    H264DeblockThread *deblock_thread;
 } H264SliceContext;
 
 /**
@@ -379,6 +399,10 @@ typedef struct H264Context {
      */
     int postpone_filter;
 
+    int deblock_thread;             ///< run the loop filter of single slices on its own thread
+    H264SliceContext *deblock_sl;   ///< slice context used by the loop filter thread
+    H264DeblockThread deblock_progress;
+
     /*
      * Set to 1 when the current picture is IDR, 0 otherwise.
      */
@@ -532,7 +532,7 @@ int ff_hevc_cabac_init(HEVCContext *s, int ctb_addr_ts, int thread)
         if (s->ps.pps->tiles_enabled_flag &&
             s->ps.pps->tile_id[ctb_addr_ts] != s->ps.pps->tile_id[ctb_addr_ts - 1]) {
             int ret;
-            if (s->threads_number == 1)
+            if (s->threads_number == 1 || !s->enable_parallel_tiles)
                 ret = cabac_reinit(s->HEVClc);
             else {
                 ret = cabac_init_decoder(s);
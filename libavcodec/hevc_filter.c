@@ -711,8 +711,7 @@ static int boundary_strength(HEVCContext *s, MvField *curr, MvField *neigh,
     return 1;
 }
 
-void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
-                                           int log2_trafo_size)
+static void upper_boundary_strengths(HEVCContext *s, int x0, int y0, int length)
 {
     HEVCLocalContext *lc = s->HEVClc;
     MvField *tab_mvf     = s->ref->tab_mvf;
@@ -720,47 +719,94 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
     int log2_min_tu_size = s->ps.sps->log2_min_tb_size;
     int min_pu_width     = s->ps.sps->min_pu_width;
     int min_tu_width     = s->ps.sps->min_tb_width;
+    RefPicList *rpl_top  = (lc->boundary_flags & BOUNDARY_UPPER_SLICE) ?
+                           ff_hevc_get_ref_list(s, s->ref, x0, y0 - 1) :
+                           s->ref->refPicList;
+    int yp_pu = (y0 - 1) >> log2_min_pu_size;
+    int yq_pu =  y0      >> log2_min_pu_size;
+    int yp_tu = (y0 - 1) >> log2_min_tu_size;
+    int yq_tu =  y0      >> log2_min_tu_size;
+    int i, bs;
+
+    for (i = 0; i < length; i += 4) {
+        int x_pu = (x0 + i) >> log2_min_pu_size;
+        int x_tu = (x0 + i) >> log2_min_tu_size;
+        MvField *top  = &tab_mvf[yp_pu * min_pu_width + x_pu];
+        MvField *curr = &tab_mvf[yq_pu * min_pu_width + x_pu];
+        uint8_t top_cbf_luma  = s->cbf_luma[yp_tu * min_tu_width + x_tu];
+        uint8_t curr_cbf_luma = s->cbf_luma[yq_tu * min_tu_width + x_tu];
+
+        if (curr->pred_flag == PF_INTRA || top->pred_flag == PF_INTRA)
+            bs = 2;
+        else if (curr_cbf_luma || top_cbf_luma)
+            bs = 1;
+        else
+            bs = boundary_strength(s, curr, top, rpl_top);
+        s->horizontal_bs[((x0 + i) + y0 * s->bs_width) >> 2] = bs;
+    }
+}
+
+static void left_boundary_strengths(HEVCContext *s, int x0, int y0, int length)
+{
+    HEVCLocalContext *lc = s->HEVClc;
+    MvField *tab_mvf     = s->ref->tab_mvf;
+    int log2_min_pu_size = s->ps.sps->log2_min_pu_size;
+    int log2_min_tu_size = s->ps.sps->log2_min_tb_size;
+    int min_pu_width     = s->ps.sps->min_pu_width;
+    int min_tu_width     = s->ps.sps->min_tb_width;
+    RefPicList *rpl_left = (lc->boundary_flags & BOUNDARY_LEFT_SLICE) ?
+                           ff_hevc_get_ref_list(s, s->ref, x0 - 1, y0) :
+                           s->ref->refPicList;
+    int xp_pu = (x0 - 1) >> log2_min_pu_size;
+    int xq_pu =  x0      >> log2_min_pu_size;
+    int xp_tu = (x0 - 1) >> log2_min_tu_size;
+    int xq_tu =  x0      >> log2_min_tu_size;
+    int i, bs;
+
+    for (i = 0; i < length; i += 4) {
+        int y_pu      = (y0 + i) >> log2_min_pu_size;
+        int y_tu      = (y0 + i) >> log2_min_tu_size;
+        MvField *left = &tab_mvf[y_pu * min_pu_width + xp_pu];
+        MvField *curr = &tab_mvf[y_pu * min_pu_width + xq_pu];
+        uint8_t left_cbf_luma = s->cbf_luma[y_tu * min_tu_width + xp_tu];
+        uint8_t curr_cbf_luma = s->cbf_luma[y_tu * min_tu_width + xq_tu];
+
+        if (curr->pred_flag == PF_INTRA || left->pred_flag == PF_INTRA)
+            bs = 2;
+        else if (curr_cbf_luma || left_cbf_luma)
+            bs = 1;
+        else
+            bs = boundary_strength(s, curr, left, rpl_left);
+        s->vertical_bs[(x0 + (y0 + i) * s->bs_width) >> 2] = bs;
+    }
+}
+
+void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
+                                           int log2_trafo_size)
+{
+    HEVCLocalContext *lc = s->HEVClc;
+    MvField *tab_mvf     = s->ref->tab_mvf;
+    int log2_min_pu_size = s->ps.sps->log2_min_pu_size;
+    int min_pu_width     = s->ps.sps->min_pu_width;
     int is_intra = tab_mvf[(y0 >> log2_min_pu_size) * min_pu_width +
                            (x0 >> log2_min_pu_size)].pred_flag == PF_INTRA;
     int boundary_upper, boundary_left;
     int i, j, bs;
 
+    // with parallel tiles, the CTB edges on tile boundaries are done by
+    // ff_hevc_deblocking_tile_boundary_strengths() once both sides are decoded
     boundary_upper = y0 > 0 && !(y0 & 7);
     if (boundary_upper &&
         ((!s->sh.slice_loop_filter_across_slices_enabled_flag &&
           lc->boundary_flags & BOUNDARY_UPPER_SLICE &&
           (y0 % (1 << s->ps.sps->log2_ctb_size)) == 0) ||
-         (!s->ps.pps->loop_filter_across_tiles_enabled_flag &&
+         ((!s->ps.pps->loop_filter_across_tiles_enabled_flag || s->enable_parallel_tiles) &&
           lc->boundary_flags & BOUNDARY_UPPER_TILE &&
           (y0 % (1 << s->ps.sps->log2_ctb_size)) == 0)))
         boundary_upper = 0;
 
-    if (boundary_upper) {
-        RefPicList *rpl_top = (lc->boundary_flags & BOUNDARY_UPPER_SLICE) ?
-                              ff_hevc_get_ref_list(s, s->ref, x0, y0 - 1) :
-                              s->ref->refPicList;
-        int yp_pu = (y0 - 1) >> log2_min_pu_size;
-        int yq_pu =  y0      >> log2_min_pu_size;
-        int yp_tu = (y0 - 1) >> log2_min_tu_size;
-        int yq_tu =  y0      >> log2_min_tu_size;
-
-            for (i = 0; i < (1 << log2_trafo_size); i += 4) {
-                int x_pu = (x0 + i) >> log2_min_pu_size;
-                int x_tu = (x0 + i) >> log2_min_tu_size;
-                MvField *top  = &tab_mvf[yp_pu * min_pu_width + x_pu];
-                MvField *curr = &tab_mvf[yq_pu * min_pu_width + x_pu];
-                uint8_t top_cbf_luma  = s->cbf_luma[yp_tu * min_tu_width + x_tu];
-                uint8_t curr_cbf_luma = s->cbf_luma[yq_tu * min_tu_width + x_tu];
-
-                if (curr->pred_flag == PF_INTRA || top->pred_flag == PF_INTRA)
-                    bs = 2;
-                else if (curr_cbf_luma || top_cbf_luma)
-                    bs = 1;
-                else
-                    bs = boundary_strength(s, curr, top, rpl_top);
-                s->horizontal_bs[((x0 + i) + y0 * s->bs_width) >> 2] = bs;
-            }
-    }
+    if (boundary_upper)
+        upper_boundary_strengths(s, x0, y0, 1 << log2_trafo_size);
 
     // bs for vertical TU boundaries
     boundary_left = x0 > 0 && !(x0 & 7);
@@ -768,37 +814,13 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
         ((!s->sh.slice_loop_filter_across_slices_enabled_flag &&
           lc->boundary_flags & BOUNDARY_LEFT_SLICE &&
           (x0 % (1 << s->ps.sps->log2_ctb_size)) == 0) ||
-         (!s->ps.pps->loop_filter_across_tiles_enabled_flag &&
+         ((!s->ps.pps->loop_filter_across_tiles_enabled_flag || s->enable_parallel_tiles) &&
           lc->boundary_flags & BOUNDARY_LEFT_TILE &&
           (x0 % (1 << s->ps.sps->log2_ctb_size)) == 0)))
         boundary_left = 0;
 
-    if (boundary_left) {
-        RefPicList *rpl_left = (lc->boundary_flags & BOUNDARY_LEFT_SLICE) ?
-                               ff_hevc_get_ref_list(s, s->ref, x0 - 1, y0) :
-                               s->ref->refPicList;
-        int xp_pu = (x0 - 1) >> log2_min_pu_size;
-        int xq_pu =  x0      >> log2_min_pu_size;
-        int xp_tu = (x0 - 1) >> log2_min_tu_size;
-        int xq_tu =  x0      >> log2_min_tu_size;
-
-            for (i = 0; i < (1 << log2_trafo_size); i += 4) {
-                int y_pu      = (y0 + i) >> log2_min_pu_size;
-                int y_tu      = (y0 + i) >> log2_min_tu_size;
-                MvField *left = &tab_mvf[y_pu * min_pu_width + xp_pu];
-                MvField *curr = &tab_mvf[y_pu * min_pu_width + xq_pu];
-                uint8_t left_cbf_luma = s->cbf_luma[y_tu * min_tu_width + xp_tu];
-                uint8_t curr_cbf_luma = s->cbf_luma[y_tu * min_tu_width + xq_tu];
-
-                if (curr->pred_flag == PF_INTRA || left->pred_flag == PF_INTRA)
-                    bs = 2;
-                else if (curr_cbf_luma || left_cbf_luma)
-                    bs = 1;
-                else
-                    bs = boundary_strength(s, curr, left, rpl_left);
-                s->vertical_bs[(x0 + (y0 + i) * s->bs_width) >> 2] = bs;
-            }
-    }
+    if (boundary_left)
+        left_boundary_strengths(s, x0, y0, 1 << log2_trafo_size);
 
     if (log2_trafo_size > log2_min_pu_size && !is_intra) {
         RefPicList *rpl = s->ref->refPicList;
@@ -835,6 +857,27 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
     }
 }
 
+void ff_hevc_deblocking_tile_boundary_strengths(HEVCContext *s, int x_ctb, int y_ctb)
+{
+    HEVCLocalContext *lc = s->HEVClc;
+    int ctb_size         = 1 << s->ps.sps->log2_ctb_size;
+
+    if (!s->ps.pps->loop_filter_across_tiles_enabled_flag)
+        return;
+
+    if (lc->boundary_flags & BOUNDARY_UPPER_TILE &&
+        (s->sh.slice_loop_filter_across_slices_enabled_flag ||
+         !(lc->boundary_flags & BOUNDARY_UPPER_SLICE)))
+        upper_boundary_strengths(s, x_ctb, y_ctb,
+                                 FFMIN(ctb_size, s->ps.sps->width - x_ctb));
+
+    if (lc->boundary_flags & BOUNDARY_LEFT_TILE &&
+        (s->sh.slice_loop_filter_across_slices_enabled_flag ||
+         !(lc->boundary_flags & BOUNDARY_LEFT_SLICE)))
+        left_boundary_strengths(s, x_ctb, y_ctb,
+                                FFMIN(ctb_size, s->ps.sps->height - y_ctb));
+}
+
 #undef LUMA
 #undef CB
 #undef CR
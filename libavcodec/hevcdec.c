@@ -917,8 +917,11 @@ static int hls_slice_header(HEVCContext *s)
                 sh->entry_point_offset[i] = val + 1; // +1; // +1 to get the size
             }
             if (s->threads_number > 1 && (s->ps.pps->num_tile_rows > 1 || s->ps.pps->num_tile_columns > 1)) {
-                s->enable_parallel_tiles = 0; // TODO: you can enable tiles in parallel here
-                s->threads_number = 1;
+                if (s->ps.pps->entropy_coding_sync_enabled_flag) {
+                    s->enable_parallel_tiles = 0;
+                    s->threads_number = 1;
+                } else
+                    s->enable_parallel_tiles = 1;
             } else
                 s->enable_parallel_tiles = 0;
         } else
@@ -1787,7 +1790,7 @@ static void chroma_mc_bi(HEVCContext *s, uint8_t *dst0, ptrdiff_t dststride, AVF
 static void hevc_await_progress(HEVCContext *s, HEVCFrame *ref,
                                 const Mv *mv, int y0, int height)
 {
-    if (s->threads_type == FF_THREAD_FRAME ) {
+    if (s->threads_type & FF_THREAD_FRAME ) {
         int y = FFMAX(0, (mv->y >> 2) + y0 + height + 9);
 
         ff_thread_await_progress(&ref->tf, y, 0);
@@ -2409,8 +2412,6 @@ static void hls_decode_neighbour(HEVCContext *s, int x_ctb, int y_ctb,
     int ctb_addr_rs       = s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts];
     int ctb_addr_in_slice = ctb_addr_rs - s->sh.slice_addr;
 
-    s->tab_slice_address[ctb_addr_rs] = s->sh.slice_addr;
-
     if (s->ps.pps->entropy_coding_sync_enabled_flag) {
         if (x_ctb == 0 && (y_ctb & (ctb_size - 1)) == 0)
             lc->first_qp_group = 1;
@@ -2478,6 +2479,7 @@ static int hls_decode_entry(AVCodecContext *avctxt, void *isFilterThread)
 
         x_ctb = (ctb_addr_rs % ((s->ps.sps->width + ctb_size - 1) >> s->ps.sps->log2_ctb_size)) << s->ps.sps->log2_ctb_size;
         y_ctb = (ctb_addr_rs / ((s->ps.sps->width + ctb_size - 1) >> s->ps.sps->log2_ctb_size)) << s->ps.sps->log2_ctb_size;
+        s->tab_slice_address[ctb_addr_rs] = s->sh.slice_addr;
         hls_decode_neighbour(s, x_ctb, y_ctb, ctb_addr_ts);
 
         ret = ff_hevc_cabac_init(s, ctb_addr_ts, 0);
@@ -2549,6 +2551,7 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
         int x_ctb = (ctb_addr_rs % s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
         int y_ctb = (ctb_addr_rs / s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
 
+        s->tab_slice_address[ctb_addr_rs] = s->sh.slice_addr;
         hls_decode_neighbour(s, x_ctb, y_ctb, ctb_addr_ts);
 
         ff_thread_await_progress2(s->avctx, ctb_row, thread, SHIFT_CTB_WPP);
@@ -2603,6 +2606,118 @@ error:
     return ret;
 }
 
+static int hls_decode_entry_tile(AVCodecContext *avctxt, void *input_tile, int job, int self_id)
+{
+    HEVCContext *s1  = avctxt->priv_data, *s;
+    HEVCLocalContext *lc;
+    const HEVCPPS *pps = s1->ps.pps;
+    int more_data   = 1;
+    int tile        = ((int *)input_tile)[job];
+    int ctb_addr_rs = pps->row_bd[tile / pps->num_tile_columns] * s1->ps.sps->ctb_width +
+                      pps->col_bd[tile % pps->num_tile_columns];
+    int ctb_addr_ts = pps->ctb_addr_rs_to_ts[ctb_addr_rs];
+    int ret;
+
+    s = s1->sList[self_id];
+    lc = s->HEVClc;
+
+    if (job)
+        ret = init_get_bits8(&lc->gb, s->data + s->sh.offset[job - 1], s->sh.size[job - 1]);
+    else
+        ret = init_get_bits8(&lc->gb, s->data + s->data_offset, s->sh.offset[0] - s->data_offset);
+    if (ret < 0)
+        goto error;
+
+    lc->first_qp_group = 1;
+    lc->qp_y = s->sh.slice_qp;
+    lc->tu.cu_qp_offset_cb = 0;
+    lc->tu.cu_qp_offset_cr = 0;
+    lc->end_of_tiles_x = (pps->col_bd[tile % pps->num_tile_columns] +
+                          pps->column_width[tile % pps->num_tile_columns]) << s->ps.sps->log2_ctb_size;
+
+    while (more_data && ctb_addr_ts < s->ps.sps->ctb_size) {
+        int x_ctb, y_ctb;
+
+        ctb_addr_rs = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+        x_ctb = (ctb_addr_rs % s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        hls_decode_neighbour(s, x_ctb, y_ctb, ctb_addr_ts);
+
+        ret = ff_hevc_cabac_init(s, ctb_addr_ts, 0);
+        if (ret < 0)
+            goto error;
+
+        hls_sao_param(s, x_ctb >> s->ps.sps->log2_ctb_size, y_ctb >> s->ps.sps->log2_ctb_size);
+
+        s->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
+        s->deblock[ctb_addr_rs].tc_offset   = s->sh.tc_offset;
+        s->filter_slice_edges[ctb_addr_rs]  = s->sh.slice_loop_filter_across_slices_enabled_flag;
+
+        more_data = hls_coding_quadtree(s, x_ctb, y_ctb, s->ps.sps->log2_ctb_size, 0);
+        if (more_data < 0) {
+            ret = more_data;
+            goto error;
+        }
+
+        ctb_addr_ts++;
+        if (ctb_addr_ts < s->ps.sps->ctb_size && pps->tile_id[ctb_addr_ts] != tile)
+            break;
+    }
+
+    // each substream holds exactly one tile, and the last one ends the slice segment
+    if (more_data != (job < s->sh.num_entry_point_offsets) &&
+        ctb_addr_ts < s->ps.sps->ctb_size) {
+        av_log(s->avctx, AV_LOG_ERROR, "Tile %d does not match its entry point\n", tile);
+        ret = AVERROR_INVALIDDATA;
+        goto error;
+    }
+
+    return job == s->sh.num_entry_point_offsets ? ctb_addr_ts : 0;
+error:
+    return ret;
+}
+
+/**
+ * Set the slice address of the CTBs of tiles first_tile to last_tile, which
+ * belong to the slice segment starting at ctb_addr_ts.
+ */
+static void set_tiles_slice_address(HEVCContext *s, int ctb_addr_ts,
+                                    int first_tile, int last_tile, int slice_addr)
+{
+    const HEVCPPS *pps = s->ps.pps;
+
+    for (; ctb_addr_ts < s->ps.sps->ctb_size &&
+           pps->tile_id[ctb_addr_ts] <= last_tile; ctb_addr_ts++)
+        if (pps->tile_id[ctb_addr_ts] >= first_tile)
+            s->tab_slice_address[pps->ctb_addr_ts_to_rs[ctb_addr_ts]] = slice_addr;
+}
+
+/**
+ * Run the in-loop filters on the CTBs of a slice segment whose tiles were
+ * decoded in parallel, now that all of its tiles are complete.
+ */
+static void hls_filter_tiles(HEVCContext *s, int ctb_addr_ts, int ctb_addr_end)
+{
+    int ctb_size = 1 << s->ps.sps->log2_ctb_size;
+    int x_ctb    = 0;
+    int y_ctb    = 0;
+
+    for (; ctb_addr_ts < ctb_addr_end; ctb_addr_ts++) {
+        int ctb_addr_rs = s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+
+        x_ctb = (ctb_addr_rs % s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        hls_decode_neighbour(s, x_ctb, y_ctb, ctb_addr_ts);
+        if (!s->sh.disable_deblocking_filter_flag)
+            ff_hevc_deblocking_tile_boundary_strengths(s, x_ctb, y_ctb);
+        ff_hevc_hls_filters(s, x_ctb, y_ctb, ctb_size);
+    }
+
+    if (x_ctb + ctb_size >= s->ps.sps->width &&
+        y_ctb + ctb_size >= s->ps.sps->height)
+        ff_hevc_hls_filter(s, x_ctb, y_ctb, ctb_size);
+}
+
 static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
 {
     const uint8_t *data = nal->data;
@@ -2620,7 +2735,8 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         return AVERROR(ENOMEM);
     }
 
-    if (s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * s->ps.sps->ctb_width >= s->ps.sps->ctb_width * s->ps.sps->ctb_height) {
+    if (s->ps.pps->entropy_coding_sync_enabled_flag &&
+        s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * s->ps.sps->ctb_width >= s->ps.sps->ctb_width * s->ps.sps->ctb_height) {
         av_log(s->avctx, AV_LOG_ERROR, "WPP ctb addresses are wrong (%d %d %d %d)\n",
             s->sh.slice_ctb_addr_rs, s->sh.num_entry_point_offsets,
             s->ps.sps->ctb_width, s->ps.sps->ctb_height
@@ -2629,6 +2745,25 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         goto error;
     }
 
+    if (!s->ps.pps->entropy_coding_sync_enabled_flag) {
+        const HEVCPPS *pps = s->ps.pps;
+        int ctb_addr_ts = pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+
+        if ((ctb_addr_ts && pps->tile_id[ctb_addr_ts] == pps->tile_id[ctb_addr_ts - 1]) ||
+            pps->tile_id[ctb_addr_ts] + s->sh.num_entry_point_offsets >= pps->num_tile_columns * pps->num_tile_rows) {
+            av_log(s->avctx, AV_LOG_ERROR, "Tile entry points are wrong (%d %d)\n",
+                   s->sh.slice_ctb_addr_rs, s->sh.num_entry_point_offsets);
+            res = AVERROR_INVALIDDATA;
+            goto error;
+        }
+        if (s->sh.dependent_slice_segment_flag &&
+            s->tab_slice_address[pps->ctb_addr_ts_to_rs[ctb_addr_ts - 1]] != s->sh.slice_addr) {
+            av_log(s->avctx, AV_LOG_ERROR, "Previous slice segment missing\n");
+            res = AVERROR_INVALIDDATA;
+            goto error;
+        }
+    }
+
     ff_alloc_entries(s->avctx, s->sh.num_entry_point_offsets + 1);
 
     for (i = 1; i < s->threads_number; i++) {
@@ -2647,6 +2782,7 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     }
 
     offset = (lc->gb.index >> 3);
+    s->data_offset = offset;
 
     for (j = 0, cmpt = 0, startheader = offset + s->sh.entry_point_offset[0]; j < nal->skipped_bytes; j++) {
         if (nal->skipped_bytes_pos[j] >= offset && nal->skipped_bytes_pos[j] < startheader) {
@@ -2696,11 +2832,38 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         ret[i] = 0;
     }
 
-    if (s->ps.pps->entropy_coding_sync_enabled_flag)
+    if (s->ps.pps->entropy_coding_sync_enabled_flag) {
         s->avctx->execute2(s->avctx, hls_decode_entry_wpp, arg, ret, s->sh.num_entry_point_offsets + 1);
 
-    for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
-        res += ret[i];
+        for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
+            res += ret[i];
+    } else {
+        int ctb_addr_ts = s->ps.pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+
+        for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
+            arg[i] = s->ps.pps->tile_id[ctb_addr_ts] + i;
+
+        // the tile jobs compare the slice address of their CTBs with the one of
+        // the CTBs above and to the left, which may lie in a tile decoded by
+        // another job; a segment with several tiles holds all of their CTBs,
+        // so set it for the whole segment before any job starts
+        set_tiles_slice_address(s, ctb_addr_ts, arg[0],
+                                arg[s->sh.num_entry_point_offsets], s->sh.slice_addr);
+        s->avctx->execute2(s->avctx, hls_decode_entry_tile, arg, ret, s->sh.num_entry_point_offsets + 1);
+
+        for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
+            if (ret[i] < 0)
+                set_tiles_slice_address(s, ctb_addr_ts, arg[i], arg[i], -1);
+        for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
+            if (ret[i] < 0) {
+                res = ret[i];
+                goto error;
+            }
+        res = ret[s->sh.num_entry_point_offsets];
+
+        // the loop filters cross tile boundaries, so they run once all tiles are done
+        hls_filter_tiles(s, ctb_addr_ts, res);
+    }
 error:
     av_free(ret);
     av_free(arg);
@@ -3106,7 +3269,8 @@ static int decode_nal_unit(HEVCContext *s, const H2645NAL *nal)
             if (ret < 0)
                 goto fail;
         } else {
-            if (s->threads_number > 1 && s->sh.num_entry_point_offsets > 0)
+            if (s->threads_number > 1 && s->sh.num_entry_point_offsets > 0 &&
+                (s->ps.pps->entropy_coding_sync_enabled_flag || s->enable_parallel_tiles))
                 ctb_addr_ts = hls_slice_data_wpp(s, nal);
             else
                 ctb_addr_ts = hls_slice_data(s);
@@ -3193,7 +3357,7 @@ static int decode_nal_units(HEVCContext *s, const uint8_t *buf, int length)
     }
 
 fail:
-    if (s->ref && s->threads_type == FF_THREAD_FRAME)
+    if (s->ref && s->threads_type & FF_THREAD_FRAME)
         ff_thread_report_progress(&s->ref->tf, INT_MAX, 0);
 
     return ret;
@@ -3613,8 +3777,8 @@ static av_cold int hevc_decode_init(AVCodecContext *avctx)
     else
         s->threads_number = 1;
 
-    if((avctx->active_thread_type & FF_THREAD_FRAME) && avctx->thread_count > 1)
-        s->threads_type = FF_THREAD_FRAME;
+    if (avctx->active_thread_type & FF_THREAD_FRAME)
+        s->threads_type = avctx->active_thread_type;
     else
         s->threads_type = FF_THREAD_SLICE;
 
@@ -3682,7 +3846,8 @@ AVCodec ff_hevc_decoder = {
     .capabilities          = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
                              AV_CODEC_CAP_SLICE_THREADS | AV_CODEC_CAP_FRAME_THREADS,
     .caps_internal         = FF_CODEC_CAP_INIT_THREADSAFE | FF_CODEC_CAP_EXPORTS_CROPPING |
-                             FF_CODEC_CAP_ALLOCATE_PROGRESS | FF_CODEC_CAP_INIT_CLEANUP,
+                             FF_CODEC_CAP_ALLOCATE_PROGRESS | FF_CODEC_CAP_INIT_CLEANUP |
+                             FF_CODEC_CAP_FRAME_SLICE_THREADS,
     .profiles              = NULL_IF_CONFIG_SMALL(ff_hevc_profiles),
     .hw_configs            = (const AVCodecHWConfigInternal *const []) {
 #if CONFIG_HEVC_DXVA2_HWACCEL
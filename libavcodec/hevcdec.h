@@ -558,6 +558,7 @@ typedef struct HEVCContext {
     atomic_int wpp_err;
 
     const uint8_t *data;
+    int data_offset;        ///< offset of the first substream in data, for tile threads
 
     H2645Packet pkt;
     // type of the first VCL NAL of the current frame
@@ -675,6 +676,7 @@ void ff_hevc_set_qPy(HEVCContext *s, int xBase, int yBase,
                      int log2_cb_size);
 void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
                                            int log2_trafo_size);
+void ff_hevc_deblocking_tile_boundary_strengths(HEVCContext *s, int x_ctb, int y_ctb);
 int ff_hevc_cu_qp_delta_sign_flag(HEVCContext *s);
 int ff_hevc_cu_qp_delta_abs(HEVCContext *s);
 int ff_hevc_cu_chroma_qp_offset_flag(HEVCContext *s);
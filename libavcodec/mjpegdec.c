@@ -778,10 +778,11 @@ int ff_mjpeg_decode_sof(MJpegDecodeContext *s)
     return 0;
 }
 
-static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
+static inline int mjpeg_decode_dc(MJpegDecodeContext *s, GetBitContext *gb,
+                                  int dc_index)
 {
     int code;
-    code = get_vlc2(&s->gb, s->vlcs[0][dc_index].table, 9, 2);
+    code = get_vlc2(gb, s->vlcs[0][dc_index].table, 9, 2);
     if (code < 0 || code > 16) {
         av_log(s->avctx, AV_LOG_WARNING,
                "mjpeg_decode_dc: bad vlc: %d:%d (%p)\n",
@@ -790,47 +791,48 @@ static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
     }
 
     if (code)
-        return get_xbits(&s->gb, code);
+        return get_xbits(gb, code);
     else
         return 0;
 }
 
 /* decode block and dequantize */
-static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
+static int decode_block(MJpegDecodeContext *s, MJpegSliceContext *sl,
+                        int16_t *block, int component,
                         int dc_index, int ac_index, uint16_t *quant_matrix)
 {
     int code, i, j, level, val;
 
     /* DC coef */
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, &sl->gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
     }
-    val = val * (unsigned)quant_matrix[0] + s->last_dc[component];
+    val = val * (unsigned)quant_matrix[0] + sl->last_dc[component];
     val = av_clip_int16(val);
-    s->last_dc[component] = val;
+    sl->last_dc[component] = val;
     block[0] = val;
     /* AC coefs */
     i = 0;
-    {OPEN_READER(re, &s->gb);
+    {OPEN_READER(re, &sl->gb);
     do {
-        UPDATE_CACHE(re, &s->gb);
-        GET_VLC(code, re, &s->gb, s->vlcs[1][ac_index].table, 9, 2);
+        UPDATE_CACHE(re, &sl->gb);
+        GET_VLC(code, re, &sl->gb, s->vlcs[1][ac_index].table, 9, 2);
 
         i += ((unsigned)code) >> 4;
             code &= 0xf;
         if (code) {
             if (code > MIN_CACHE_BITS - 16)
-                UPDATE_CACHE(re, &s->gb);
+                UPDATE_CACHE(re, &sl->gb);
 
             {
-                int cache = GET_CACHE(re, &s->gb);
+                int cache = GET_CACHE(re, &sl->gb);
                 int sign  = (~cache) >> 31;
                 level     = (NEG_USR32(sign ^ cache,code) ^ sign) - sign;
             }
 
-            LAST_SKIP_BITS(re, &s->gb, code);
+            LAST_SKIP_BITS(re, &sl->gb, code);
 
             if (i > 63) {
                 av_log(s->avctx, AV_LOG_ERROR, "error count: %d\n", i);
@@ -840,24 +842,24 @@ static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
             block[j] = level * quant_matrix[i];
         }
     } while (i < 63);
-    CLOSE_READER(re, &s->gb);}
+    CLOSE_READER(re, &sl->gb);}
 
     return 0;
 }
 
-static int decode_dc_progressive(MJpegDecodeContext *s, int16_t *block,
-                                 int component, int dc_index,
+static int decode_dc_progressive(MJpegDecodeContext *s, MJpegSliceContext *sl,
+                                 int16_t *block, int component, int dc_index,
                                  uint16_t *quant_matrix, int Al)
 {
     unsigned val;
     s->bdsp.clear_block(block);
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, &sl->gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
     }
-    val = (val * (quant_matrix[0] << Al)) + s->last_dc[component];
-    s->last_dc[component] = val;
+    val = (val * (quant_matrix[0] << Al)) + sl->last_dc[component];
+    sl->last_dc[component] = val;
     block[0] = val;
     return 0;
 }
@@ -1027,34 +1029,35 @@ static int decode_block_refinement(MJpegDecodeContext *s, int16_t *block,
 #undef REFINE_BIT
 #undef ZERO_RUN
 
-static int handle_rstn(MJpegDecodeContext *s, int nb_components)
+static int handle_rstn(MJpegDecodeContext *s, GetBitContext *gb,
+                       int *restart_count, int *last_dc, int nb_components)
 {
     int i;
     int reset = 0;
 
     if (s->restart_interval) {
-        s->restart_count--;
-        if(s->restart_count == 0 && s->avctx->codec_id == AV_CODEC_ID_THP){
-            align_get_bits(&s->gb);
+        (*restart_count)--;
+        if(*restart_count == 0 && s->avctx->codec_id == AV_CODEC_ID_THP){
+            align_get_bits(gb);
             for (i = 0; i < nb_components; i++) /* reset dc */
-                s->last_dc[i] = (4 << s->bits);
+                last_dc[i] = (4 << s->bits);
         }
 
-        i = 8 + ((-get_bits_count(&s->gb)) & 7);
+        i = 8 + ((-get_bits_count(gb)) & 7);
         /* skip RSTn */
-        if (s->restart_count == 0) {
-            if(   show_bits(&s->gb, i) == (1 << i) - 1
-               || show_bits(&s->gb, i) == 0xFF) {
-                int pos = get_bits_count(&s->gb);
-                align_get_bits(&s->gb);
-                while (get_bits_left(&s->gb) >= 8 && show_bits(&s->gb, 8) == 0xFF)
-                    skip_bits(&s->gb, 8);
-                if (get_bits_left(&s->gb) >= 8 && (get_bits(&s->gb, 8) & 0xF8) == 0xD0) {
+        if (*restart_count == 0) {
+            if(   show_bits(gb, i) == (1 << i) - 1
+               || show_bits(gb, i) == 0xFF) {
+                int pos = get_bits_count(gb);
+                align_get_bits(gb);
+                while (get_bits_left(gb) >= 8 && show_bits(gb, 8) == 0xFF)
+                    skip_bits(gb, 8);
+                if (get_bits_left(gb) >= 8 && (get_bits(gb, 8) & 0xF8) == 0xD0) {
                     for (i = 0; i < nb_components; i++) /* reset dc */
-                        s->last_dc[i] = (4 << s->bits);
+                        last_dc[i] = (4 << s->bits);
                     reset = 1;
                 } else
-                    skip_bits_long(&s->gb, pos - get_bits_count(&s->gb));
+                    skip_bits_long(gb, pos - get_bits_count(gb));
             }
         }
     }
@@ -1141,7 +1144,7 @@ static int ljpeg_decode_rgb_scan(MJpegDecodeContext *s, int nb_components, int p
                 topleft[i] = top[i];
                 top[i]     = buffer[mb_x][i];
 
-                dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                 if(dc == 0xFFFFF)
                     return -1;
 
@@ -1273,7 +1276,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for(j=0; j<n; j++) {
                         int pred, dc;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if (   h * mb_x + x >= s->width
@@ -1344,7 +1347,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for (j = 0; j < n; j++) {
                         int pred;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if (   h * mb_x + x >= s->width
@@ -1413,12 +1416,18 @@ static void shift_output(MJpegDecodeContext *s, uint8_t *ptr, int linesize)
     }
 }
 
-static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
-                             int Al, const uint8_t *mb_bitmask,
-                             int mb_bitmask_size,
-                             const AVFrame *reference)
+/**
+ * Decode the MCUs start to end - 1 of a sequential scan, or the DC
+ * coefficients of a progressive one. start has to be the first MCU of a
+ * restart interval and the bitreader of sl positioned at it.
+ */
+static int mjpeg_decode_scan_mcus(MJpegDecodeContext *s, MJpegSliceContext *sl,
+                                  int nb_components, int Ah, int Al,
+                                  const uint8_t *mb_bitmask,
+                                  const AVFrame *reference, int start, int end)
 {
     int i, mb_x, mb_y, chroma_h_shift, chroma_v_shift, chroma_width, chroma_height;
+    int mb_x_start = start % s->mb_width;
     uint8_t *data[MAX_COMPONENTS];
     const uint8_t *reference_data[MAX_COMPONENTS];
     int linesize[MAX_COMPONENTS];
@@ -1426,14 +1435,11 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
     int bytes_per_pixel = 1 + (s->bits > 8);
 
     if (mb_bitmask) {
-        if (mb_bitmask_size != (s->mb_width * s->mb_height + 7)>>3) {
-            av_log(s->avctx, AV_LOG_ERROR, "mb_bitmask_size mismatches\n");
-            return AVERROR_INVALIDDATA;
-        }
         init_get_bits(&mb_bitmask_gb, mb_bitmask, s->mb_width * s->mb_height);
+        skip_bits_long(&mb_bitmask_gb, start);
     }
 
-    s->restart_count = 0;
+    sl->restart_count = 0;
 
     av_pix_fmt_get_chroma_sub_sample(s->avctx->pix_fmt, &chroma_h_shift,
                                      &chroma_v_shift);
@@ -1445,19 +1451,21 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
         data[c] = s->picture_ptr->data[c];
         reference_data[c] = reference ? reference->data[c] : NULL;
         linesize[c] = s->linesize[c];
-        s->coefs_finished[c] |= 1;
     }
 
-    for (mb_y = 0; mb_y < s->mb_height; mb_y++) {
-        for (mb_x = 0; mb_x < s->mb_width; mb_x++) {
+    for (mb_y = start / s->mb_width; mb_y < s->mb_height; mb_y++) {
+        for (mb_x = mb_x_start; mb_x < s->mb_width; mb_x++) {
             const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
 
-            if (s->restart_interval && !s->restart_count)
-                s->restart_count = s->restart_interval;
+            if (mb_y * s->mb_width + mb_x >= end)
+                return 0;
 
-            if (get_bits_left(&s->gb) < 0) {
+            if (s->restart_interval && !sl->restart_count)
+                sl->restart_count = s->restart_interval;
+
+            if (get_bits_left(&sl->gb) < 0) {
                 av_log(s->avctx, AV_LOG_ERROR, "overread %d\n",
-                       -get_bits_left(&s->gb));
+                       -get_bits_left(&sl->gb));
                 return AVERROR_INVALIDDATA;
             }
             for (i = 0; i < nb_components; i++) {
@@ -1488,8 +1496,8 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
                                                 linesize[c], s->avctx->lowres);
 
                         } else {
-                            s->bdsp.clear_block(s->block);
-                            if (decode_block(s, s->block, i,
+                            s->bdsp.clear_block(sl->block);
+                            if (decode_block(s, sl, sl->block, i,
                                              s->dc_index[i], s->ac_index[i],
                                              s->quant_matrixes[s->quant_sindex[i]]) < 0) {
                                 av_log(s->avctx, AV_LOG_ERROR,
@@ -1497,7 +1505,7 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
                                 return AVERROR_INVALIDDATA;
                             }
                             if (ptr) {
-                                s->idsp.idct_put(ptr, linesize[c], s->block);
+                                s->idsp.idct_put(ptr, linesize[c], sl->block);
                                 if (s->bits & 7)
                                     shift_output(s, ptr, linesize[c]);
                             }
@@ -1507,9 +1515,9 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
                                          (h * mb_x + x);
                         int16_t *block = s->blocks[c][block_idx];
                         if (Ah)
-                            block[0] += get_bits1(&s->gb) *
+                            block[0] += get_bits1(&sl->gb) *
                                         s->quant_matrixes[s->quant_sindex[i]][0] << Al;
-                        else if (decode_dc_progressive(s, block, i, s->dc_index[i],
+                        else if (decode_dc_progressive(s, sl, block, i, s->dc_index[i],
                                                        s->quant_matrixes[s->quant_sindex[i]],
                                                        Al) < 0) {
                             av_log(s->avctx, AV_LOG_ERROR,
@@ -1528,12 +1536,144 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
                 }
             }
 
-            handle_rstn(s, nb_components);
+            handle_rstn(s, &sl->gb, &sl->restart_count, sl->last_dc, nb_components);
         }
+        mb_x_start = 0;
     }
     return 0;
 }
 
+typedef struct MJpegScanSlices {
+    int nb_components, Ah, Al;
+    const uint8_t *mb_bitmask;
+    const AVFrame *reference;
+    const int *restart_pos;     ///< RSTn markers ending the intervals but the last
+    int nb_intervals;
+    int nb_jobs;
+} MJpegScanSlices;
+
+static void init_slice_ctx(MJpegDecodeContext *s, MJpegSliceContext *sl)
+{
+    sl->gb = s->gb;
+    memcpy(sl->last_dc, s->last_dc, sizeof(sl->last_dc));
+}
+
+static int mjpeg_decode_scan_slice(AVCodecContext *avctx, void *arg,
+                                   int jobnr, int threadnr)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+    MJpegSliceContext *sl = &s->slice_ctx[jobnr];
+    const MJpegScanSlices *a = arg;
+    int first = (int64_t)a->nb_intervals *  jobnr      / a->nb_jobs;
+    int last  = (int64_t)a->nb_intervals * (jobnr + 1) / a->nb_jobs;
+    int nb_mcus = s->mb_width * s->mb_height;
+
+    /* each job decodes whole restart intervals with its own bitreader,
+     * dc predictors and block */
+    init_slice_ctx(s, sl);
+    if (first)
+        skip_bits_long(&sl->gb, (a->restart_pos[first - 1] + 2) * 8 -
+                                get_bits_count(&sl->gb));
+
+    return mjpeg_decode_scan_mcus(s, sl, a->nb_components, a->Ah, a->Al,
+                                  a->mb_bitmask, a->reference,
+                                  FFMIN((int64_t)first * s->restart_interval, nb_mcus),
+                                  FFMIN((int64_t)last  * s->restart_interval, nb_mcus));
+}
+
+/**
+ * Find the RSTn markers at which the current scan can be split.
+ *
+ * @return the index in restart_pos of the first marker of the scan,
+ *         or a negative value if they were not all found
+ */
+static int find_restart_markers(MJpegDecodeContext *s, int nb_intervals)
+{
+    int start = get_bits_count(&s->gb) >> 3;
+    int first, i;
+
+    if (s->nb_restart_pos < 0 || s->gb.buffer != s->buffer)
+        return -1;
+    for (first = 0; first < s->nb_restart_pos; first++)
+        if (s->restart_pos[first] >= start)
+            break;
+    if (s->nb_restart_pos - first < nb_intervals - 1)
+        return -1;
+    for (i = 0; i < nb_intervals - 1; i++)
+        if ((s->buffer[s->restart_pos[first + i] + 1] & 7) != (i & 7))
+            return -1;
+    return first;
+}
+
+static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
+                             int Al, const uint8_t *mb_bitmask,
+                             int mb_bitmask_size,
+                             const AVFrame *reference)
+{
+    MJpegScanSlices a = {
+        .nb_components = nb_components,
+        .Ah            = Ah,
+        .Al            = Al,
+        .mb_bitmask    = mb_bitmask,
+        .reference     = reference,
+        .nb_jobs       = 1,
+    };
+    MJpegSliceContext *sl;
+    int i, nb_mcus = s->mb_width * s->mb_height;
+
+    if (mb_bitmask) {
+        if (mb_bitmask_size != (nb_mcus + 7)>>3) {
+            av_log(s->avctx, AV_LOG_ERROR, "mb_bitmask_size mismatches\n");
+            return AVERROR_INVALIDDATA;
+        }
+    }
+
+    for (i = 0; i < nb_components; i++)
+        s->coefs_finished[s->comp_index[i]] |= 1;
+
+    if ((s->avctx->active_thread_type & FF_THREAD_SLICE) &&
+        s->restart_interval && s->restart_interval < nb_mcus) {
+        int first;
+
+        a.nb_intervals = (nb_mcus + s->restart_interval - 1) / s->restart_interval;
+        first = find_restart_markers(s, a.nb_intervals);
+        if (first >= 0) {
+            a.restart_pos = s->restart_pos + first;
+            a.nb_jobs     = FFMIN(a.nb_intervals, s->avctx->thread_count);
+        } else {
+            av_log(s->avctx, AV_LOG_DEBUG,
+                   "restart markers not found, decoding the scan in one slice\n");
+        }
+    }
+
+    av_fast_malloc(&s->slice_ctx, &s->slice_ctx_size,
+                   a.nb_jobs * sizeof(*s->slice_ctx));
+    av_fast_malloc(&s->slice_ret, &s->slice_ret_size,
+                   a.nb_jobs * sizeof(*s->slice_ret));
+    if (!s->slice_ctx || !s->slice_ret)
+        return AVERROR(ENOMEM);
+
+    if (a.restart_pos) {
+        s->avctx->execute2(s->avctx, mjpeg_decode_scan_slice, &a,
+                           s->slice_ret, a.nb_jobs);
+    } else {
+        init_slice_ctx(s, s->slice_ctx);
+        s->slice_ret[0] = mjpeg_decode_scan_mcus(s, s->slice_ctx, nb_components,
+                                                 Ah, Al, mb_bitmask, reference,
+                                                 0, nb_mcus);
+    }
+
+    /* continue after the scan, as the last job left it */
+    sl = &s->slice_ctx[a.nb_jobs - 1];
+    s->gb            = sl->gb;
+    s->restart_count = sl->restart_count;
+    memcpy(s->last_dc, sl->last_dc, sizeof(s->last_dc));
+    for (i = 0; i < a.nb_jobs; i++)
+        if (s->slice_ret[i] < 0)
+            return s->slice_ret[i];
+    return 0;
+}
+
 static int mjpeg_decode_scan_progressive_ac(MJpegDecodeContext *s, int ss,
                                             int se, int Ah, int Al)
 {
@@ -1582,7 +1722,7 @@ static int mjpeg_decode_scan_progressive_ac(MJpegDecodeContext *s, int ss,
                     return AVERROR_INVALIDDATA;
                 }
 
-            if (handle_rstn(s, 0))
+            if (handle_rstn(s, &s->gb, &s->restart_count, s->last_dc, 0))
                 EOBRUN = 0;
         }
     }
@@ -2194,6 +2334,22 @@ found:
     return val;
 }
 
+static void add_restart_pos(MJpegDecodeContext *s, int pos)
+{
+    int *restart_pos;
+
+    if (s->nb_restart_pos < 0)
+        return;
+    restart_pos = av_fast_realloc(s->restart_pos, &s->restart_pos_size,
+                                  (s->nb_restart_pos + 1) * sizeof(*s->restart_pos));
+    if (!restart_pos) {
+        s->nb_restart_pos = -1;
+        return;
+    }
+    s->restart_pos = restart_pos;
+    s->restart_pos[s->nb_restart_pos++] = pos;
+}
+
 int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                          const uint8_t **buf_ptr, const uint8_t *buf_end,
                          const uint8_t **unescaped_buf_ptr,
@@ -2212,6 +2368,8 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
         const uint8_t *ptr = src;
         uint8_t *dst = s->buffer;
 
+        s->nb_restart_pos = 0;
+
         #define copy_data_segment(skip) do {       \
             ptrdiff_t length = (ptr - src) - (skip);  \
             if (length > 0) {                         \
@@ -2249,6 +2407,11 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                         copy_data_segment(1);
                         if (x)
                             break;
+                    } else if (s->avctx->active_thread_type & FF_THREAD_SLICE) {
+                        if (skip > 1)
+                            s->nb_restart_pos = -1;
+                        else
+                            add_restart_pos(s, dst - s->buffer + (ptr - src) - 2);
                     }
                 }
             }
@@ -2903,6 +3066,9 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
     av_freep(&s->buffer);
     av_freep(&s->stereo3d);
     av_freep(&s->ljpeg_buffer);
+    av_freep(&s->restart_pos);
+    av_freep(&s->slice_ctx);
+    av_freep(&s->slice_ret);
     s->ljpeg_buffer_size = 0;
 
     for (i = 0; i < 3; i++) {
@@ -2957,7 +3123,7 @@ AVCodec ff_mjpeg_decoder = {
     .close          = ff_mjpeg_decode_end,
     .receive_frame  = ff_mjpeg_receive_frame,
     .flush          = decode_flush,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
     .max_lowres     = 3,
     .priv_class     = &mjpegdec_class,
     .profiles       = NULL_IF_CONFIG_SMALL(ff_mjpeg_profiles),
@@ -49,6 +49,17 @@ typedef struct ICCEntry {
     int    length;
 } ICCEntry;
 
+/**
+ * State that changes while the MCUs of a sequential scan are decoded. Each
+ * slice thread job decodes its restart intervals with its own.
+ */
+typedef struct MJpegSliceContext {
+    GetBitContext gb;
+    int restart_count;
+    int last_dc[MAX_COMPONENTS];
+    DECLARE_ALIGNED(32, int16_t, block)[64];
+} MJpegSliceContext;
+
 typedef struct MJpegDecodeContext {
     AVClass *class;
     AVCodecContext *avctx;
@@ -110,7 +121,6 @@ typedef struct MJpegDecodeContext {
     int got_picture;                                ///< we found a SOF and picture is valid, too.
     int linesize[MAX_COMPONENTS];                   ///< linesize << interlaced
     int8_t *qscale_table;
-    DECLARE_ALIGNED(32, int16_t, block)[64];
     int16_t (*blocks[MAX_COMPONENTS])[64]; ///< intermediate sums (progressive mode)
     uint8_t *last_nnz[MAX_COMPONENTS];
     uint64_t coefs_finished[MAX_COMPONENTS]; ///< bitmask of which coefs have been completely decoded (progressive mode)
@@ -122,6 +132,13 @@ typedef struct MJpegDecodeContext {
 
     int restart_interval;
     int restart_count;
+    int *restart_pos;                 ///< offsets of the RSTn markers in buffer, for slice threading
+    int nb_restart_pos;               ///< number of restart_pos, negative if some are missing
+    unsigned int restart_pos_size;
+    MJpegSliceContext *slice_ctx;     ///< one per job decoding a sequential scan
+    unsigned int slice_ctx_size;
+    int *slice_ret;
+    unsigned int slice_ret_size;
 
     int buggy_avid;
     int cs_itu601;
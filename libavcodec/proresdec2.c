@@ -41,6 +41,8 @@
 #include "proresdata.h"
 #include "thread.h"
 
+#define SLICE_JOBS_PER_THREAD 4
+
 static void permute(uint8_t *dst, const uint8_t *src, const uint8_t permutation[64])
 {
     int i;
@@ -615,10 +617,9 @@ static void decode_slice_alpha(ProresContext *ctx,
     }
 }
 
-static int decode_slice_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+static int decode_slice(AVCodecContext *avctx, SliceContext *slice)
 {
     ProresContext *ctx = avctx->priv_data;
-    SliceContext *slice = &ctx->slices[jobnr];
     const uint8_t *buf = slice->data;
     AVFrame *pic = ctx->frame;
     int i, hdr_size, qscale, log2_chroma_blocks_per_mb;
@@ -632,8 +633,8 @@ static int decode_slice_thread(AVCodecContext *avctx, void *arg, int jobnr, int
     uint16_t val_no_chroma;
 
     slice->ret = -1;
-    //av_log(avctx, AV_LOG_INFO, "slice %d mb width %d mb x %d y %d\n",
-    //       jobnr, slice->mb_count, slice->mb_x, slice->mb_y);
+    //av_log(avctx, AV_LOG_INFO, "slice mb width %d mb x %d y %d\n",
+    //       slice->mb_count, slice->mb_x, slice->mb_y);
 
     // slice header
     hdr_size = buf[0] >> 3;
@@ -733,13 +734,31 @@ static int decode_slice_thread(AVCodecContext *avctx, void *arg, int jobnr, int
     return 0;
 }
 
+static int decode_slices_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    ProresContext *ctx = avctx->priv_data;
+    int i   = jobnr * ctx->slices_per_job;
+    int end = FFMIN(i + ctx->slices_per_job, ctx->slice_count);
+
+    for (; i < end; i++)
+        decode_slice(avctx, &ctx->slices[i]);
+
+    return 0;
+}
+
 static int decode_picture(AVCodecContext *avctx)
 {
     ProresContext *ctx = avctx->priv_data;
-    int i;
+    int i, nb_jobs;
     int error = 0;
 
-    avctx->execute2(avctx, decode_slice_thread, NULL, NULL, ctx->slice_count);
+    /* Large pictures have thousands of small slices, decode a run of them
+     * per job to limit the threading overhead. A few jobs per thread keep
+     * the load balanced. */
+    ctx->slices_per_job = FFMAX(1, ctx->slice_count / (avctx->thread_count * SLICE_JOBS_PER_THREAD));
+    nb_jobs = (ctx->slice_count + ctx->slices_per_job - 1) / ctx->slices_per_job;
+
+    avctx->execute2(avctx, decode_slices_thread, NULL, NULL, nb_jobs);
 
     for (i = 0; i < ctx->slice_count; i++)
         error += ctx->slices[i].ret < 0;
@@ -40,6 +40,8 @@
  * Threading requires more than one thread.
  * Frame threading requires entire frames to be passed to the codec,
  * and introduces extra decoding delay, so is incompatible with low_delay.
+ * Codecs supporting it can also use slice threading inside each frame
+ * thread when AVCodecContext.frame_threads is set.
  *
  * @param avctx The context.
  */
@@ -53,6 +55,10 @@ static void validate_thread_parameters(AVCodecContext *avctx)
         avctx->active_thread_type = 0;
     } else if (frame_threading_supported && (avctx->thread_type & FF_THREAD_FRAME)) {
         avctx->active_thread_type = FF_THREAD_FRAME;
+        if (avctx->frame_threads > 0 && avctx->thread_type & FF_THREAD_SLICE &&
+            avctx->codec->capabilities & AV_CODEC_CAP_SLICE_THREADS &&
+            avctx->codec->caps_internal & FF_CODEC_CAP_FRAME_SLICE_THREADS)
+            avctx->active_thread_type |= FF_THREAD_SLICE;
     } else if (avctx->codec->capabilities & AV_CODEC_CAP_SLICE_THREADS &&
                avctx->thread_type & FF_THREAD_SLICE) {
         avctx->active_thread_type = FF_THREAD_SLICE;
@@ -71,10 +77,10 @@ int ff_thread_init(AVCodecContext *avctx)
 {
     validate_thread_parameters(avctx);
 
-    if (avctx->active_thread_type&FF_THREAD_SLICE)
-        return ff_slice_thread_init(avctx);
-    else if (avctx->active_thread_type&FF_THREAD_FRAME)
+    if (avctx->active_thread_type&FF_THREAD_FRAME)
         return ff_frame_thread_init(avctx);
+    else if (avctx->active_thread_type&FF_THREAD_SLICE)
+        return ff_slice_thread_init(avctx);
 
     return 0;
 }
@@ -82,7 +88,7 @@ int ff_thread_init(AVCodecContext *avctx)
 void ff_thread_free(AVCodecContext *avctx)
 {
     if (avctx->active_thread_type&FF_THREAD_FRAME)
-        ff_frame_thread_free(avctx, avctx->thread_count);
+        ff_frame_thread_free(avctx);
     else
         ff_slice_thread_free(avctx);
 }
@@ -125,6 +125,7 @@ typedef struct PerThreadContext {
  */
 typedef struct FrameThreadContext {
     PerThreadContext *threads;     ///< The contexts for each thread.
+    int thread_count;              ///< Number of frame threads.
     PerThreadContext *prev_thread; ///< The last thread submit_packet() was called on.
 
     unsigned    pthread_init_cnt;  ///< Number of successfully initialized mutexes/conditions
@@ -528,7 +529,7 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
      * If we're still receiving the initial packets, don't return a frame.
      */
 
-    if (fctx->next_decoding > (avctx->thread_count-1-(avctx->codec_id == AV_CODEC_ID_FFV1)))
+    if (fctx->next_decoding > (fctx->thread_count-1-(avctx->codec_id == AV_CODEC_ID_FFV1)))
         fctx->delaying = 0;
 
     if (fctx->delaying) {
@@ -570,12 +571,12 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
         p->got_frame = 0;
         p->result = 0;
 
-        if (finished >= avctx->thread_count) finished = 0;
+        if (finished >= fctx->thread_count) finished = 0;
     } while (!avpkt->size && !*got_picture_ptr && err >= 0 && finished != fctx->next_finished);
 
     update_context_from_thread(avctx, p->avctx, 1);
 
-    if (fctx->next_decoding >= avctx->thread_count) fctx->next_decoding = 0;
+    if (fctx->next_decoding >= fctx->thread_count) fctx->next_decoding = 0;
 
     fctx->next_finished = finished;
 
@@ -604,7 +605,10 @@ void ff_thread_report_progress(ThreadFrame *f, int n, int field)
 
     pthread_mutex_lock(&p->progress_mutex);
 
-    atomic_store_explicit(&progress[field], n, memory_order_release);
+    /* With slice threads, several threads may report progress on the
+     * same frame, never move it backwards. */
+    if (atomic_load_explicit(&progress[field], memory_order_relaxed) < n)
+        atomic_store_explicit(&progress[field], n, memory_order_release);
 
     pthread_cond_broadcast(&p->progress_cond);
     pthread_mutex_unlock(&p->progress_mutex);
@@ -735,9 +739,10 @@ fail:
     return err;
 }
 
-void ff_frame_thread_free(AVCodecContext *avctx, int thread_count)
+void ff_frame_thread_free(AVCodecContext *avctx)
 {
     FrameThreadContext *fctx = avctx->internal->thread_ctx;
+    int thread_count = fctx->thread_count;
     const AVCodec *codec = avctx->codec;
     int i;
 
@@ -772,6 +777,8 @@ void ff_frame_thread_free(AVCodecContext *avctx, int thread_count)
             }
             if (codec->close && p->thread_init != UNINITIALIZED)
                 codec->close(ctx);
+            if (ctx->internal->slice_thread_ctx)
+                ff_slice_thread_free(ctx);
 
 #if FF_API_THREAD_SAFE_CALLBACKS
             release_delayed_buffers(p);
@@ -812,7 +819,7 @@ void ff_frame_thread_free(AVCodecContext *avctx, int thread_count)
 
 static av_cold int init_thread(PerThreadContext *p, int *threads_to_free,
                                FrameThreadContext *fctx, AVCodecContext *avctx,
-                               AVCodecContext *src, const AVCodec *codec, int first)
+                               AVCodecContext *src, const AVCodec *codec)
 {
     AVCodecContext *copy;
     int err;
@@ -855,6 +862,52 @@ static av_cold int init_thread(PerThreadContext *p, int *threads_to_free,
     if (err < 0)
         return err;
 
+    if (avctx->active_thread_type & FF_THREAD_SLICE) {
+        copy->thread_count = avctx->thread_count / fctx->thread_count;
+        err = ff_slice_thread_init(copy);
+        if (err < 0)
+            return err;
+    }
+
+    return 0;
+}
+
+/**
+ * Use frame threading alone if one of the frame threads could not get its
+ * slice threads, as they must all use the same number of them.
+ */
+static av_cold void check_slice_threads(FrameThreadContext *fctx,
+                                        AVCodecContext *avctx, AVCodecContext *src)
+{
+    int i;
+
+    for (i = 0; i < fctx->thread_count; i++)
+        if (!(fctx->threads[i].avctx->active_thread_type & FF_THREAD_SLICE))
+            break;
+    if (i == fctx->thread_count)
+        return;
+
+    av_log(avctx, AV_LOG_WARNING,
+           "Could not create the slice threads, using frame threads only\n");
+    avctx->active_thread_type = FF_THREAD_FRAME;
+    for (i = 0; i < fctx->thread_count; i++) {
+        AVCodecContext *copy = fctx->threads[i].avctx;
+
+        if (copy->internal->slice_thread_ctx)
+            ff_slice_thread_free(copy);
+        copy->active_thread_type = FF_THREAD_FRAME;
+        copy->thread_count       = src->thread_count;
+        copy->execute            = src->execute;
+        copy->execute2           = src->execute2;
+    }
+}
+
+static av_cold int start_thread(PerThreadContext *p, AVCodecContext *avctx,
+                                const AVCodec *codec, int first)
+{
+    AVCodecContext *copy = p->avctx;
+    int err;
+
     if (!(p->frame = av_frame_alloc()) ||
         !(p->avpkt = av_packet_alloc()))
         return AVERROR(ENOMEM);
@@ -908,6 +961,21 @@ int ff_frame_thread_init(AVCodecContext *avctx)
         return 0;
     }
 
+    if (avctx->active_thread_type & FF_THREAD_SLICE) {
+        /* Combined frame and slice threading: frame_threads frames are
+         * decoded at once, the remaining threads are split between them
+         * as slice threads. */
+        int frame_threads = FFMIN(avctx->frame_threads, thread_count);
+
+        if (frame_threads <= 1) {
+            avctx->active_thread_type = FF_THREAD_SLICE;
+            return ff_slice_thread_init(avctx);
+        }
+        if (thread_count / frame_threads <= 1)
+            avctx->active_thread_type = FF_THREAD_FRAME;
+        thread_count = frame_threads;
+    }
+
     avctx->internal->thread_ctx = fctx = av_mallocz(sizeof(FrameThreadContext));
     if (!fctx)
         return AVERROR(ENOMEM);
@@ -921,9 +989,10 @@ int ff_frame_thread_init(AVCodecContext *avctx)
 
     fctx->async_lock = 1;
     fctx->delaying = 1;
+    fctx->thread_count = thread_count;
 
     if (codec->type == AVMEDIA_TYPE_VIDEO)
-        avctx->delay = src->thread_count - 1;
+        avctx->delay = thread_count - 1;
 
     fctx->threads = av_mallocz_array(thread_count, sizeof(PerThreadContext));
     if (!fctx->threads) {
@@ -933,9 +1002,17 @@ int ff_frame_thread_init(AVCodecContext *avctx)
 
     for (; i < thread_count; ) {
         PerThreadContext *p  = &fctx->threads[i];
-        int first = !i;
 
-        err = init_thread(p, &i, fctx, avctx, src, codec, first);
+        err = init_thread(p, &i, fctx, avctx, src, codec);
+        if (err < 0)
+            goto error;
+    }
+
+    if (avctx->active_thread_type & FF_THREAD_SLICE)
+        check_slice_threads(fctx, avctx, src);
+
+    for (i = 0; i < thread_count; i++) {
+        err = start_thread(&fctx->threads[i], avctx, codec, !i);
         if (err < 0)
             goto error;
     }
@@ -943,7 +1020,8 @@ int ff_frame_thread_init(AVCodecContext *avctx)
     return 0;
 
 error:
-    ff_frame_thread_free(avctx, i);
+    fctx->thread_count = i;
+    ff_frame_thread_free(avctx);
     return err;
 }
 
@@ -954,7 +1032,7 @@ void ff_thread_flush(AVCodecContext *avctx)
 
     if (!fctx) return;
 
-    park_frame_worker_threads(fctx, avctx->thread_count);
+    park_frame_worker_threads(fctx, fctx->thread_count);
     if (fctx->prev_thread) {
         if (fctx->prev_thread != &fctx->threads[0])
             update_context_from_thread(fctx->threads[0].avctx, fctx->prev_thread->avctx, 0);
@@ -963,7 +1041,7 @@ void ff_thread_flush(AVCodecContext *avctx)
     fctx->next_decoding = fctx->next_finished = 0;
     fctx->delaying = 1;
     fctx->prev_thread = NULL;
-    for (i = 0; i < avctx->thread_count; i++) {
+    for (i = 0; i < fctx->thread_count; i++) {
         PerThreadContext *p = &fctx->threads[i];
         // Make sure decode flush calls with size=0 won't return old frames
         p->got_frame = 0;
@@ -58,14 +58,14 @@ typedef struct SliceThreadContext {
 
 static void main_function(void *priv) {
     AVCodecContext *avctx = priv;
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
     c->mainfunc(avctx);
 }
 
 static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
 {
     AVCodecContext *avctx = priv;
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
     int ret;
 
     ret = c->func ? c->func(avctx, (char *)c->args + c->job_size * jobnr)
@@ -76,7 +76,7 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
 
 void ff_slice_thread_free(AVCodecContext *avctx)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
     int i;
 
     avpriv_slicethread_free(&c->thread);
@@ -89,12 +89,12 @@ void ff_slice_thread_free(AVCodecContext *avctx)
     av_freep(&c->entries);
     av_freep(&c->progress_mutex);
     av_freep(&c->progress_cond);
-    av_freep(&avctx->internal->thread_ctx);
+    av_freep(&avctx->internal->slice_thread_ctx);
 }
 
 static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, int *ret, int job_count, int job_size)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
 
     if (!(avctx->active_thread_type&FF_THREAD_SLICE) || avctx->thread_count <= 1)
         return avcodec_default_execute(avctx, func, arg, ret, job_count, job_size);
@@ -113,14 +113,14 @@ static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, i
 
 static int thread_execute2(AVCodecContext *avctx, action_func2* func2, void *arg, int *ret, int job_count)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
     c->func2 = func2;
     return thread_execute(avctx, NULL, arg, ret, job_count, 0);
 }
 
 int ff_slice_thread_execute_with_mainfunc(AVCodecContext *avctx, action_func2* func2, main_func *mainfunc, void *arg, int *ret, int job_count)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
     c->func2 = func2;
     c->mainfunc = mainfunc;
     return thread_execute(avctx, NULL, arg, ret, job_count, 0);
@@ -150,18 +150,18 @@ int ff_slice_thread_init(AVCodecContext *avctx)
     }
 
     if (thread_count <= 1) {
-        avctx->active_thread_type = 0;
+        avctx->active_thread_type &= ~FF_THREAD_SLICE;
         return 0;
     }
 
-    avctx->internal->thread_ctx = c = av_mallocz(sizeof(*c));
+    avctx->internal->slice_thread_ctx = c = av_mallocz(sizeof(*c));
     mainfunc = avctx->codec->caps_internal & FF_CODEC_CAP_SLICE_THREAD_HAS_MF ? &main_function : NULL;
     if (!c || (thread_count = avpriv_slicethread_create(&c->thread, avctx, worker_func, mainfunc, thread_count)) <= 1) {
         if (c)
             avpriv_slicethread_free(&c->thread);
-        av_freep(&avctx->internal->thread_ctx);
+        av_freep(&avctx->internal->slice_thread_ctx);
         avctx->thread_count = 1;
-        avctx->active_thread_type = 0;
+        avctx->active_thread_type &= ~FF_THREAD_SLICE;
         return 0;
     }
     avctx->thread_count = thread_count;
@@ -173,7 +173,7 @@ int ff_slice_thread_init(AVCodecContext *avctx)
 
 void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, int n)
 {
-    SliceThreadContext *p = avctx->internal->thread_ctx;
+    SliceThreadContext *p = avctx->internal->slice_thread_ctx;
     int *entries = p->entries;
 
     pthread_mutex_lock(&p->progress_mutex[thread]);
@@ -184,7 +184,7 @@ void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, in
 
 void ff_thread_await_progress2(AVCodecContext *avctx, int field, int thread, int shift)
 {
-    SliceThreadContext *p  = avctx->internal->thread_ctx;
+    SliceThreadContext *p  = avctx->internal->slice_thread_ctx;
     int *entries      = p->entries;
 
     if (!entries || !field) return;
@@ -203,7 +203,7 @@ int ff_alloc_entries(AVCodecContext *avctx, int count)
     int i;
 
     if (avctx->active_thread_type & FF_THREAD_SLICE)  {
-        SliceThreadContext *p = avctx->internal->thread_ctx;
+        SliceThreadContext *p = avctx->internal->slice_thread_ctx;
 
         if (p->entries) {
             av_assert0(p->thread_count == avctx->thread_count);
@@ -237,6 +237,6 @@ int ff_alloc_entries(AVCodecContext *avctx, int count)
 
 void ff_reset_entries(AVCodecContext *avctx)
 {
-    SliceThreadContext *p = avctx->internal->thread_ctx;
+    SliceThreadContext *p = avctx->internal->slice_thread_ctx;
     memset(p->entries, 0, p->entries_count * sizeof(int));
 }
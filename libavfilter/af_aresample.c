@@ -227,7 +227,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *insamplesref)
     outsamplesref->nb_samples  = n_out;
 
     ret = ff_filter_frame(outlink, outsamplesref);
-    av_frame_free(&insamplesref);
+    ff_link_free_frame(inlink, &insamplesref);
     return ret;
 }
 
@@ -70,9 +70,13 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
         }
     }
 
-    frame = ff_frame_pool_get(link->frame_pool);
+    frame = ff_link_alloc_frame(link);
     if (!frame)
         return NULL;
+    if (ff_frame_pool_get_buffer(link->frame_pool, frame) < 0) {
+        ff_link_free_frame(link, &frame);
+        return NULL;
+    }
 
     frame->nb_samples = nb_samples;
     frame->channel_layout = link->channel_layout;
@@ -42,6 +42,7 @@
 #include "filters.h"
 #include "formats.h"
 #include "internal.h"
+#include "thread.h"
 
 #include "libavutil/ffversion.h"
 const char av_filter_ffversion[] = "FFmpeg version " FFMPEG_VERSION;
@@ -192,7 +193,13 @@ int avfilter_link_get_channels(AVFilterLink *link)
 
 void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
 {
-    filter->ready = FFMAX(filter->ready, priority);
+    ff_graph_state_lock(filter->graph);
+    if (priority > filter->ready) {
+        filter->ready = priority;
+        if (filter->graph)
+            ff_filter_graph_update_ready(filter->graph, filter);
+    }
+    ff_graph_state_unlock(filter->graph);
 }
 
 /**
@@ -203,8 +210,10 @@ static void filter_unblock(AVFilterContext *filter)
 {
     unsigned i;
 
+    ff_graph_state_lock(filter->graph);
     for (i = 0; i < filter->nb_outputs; i++)
         filter->outputs[i]->frame_blocked_in = 0;
+    ff_graph_state_unlock(filter->graph);
 }
 
 
@@ -533,8 +542,11 @@ void ff_update_link_current_pts(AVFilterLink *link, int64_t pts)
     link->current_pts = pts;
     link->current_pts_us = av_rescale_q(pts, link->time_base, AV_TIME_BASE_Q);
     /* TODO use duration */
-    if (link->graph && link->age_index >= 0)
+    if (link->graph && link->age_index >= 0) {
+        ff_graph_state_lock(link->graph);
         ff_avfilter_graph_update_heap(link->graph, link);
+        ff_graph_state_unlock(link->graph);
+    }
 }
 
 int avfilter_process_command(AVFilterContext *filter, const char *cmd, const char *arg, char *res, int res_len, int flags)
@@ -624,8 +636,9 @@ static const AVClass *filter_child_class_iterate(void **iter)
 #define TFLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_RUNTIME_PARAM
 static const AVOption avfilter_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
-        { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, FLAGS, "thread_type" },
+        { .i64 = AVFILTER_THREAD_SLICE | AVFILTER_THREAD_FRAME }, 0, INT_MAX, FLAGS, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = FLAGS, .unit = "thread_type" },
+        { "frame", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_FRAME }, .flags = FLAGS, .unit = "thread_type" },
     { "enable", "set enable expression", OFFSET(enable_str), AV_OPT_TYPE_STRING, {.str=NULL}, .flags = TFLAGS },
     { "threads", "Allowed number of threads", OFFSET(nb_threads), AV_OPT_TYPE_INT,
         { .i64 = 0 }, 0, INT_MAX, FLAGS },
@@ -696,6 +709,7 @@ AVFilterContext *ff_filter_alloc(const AVFilter *filter, const char *inst_name)
     if (!ret->internal)
         goto err;
     ret->internal->execute = default_execute;
+    ret->internal->ready_index = -1;
 
     ret->nb_inputs = avfilter_pad_count(filter->inputs);
     if (ret->nb_inputs ) {
@@ -746,6 +760,12 @@ static void free_link(AVFilterLink *link)
     if (link->dst)
         link->dst->inputs[link->dstpad - link->dst->input_pads] = NULL;
 
+    if (link->frame_shell_hits || link->frame_shell_misses)
+        av_log(link->dst, AV_LOG_DEBUG,
+               "Frame pool on input from %s: %"PRId64" hits, %"PRId64" misses\n",
+               link->src ? link->src->name : "(none)",
+               link->frame_shell_hits, link->frame_shell_misses);
+
     av_buffer_unref(&link->hw_frames_ctx);
 
     ff_formats_unref(&link->incfg.formats);
@@ -894,7 +914,7 @@ int ff_filter_process_command(AVFilterContext *ctx, const char *cmd,
 
 int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
 {
-    int ret = 0;
+    int ret = 0, thread_type;
 
     ret = av_opt_set_dict(ctx, options);
     if (ret < 0) {
@@ -902,14 +922,18 @@ int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
         return ret;
     }
 
+    thread_type = ctx->thread_type & ctx->graph->thread_type;
     if (ctx->filter->flags & AVFILTER_FLAG_SLICE_THREADS &&
-        ctx->thread_type & ctx->graph->thread_type & AVFILTER_THREAD_SLICE &&
+        thread_type & AVFILTER_THREAD_SLICE &&
         ctx->graph->internal->thread_execute) {
         ctx->thread_type       = AVFILTER_THREAD_SLICE;
         ctx->internal->execute = ctx->graph->internal->thread_execute;
     } else {
         ctx->thread_type = 0;
     }
+    if (thread_type & AVFILTER_THREAD_FRAME &&
+        !(ctx->filter->flags_internal & FF_FILTER_FLAG_NO_FRAME_THREADS))
+        ctx->thread_type |= AVFILTER_THREAD_FRAME;
 
     if (ctx->filter->priv_class) {
         ret = av_opt_set_dict2(ctx->priv, options, AV_OPT_SEARCH_CHILDREN);
@@ -1087,10 +1111,51 @@ static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
     return ret;
 
 fail:
-    av_frame_free(&frame);
+    ff_link_free_frame(link, &frame);
     return ret;
 }
 
+AVFrame *ff_link_alloc_frame(AVFilterLink *link)
+{
+    AVFilterGraphInternal *gi = link->graph ? link->graph->internal : NULL;
+    AVFrame *frame = NULL;
+
+    if (gi) {
+        ff_mutex_lock(&gi->frame_shells_lock);
+        if (gi->nb_frame_shells) {
+            frame = gi->frame_shells[--gi->nb_frame_shells];
+            link->graph->frame_shell_hits++;
+        } else {
+            link->graph->frame_shell_misses++;
+        }
+        ff_mutex_unlock(&gi->frame_shells_lock);
+    }
+    if (frame) {
+        link->frame_shell_hits++;
+        return frame;
+    }
+    link->frame_shell_misses++;
+    return av_frame_alloc();
+}
+
+void ff_link_free_frame(AVFilterLink *link, AVFrame **frame)
+{
+    AVFilterGraphInternal *gi = link->graph ? link->graph->internal : NULL;
+
+    if (!*frame)
+        return;
+    if (gi) {
+        av_frame_unref(*frame);
+        ff_mutex_lock(&gi->frame_shells_lock);
+        if (gi->nb_frame_shells < FF_ARRAY_ELEMS(gi->frame_shells)) {
+            gi->frame_shells[gi->nb_frame_shells++] = *frame;
+            *frame = NULL;
+        }
+        ff_mutex_unlock(&gi->frame_shells_lock);
+    }
+    av_frame_free(frame);
+}
+
 int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
 {
     int ret;
@@ -1131,14 +1196,14 @@ int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
     filter_unblock(link->dst);
     ret = ff_framequeue_add(&link->fifo, frame);
     if (ret < 0) {
-        av_frame_free(&frame);
+        ff_link_free_frame(link, &frame);
         return ret;
     }
     ff_filter_set_ready(link->dst, 300);
     return 0;
 
 error:
-    av_frame_free(&frame);
+    ff_link_free_frame(link, &frame);
     return AVERROR_PATCHWELCOME;
 }
 
@@ -1184,7 +1249,7 @@ static int take_samples(AVFilterLink *link, unsigned min, unsigned max,
         return AVERROR(ENOMEM);
     ret = av_frame_copy_props(buf, frame0);
     if (ret < 0) {
-        av_frame_free(&buf);
+        ff_link_free_frame(link, &buf);
         return ret;
     }
     buf->pts = frame0->pts;
@@ -1195,7 +1260,7 @@ static int take_samples(AVFilterLink *link, unsigned min, unsigned max,
         av_samples_copy(buf->extended_data, frame->extended_data, p, 0,
                         frame->nb_samples, link->channels, link->format);
         p += frame->nb_samples;
-        av_frame_free(&frame);
+        ff_link_free_frame(link, &frame);
     }
     if (p < nb_samples) {
         unsigned n = nb_samples - p;
@@ -1367,7 +1432,8 @@ static int ff_filter_activate_default(AVFilterContext *filter)
      ff_avfilter_link_set_out_status().
 
    Filters are activated according to the ready field, set using the
-   ff_filter_set_ready(). Eventually, a priority queue will be used.
+   ff_filter_set_ready(), which keeps the ready filters of a graph in a
+   priority queue.
    ff_filter_set_ready() is called whenever anything could cause progress to
    be possible. Marking a filter ready when it is not is not a problem,
    except for the small overhead it causes.
@@ -1436,7 +1502,11 @@ int ff_filter_activate(AVFilterContext *filter)
     /* Generic timeline support is not yet implemented but should be easy */
     av_assert1(!(filter->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC &&
                  filter->filter->activate));
+    ff_graph_state_lock(filter->graph);
     filter->ready = 0;
+    if (filter->graph)
+        ff_filter_graph_update_ready(filter->graph, filter);
+    ff_graph_state_unlock(filter->graph);
     ret = filter->filter->activate ? filter->filter->activate(filter) :
           ff_filter_activate_default(filter);
     if (ret == FFERROR_NOT_READY)
@@ -1558,7 +1628,7 @@ int ff_inlink_make_frame_writable(AVFilterLink *link, AVFrame **rframe)
 
     ret = av_frame_copy_props(out, frame);
     if (ret < 0) {
-        av_frame_free(&out);
+        ff_link_free_frame(link, &out);
         return ret;
     }
 
@@ -1577,7 +1647,7 @@ int ff_inlink_make_frame_writable(AVFilterLink *link, AVFrame **rframe)
         av_assert0(!"reached");
     }
 
-    av_frame_free(&frame);
+    ff_link_free_frame(link, &frame);
     *rframe = out;
     return 0;
 }
@@ -1632,7 +1702,7 @@ void ff_inlink_set_status(AVFilterLink *link, int status)
     ff_avfilter_link_set_out_status(link, status, AV_NOPTS_VALUE);
     while (ff_framequeue_queued_frames(&link->fifo)) {
            AVFrame *frame = ff_framequeue_take(&link->fifo);
-           av_frame_free(&frame);
+           ff_link_free_frame(link, &frame);
     }
     if (!link->status_in)
         link->status_in = status;
@@ -335,6 +335,13 @@ typedef struct AVFilter {
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
 
+/**
+ * Activate filters which are not linked to each other concurrently, so that
+ * different frames are processed by different parts of the graph at the
+ * same time.
+ */
+#define AVFILTER_THREAD_FRAME (1 << 1)
+
 typedef struct AVFilterInternal AVFilterInternal;
 
 /** An instance of a filter */
@@ -652,6 +659,13 @@ struct AVFilterLink {
      */
     int status_out;
 
+    /**
+     * Number of frames obtained with ff_link_alloc_frame() on this link
+     * that reused a recycled structure, resp. had to be allocated.
+     */
+    int64_t frame_shell_hits;
+    int64_t frame_shell_misses;
+
 #endif /* FF_INTERNAL_FIELDS */
 
 };
@@ -917,6 +931,15 @@ typedef struct AVFilterGraph {
     int sink_links_count;
 
     unsigned disable_auto_convert;
+
+    /**
+     * Number of frames allocated by the filters of the graph that reused a
+     * recycled AVFrame structure, resp. had to allocate one.
+     * Access ONLY through the "frame_shell_hits" and "frame_shell_misses"
+     * AVOptions.
+     */
+    int64_t frame_shell_hits;
+    int64_t frame_shell_misses;
 } AVFilterGraph;
 
 /**
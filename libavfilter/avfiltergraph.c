@@ -50,12 +50,17 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, F|V|A, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = F|V|A, .unit = "thread_type" },
+        { "frame", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_FRAME }, .flags = F|V|A, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads),
         AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, F|V|A },
     {"scale_sws_opts"       , "default scale filter options"        , OFFSET(scale_sws_opts)        ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|V },
     {"aresample_swr_opts"   , "default aresample filter options"    , OFFSET(aresample_swr_opts)    ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|A },
+    { "frame_shell_hits",   "number of frames that reused a recycled structure", OFFSET(frame_shell_hits),
+        AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "frame_shell_misses", "number of frames that allocated a new structure", OFFSET(frame_shell_misses),
+        AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { NULL },
 };
 
@@ -78,6 +83,25 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     graph->nb_threads  = 1;
     return 0;
 }
+
+int ff_graph_frame_thread_count(AVFilterGraph *graph)
+{
+    return 0;
+}
+
+int ff_graph_frame_thread_execute(AVFilterGraph *graph, AVFilterContext **filters,
+                                  int nb_filters)
+{
+    return AVERROR_BUG;
+}
+
+void ff_graph_state_lock(AVFilterGraph *graph)
+{
+}
+
+void ff_graph_state_unlock(AVFilterGraph *graph)
+{
+}
 #endif
 
 AVFilterGraph *avfilter_graph_alloc(void)
@@ -95,6 +119,7 @@ AVFilterGraph *avfilter_graph_alloc(void)
     ret->av_class = &filtergraph_class;
     av_opt_set_defaults(ret);
     ff_framequeue_global_init(&ret->internal->frame_queues);
+    ff_mutex_init(&ret->internal->frame_shells_lock, NULL);
 
     return ret;
 }
@@ -104,9 +129,16 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
     int i, j;
     for (i = 0; i < graph->nb_filters; i++) {
         if (graph->filters[i] == filter) {
+            filter->ready = 0;
+            ff_filter_graph_update_ready(graph, filter);
             FFSWAP(AVFilterContext*, graph->filters[i],
                    graph->filters[graph->nb_filters - 1]);
             graph->nb_filters--;
+            if (i < graph->nb_filters) {
+                AVFilterContext *moved = graph->filters[i];
+                moved->internal->graph_index = i;
+                ff_filter_graph_update_ready(graph, moved);
+            }
             filter->graph = NULL;
             for (j = 0; j<filter->nb_outputs; j++)
                 if (filter->outputs[j])
@@ -128,6 +160,10 @@ void avfilter_graph_free(AVFilterGraph **graph)
     ff_graph_thread_free(*graph);
 
     av_freep(&(*graph)->sink_links);
+    av_freep(&(*graph)->internal->ready_filters);
+    while ((*graph)->internal->nb_frame_shells)
+        av_frame_free(&(*graph)->internal->frame_shells[--(*graph)->internal->nb_frame_shells]);
+    ff_mutex_destroy(&(*graph)->internal->frame_shells_lock);
 
     av_freep(&(*graph)->scale_sws_opts);
     av_freep(&(*graph)->aresample_swr_opts);
@@ -176,6 +212,8 @@ AVFilterContext *avfilter_graph_alloc_filter(AVFilterGraph *graph,
     if (graph->thread_type && !graph->internal->thread_execute) {
         if (graph->execute) {
             graph->internal->thread_execute = graph->execute;
+            /* frame threading needs the internal thread pool */
+            graph->thread_type &= ~AVFILTER_THREAD_FRAME;
         } else {
             int ret = ff_graph_thread_init(graph);
             if (ret < 0) {
@@ -196,6 +234,17 @@ AVFilterContext *avfilter_graph_alloc_filter(AVFilterGraph *graph,
     }
 
     graph->filters = filters;
+
+    /* every filter is at most once in the ready heap */
+    filters = av_realloc_array(graph->internal->ready_filters, graph->nb_filters + 1,
+                               sizeof(*filters));
+    if (!filters) {
+        avfilter_free(s);
+        return NULL;
+    }
+    graph->internal->ready_filters = filters;
+
+    s->internal->graph_index = graph->nb_filters;
     graph->filters[graph->nb_filters++] = s;
 
     s->graph = graph;
@@ -1343,6 +1392,63 @@ void ff_avfilter_graph_update_heap(AVFilterGraph *graph, AVFilterLink *link)
     heap_bubble_down(graph, link, link->age_index);
 }
 
+static int ready_filter_before(const AVFilterContext *a, const AVFilterContext *b)
+{
+    return a->ready > b->ready ||
+           (a->ready == b->ready && a->internal->graph_index < b->internal->graph_index);
+}
+
+/* Place filter at index in the ready heap and restore the heap order. */
+static void ready_heap_move(AVFilterGraphInternal *gi, AVFilterContext *filter, int index)
+{
+    AVFilterContext **filters = gi->ready_filters;
+
+    while (index) {
+        int parent = (index - 1) >> 1;
+        if (!ready_filter_before(filter, filters[parent]))
+            break;
+        filters[index] = filters[parent];
+        filters[index]->internal->ready_index = index;
+        index = parent;
+    }
+    while (1) {
+        int child = 2 * index + 1;
+        if (child >= gi->nb_ready_filters)
+            break;
+        if (child + 1 < gi->nb_ready_filters &&
+            ready_filter_before(filters[child + 1], filters[child]))
+            child++;
+        if (!ready_filter_before(filters[child], filter))
+            break;
+        filters[index] = filters[child];
+        filters[index]->internal->ready_index = index;
+        index = child;
+    }
+    filters[index] = filter;
+    filter->internal->ready_index = index;
+}
+
+void ff_filter_graph_update_ready(AVFilterGraph *graph, AVFilterContext *filter)
+{
+    AVFilterGraphInternal *gi = graph->internal;
+    int index = filter->internal->ready_index;
+
+    if (!filter->ready) {
+        AVFilterContext *last;
+
+        if (index < 0)
+            return;
+        filter->internal->ready_index = -1;
+        last = gi->ready_filters[--gi->nb_ready_filters];
+        if (last != filter)
+            ready_heap_move(gi, last, index);
+        return;
+    }
+    if (index < 0)
+        index = gi->nb_ready_filters++;
+    ready_heap_move(gi, filter, index);
+}
+
 int avfilter_graph_request_oldest(AVFilterGraph *graph)
 {
     AVFilterLink *oldest = graph->sink_links[0];
@@ -1388,17 +1494,63 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     return 0;
 }
 
+static int filters_linked(AVFilterContext *a, AVFilterContext *b)
+{
+    unsigned i;
+
+    for (i = 0; i < a->nb_inputs; i++)
+        if (a->inputs[i] && a->inputs[i]->src == b)
+            return 1;
+    for (i = 0; i < a->nb_outputs; i++)
+        if (a->outputs[i] && a->outputs[i]->dst == b)
+            return 1;
+    return 0;
+}
+
+/**
+ * Activate filter together with other ready filters that are not linked to
+ * any filter of the wave, so that no link is touched by two threads. Filters
+ * which do not allow frame threading are always activated alone.
+ */
+static int run_frame_wave(AVFilterGraph *graph, AVFilterContext *filter,
+                          int max_filters)
+{
+    AVFilterGraphInternal *gi = graph->internal;
+    AVFilterContext *wave[64];
+    int nb_wave = 1, i, j;
+
+    wave[0] = filter;
+    max_filters = FFMIN(max_filters, FF_ARRAY_ELEMS(wave));
+    if (filter->thread_type & AVFILTER_THREAD_FRAME) {
+        for (i = 0; i < gi->nb_ready_filters && nb_wave < max_filters; i++) {
+            AVFilterContext *f = gi->ready_filters[i];
+
+            if (f == filter || !(f->thread_type & AVFILTER_THREAD_FRAME))
+                continue;
+            for (j = 0; j < nb_wave; j++)
+                if (filters_linked(f, wave[j]))
+                    break;
+            if (j == nb_wave)
+                wave[nb_wave++] = f;
+        }
+    }
+    if (nb_wave == 1)
+        return ff_filter_activate(filter);
+    return ff_graph_frame_thread_execute(graph, wave, nb_wave);
+}
+
 int ff_filter_graph_run_once(AVFilterGraph *graph)
 {
     AVFilterContext *filter;
-    unsigned i;
+    int nb_frame_threads;
 
     av_assert0(graph->nb_filters);
-    filter = graph->filters[0];
-    for (i = 1; i < graph->nb_filters; i++)
-        if (graph->filters[i]->ready > filter->ready)
-            filter = graph->filters[i];
-    if (!filter->ready)
+    if (!graph->internal->nb_ready_filters)
         return AVERROR(EAGAIN);
+    filter = graph->internal->ready_filters[0];
+    av_assert1(filter->ready);
+    nb_frame_threads = ff_graph_frame_thread_count(graph);
+    if (nb_frame_threads > 1)
+        return run_frame_wave(graph, filter, nb_frame_threads);
     return ff_filter_activate(filter);
 }
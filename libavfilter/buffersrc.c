@@ -204,7 +204,7 @@ int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFra
 
     }
 
-    if (!(copy = av_frame_alloc()))
+    if (!(copy = ff_link_alloc_frame(ctx->outputs[0])))
         return AVERROR(ENOMEM);
 
     if (refcounted && !(flags & AV_BUFFERSRC_FLAG_KEEP_REF)) {
@@ -212,7 +212,7 @@ int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFra
     } else {
         ret = av_frame_ref(copy, frame);
         if (ret < 0) {
-            av_frame_free(&copy);
+            ff_link_free_frame(ctx->outputs[0], &copy);
             return ret;
         }
     }
@@ -194,14 +194,19 @@ int ff_frame_pool_get_audio_config(FFFramePool *pool,
 
 AVFrame *ff_frame_pool_get(FFFramePool *pool)
 {
-    int i;
-    AVFrame *frame;
-    const AVPixFmtDescriptor *desc;
+    AVFrame *frame = av_frame_alloc();
 
-    frame = av_frame_alloc();
-    if (!frame) {
+    if (!frame)
         return NULL;
-    }
+    if (ff_frame_pool_get_buffer(pool, frame) < 0)
+        av_frame_free(&frame);
+    return frame;
+}
+
+int ff_frame_pool_get_buffer(FFFramePool *pool, AVFrame *frame)
+{
+    int i;
+    const AVPixFmtDescriptor *desc;
 
     switch(pool->type) {
     case AVMEDIA_TYPE_VIDEO:
@@ -275,10 +280,10 @@ AVFrame *ff_frame_pool_get(FFFramePool *pool)
         av_assert0(0);
     }
 
-    return frame;
+    return 0;
 fail:
-    av_frame_free(&frame);
-    return NULL;
+    av_frame_unref(frame);
+    return AVERROR(ENOMEM);
 }
 
 void ff_frame_pool_uninit(FFFramePool **pool)
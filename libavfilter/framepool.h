@@ -115,5 +115,15 @@ int ff_frame_pool_get_audio_config(FFFramePool *pool,
  */
 AVFrame *ff_frame_pool_get(FFFramePool *pool);
 
+/**
+ * Attach buffers from the pool to a blank frame, as returned by
+ * av_frame_alloc(), and set its properties accordingly.
+ * This function may be called simultaneously from multiple threads.
+ *
+ * @return 0 on success, a negative AVERROR on error, in which case the frame
+ *         is unreferenced.
+ */
+int ff_frame_pool_get_buffer(FFFramePool *pool, AVFrame *frame);
+
 
 #endif /* AVFILTER_FRAMEPOOL_H */
@@ -25,6 +25,7 @@
  */
 
 #include "libavutil/internal.h"
+#include "libavutil/thread.h"
 #include "avfilter.h"
 #include "formats.h"
 #include "framepool.h"
@@ -48,6 +49,12 @@ typedef struct AVFilterCommand {
  */
 void ff_avfilter_graph_update_heap(AVFilterGraph *graph, AVFilterLink *link);
 
+/**
+ * Update the position of filter in the ready heap of graph after its ready
+ * field changed.
+ */
+void ff_filter_graph_update_ready(AVFilterGraph *graph, AVFilterContext *filter);
+
 /**
  * A filter pad used for either input or output.
  */
@@ -130,10 +137,29 @@ struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+
+    /**
+     * Filters with a non-zero ready field, as a heap ordered by decreasing
+     * ready and increasing position in AVFilterGraph.filters.
+     * Allocated for nb_filters entries.
+     */
+    AVFilterContext **ready_filters;
+    int nb_ready_filters;
+
+    /**
+     * Unused AVFrame structures, recycled by ff_link_free_frame() and handed
+     * out again by ff_link_alloc_frame().
+     */
+    AVMutex frame_shells_lock;
+    AVFrame *frame_shells[32];
+    int nb_frame_shells;
 };
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+
+    unsigned graph_index;       ///< position in AVFilterGraph.filters
+    int ready_index;            ///< position in the ready heap, -1 if not queued
 };
 
 /**
@@ -315,6 +341,22 @@ int ff_request_frame(AVFilterLink *link);
  */
 int ff_filter_frame(AVFilterLink *link, AVFrame *frame);
 
+/**
+ * Get a blank AVFrame to fill with data to be sent over a link, reusing a
+ * structure previously released with ff_link_free_frame() in the same graph
+ * when possible.
+ *
+ * @return a frame in the same state as returned by av_frame_alloc(),
+ *         or NULL on allocation failure
+ */
+AVFrame *ff_link_alloc_frame(AVFilterLink *link);
+
+/**
+ * Unreference a frame received from a link and keep the AVFrame structure
+ * for reuse by ff_link_alloc_frame(). *frame is set to NULL.
+ */
+void ff_link_free_frame(AVFilterLink *link, AVFrame **frame);
+
 /**
  * Allocate a new filter context and return it.
  *
@@ -338,6 +380,13 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
  */
 #define FF_FILTER_FLAG_HWFRAME_AWARE (1 << 0)
 
+/**
+ * The filter acts on other filters of the graph, e.g. by sending them
+ * commands, so it must never run concurrently with another filter. Frame
+ * threading is disabled for it, which makes it always run alone.
+ */
+#define FF_FILTER_FLAG_NO_FRAME_THREADS (1 << 1)
+
 /**
  * Run one round of processing on a filter graph.
  */
@@ -23,6 +23,7 @@
 
 #include "config.h"
 
+#include "libavutil/avassert.h"
 #include "libavutil/common.h"
 #include "libavutil/cpu.h"
 #include "libavutil/mem.h"
@@ -42,6 +43,17 @@ typedef struct ThreadContext {
     AVFilterContext *ctx;
     void *arg;
     int   *rets;
+
+    /* frame threading */
+    AVSliceThread *frame_thread;
+    int nb_frame_threads;
+    pthread_mutex_t execute_lock;   ///< serializes slice threading of concurrent filters
+    pthread_mutex_t state_lock;     ///< protects the scheduling state shared between filters
+    int wave_running;               ///< filters are being activated concurrently
+
+    /* per-wave parameters */
+    AVFilterContext **wave;
+    int *wave_rets;
 } ThreadContext;
 
 static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
@@ -52,9 +64,21 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
         c->rets[jobnr] = ret;
 }
 
+static void frame_worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    ThreadContext *c = priv;
+    c->wave_rets[jobnr] = ff_filter_activate(c->wave[jobnr]);
+}
+
 static void slice_thread_uninit(ThreadContext *c)
 {
     avpriv_slicethread_free(&c->thread);
+    if (c->frame_thread) {
+        avpriv_slicethread_free(&c->frame_thread);
+        pthread_mutex_destroy(&c->execute_lock);
+        pthread_mutex_destroy(&c->state_lock);
+    }
+    av_freep(&c->wave_rets);
 }
 
 static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
@@ -64,12 +88,16 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
 
     if (nb_jobs <= 0)
         return 0;
+    if (c->wave_running)
+        pthread_mutex_lock(&c->execute_lock);
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
 
     avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+    if (c->wave_running)
+        pthread_mutex_unlock(&c->execute_lock);
     return 0;
 }
 
@@ -81,6 +109,29 @@ static int thread_init_internal(ThreadContext *c, int nb_threads)
     return FFMAX(nb_threads, 1);
 }
 
+static int frame_thread_init(ThreadContext *c, int nb_threads)
+{
+    int ret;
+
+    c->wave_rets = av_calloc(nb_threads, sizeof(*c->wave_rets));
+    if (!c->wave_rets)
+        return AVERROR(ENOMEM);
+
+    ret = avpriv_slicethread_create(&c->frame_thread, c, frame_worker_func,
+                                    NULL, nb_threads);
+    if (ret <= 1) {
+        avpriv_slicethread_free(&c->frame_thread);
+        av_freep(&c->wave_rets);
+        return ret < 0 ? ret : 0;
+    }
+    c->nb_frame_threads = ret;
+
+    pthread_mutex_init(&c->execute_lock, NULL);
+    pthread_mutex_init(&c->state_lock, NULL);
+
+    return ret;
+}
+
 int ff_graph_thread_init(AVFilterGraph *graph)
 {
     int ret;
@@ -105,9 +156,59 @@ int ff_graph_thread_init(AVFilterGraph *graph)
 
     graph->internal->thread_execute = thread_execute;
 
+    if (graph->thread_type & AVFILTER_THREAD_FRAME) {
+        ret = frame_thread_init(graph->internal->thread, graph->nb_threads);
+        if (ret < 0)
+            return ret;
+        if (!ret)
+            graph->thread_type &= ~AVFILTER_THREAD_FRAME;
+    }
+
     return 0;
 }
 
+int ff_graph_frame_thread_count(AVFilterGraph *graph)
+{
+    ThreadContext *c = graph->internal->thread;
+
+    return c && c->frame_thread ? c->nb_frame_threads : 0;
+}
+
+int ff_graph_frame_thread_execute(AVFilterGraph *graph, AVFilterContext **filters,
+                                  int nb_filters)
+{
+    ThreadContext *c = graph->internal->thread;
+    int i;
+
+    av_assert1(nb_filters <= c->nb_frame_threads);
+
+    c->wave         = filters;
+    c->wave_running = 1;
+    avpriv_slicethread_execute(c->frame_thread, nb_filters, 0);
+    c->wave_running = 0;
+
+    for (i = 0; i < nb_filters; i++)
+        if (c->wave_rets[i] < 0)
+            return c->wave_rets[i];
+    return 0;
+}
+
+void ff_graph_state_lock(AVFilterGraph *graph)
+{
+    ThreadContext *c = graph ? graph->internal->thread : NULL;
+
+    if (c && c->wave_running)
+        pthread_mutex_lock(&c->state_lock);
+}
+
+void ff_graph_state_unlock(AVFilterGraph *graph)
+{
+    ThreadContext *c = graph ? graph->internal->thread : NULL;
+
+    if (c && c->wave_running)
+        pthread_mutex_unlock(&c->state_lock);
+}
+
 void ff_graph_thread_free(AVFilterGraph *graph)
 {
     if (graph->internal->thread)
@@ -25,4 +25,27 @@ int ff_graph_thread_init(AVFilterGraph *graph);
 
 void ff_graph_thread_free(AVFilterGraph *graph);
 
+/**
+ * Return the number of filters which can be activated concurrently by
+ * ff_graph_frame_thread_execute(), 0 if frame threading is not in use.
+ */
+int ff_graph_frame_thread_count(AVFilterGraph *graph);
+
+/**
+ * Activate the given filters concurrently and wait for all of them.
+ * The filters must not be linked to each other.
+ *
+ * @return the first negative return value of ff_filter_activate(), 0 otherwise
+ */
+int ff_graph_frame_thread_execute(AVFilterGraph *graph, AVFilterContext **filters,
+                                  int nb_filters);
+
+/**
+ * Lock and unlock the scheduling state (ready fields, link flags touched on
+ * neighbouring filters, sink heap) while filters are activated concurrently.
+ * No-ops otherwise.
+ */
+void ff_graph_state_lock(AVFilterGraph *graph);
+void ff_graph_state_unlock(AVFilterGraph *graph);
+
 #endif /* AVFILTER_THREAD_H */
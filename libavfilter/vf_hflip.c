@@ -223,7 +223,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     td.in = in, td.out = out;
     ctx->internal->execute(ctx, filter_slice, &td, NULL, FFMIN(outlink->h, ff_filter_get_nb_threads(ctx)));
 
-    av_frame_free(&in);
+    ff_link_free_frame(inlink, &in);
     return ff_filter_frame(outlink, out);
 }
 
@@ -818,7 +818,7 @@ scale:
         scale_slice(link, out, in, scale->sws, 0, link->h, 1, 0);
     }
 
-    av_frame_free(&in);
+    ff_link_free_frame(link, &in);
     return 0;
 }
 
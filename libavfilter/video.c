@@ -52,14 +52,14 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
     if (link->hw_frames_ctx &&
         ((AVHWFramesContext*)link->hw_frames_ctx->data)->format == link->format) {
         int ret;
-        AVFrame *frame = av_frame_alloc();
+        AVFrame *frame = ff_link_alloc_frame(link);
 
         if (!frame)
             return NULL;
 
         ret = av_hwframe_get_buffer(link->hw_frames_ctx, frame, 0);
         if (ret < 0)
-            av_frame_free(&frame);
+            ff_link_free_frame(link, &frame);
 
         return frame;
     }
@@ -87,9 +87,13 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
         }
     }
 
-    frame = ff_frame_pool_get(link->frame_pool);
+    frame = ff_link_alloc_frame(link);
     if (!frame)
         return NULL;
+    if (ff_frame_pool_get_buffer(link->frame_pool, frame) < 0) {
+        ff_link_free_frame(link, &frame);
+        return NULL;
+    }
 
     frame->sample_aspect_ratio = link->sample_aspect_ratio;
 
@@ -1091,6 +1091,13 @@ typedef struct AVStream {
 #endif
     AVIndexEntry *index_entries; /**< Only used if the format does not
                                     support seeking natively. */
+    /**
+     * Number of entries in index_entries. 0 while a demuxer keeps the index
+     * in a compact form (e.g. the mov compact_index option), in which case
+     * it can only be read with avformat_index_get_entries_count(),
+     * avformat_index_get_entry() and
+     * avformat_index_get_entry_from_timestamp().
+     */
     int nb_index_entries;
     unsigned int index_entries_allocated_size;
 
@@ -1393,6 +1400,12 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_FAST_SEEK   0x80000 ///< Enable fast, but inaccurate seeks for some formats
 #define AVFMT_FLAG_SHORTEST   0x100000 ///< Stop muxing when the shortest stream stops.
 #define AVFMT_FLAG_AUTO_BSF   0x200000 ///< Add bitstream filters as requested by the muxer
+/**
+ * Make avformat_find_stream_info() take the stream parameters found by the
+ * parsers and in the headers, and only decode streams for which these are
+ * incomplete. The decoding is done in parallel for all such streams.
+ */
+#define AVFMT_FLAG_FAST_PROBE 0x400000
 
     /**
      * Maximum size of the data read from input for determining
@@ -1862,6 +1875,31 @@ typedef struct AVFormatContext {
      * - decoding: set by user
      */
     int max_probe_packets;
+
+    /**
+     * Number of threads avformat_find_stream_info() decodes streams with
+     * when AVFMT_FLAG_FAST_PROBE is set, 0 for automatic.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int probe_threads;
+
+    /**
+     * Directory to cache the stream parameters and indexes of local files
+     * in, so that opening the same unmodified file again is faster.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    char *probe_cache;
+
+    /**
+     * Number of packets whose payload had to be copied instead of being
+     * referenced, because it was not reference counted or was assembled by
+     * a parser. Access through the "packet_copies" AVOption.
+     * - encoding: set by libavformat
+     * - decoding: set by libavformat
+     */
+    int64_t nb_packet_copies;
 } AVFormatContext;
 
 #if FF_API_FORMAT_GET_SET
@@ -2755,6 +2793,47 @@ int av_find_default_stream_index(AVFormatContext *s);
  */
 int av_index_search_timestamp(AVStream *st, int64_t timestamp, int flags);
 
+/**
+ * Get the index entry count for the given AVStream, whether the demuxer
+ * keeps its index as AVStream.index_entries or in a compact form.
+ *
+ * @param st stream
+ * @return the number of index entries in the stream
+ */
+int avformat_index_get_entries_count(const AVStream *st);
+
+/**
+ * Get the AVIndexEntry corresponding to the given index.
+ *
+ * @param st          Stream containing the requested AVIndexEntry.
+ * @param idx         The desired index.
+ * @return A pointer to the requested AVIndexEntry if it exists, NULL otherwise.
+ *
+ * @note The pointer returned by this function is only guaranteed to be valid
+ *       until any function that takes the stream or the parent AVFormatContext
+ *       as input argument is called.
+ */
+const AVIndexEntry *avformat_index_get_entry(AVStream *st, int idx);
+
+/**
+ * Get the AVIndexEntry corresponding to the given timestamp.
+ *
+ * @param st          Stream containing the requested AVIndexEntry.
+ * @param wanted_timestamp Timestamp to retrieve the index entry for.
+ * @param flags       If AVSEEK_FLAG_BACKWARD then the returned entry will correspond
+ *                    to the timestamp which is <= the requested one, if backward
+ *                    is 0, then it will be >=
+ *                    if AVSEEK_FLAG_ANY seek to any frame, only keyframes otherwise.
+ * @return A pointer to the requested AVIndexEntry if it exists, NULL otherwise.
+ *
+ * @note The pointer returned by this function is only guaranteed to be valid
+ *       until any function that takes the stream or the parent AVFormatContext
+ *       as input argument is called.
+ */
+const AVIndexEntry *avformat_index_get_entry_from_timestamp(AVStream *st,
+                                                            int64_t wanted_timestamp,
+                                                            int flags);
+
 /**
  * Add an index entry into a sorted list. Update the entry if the list
  * already contains it.
@@ -428,6 +428,81 @@ int ffurl_write(URLContext *h, const unsigned char *buf, int size)
                                   h->prot->url_write);
 }
 
+int ffurl_writev(URLContext *h, const URLIOVec *vec, int nb_vec)
+{
+    URLIOVec iov[URL_MAX_IOVEC];
+    int64_t size = 0;
+    int i, ret, len = 0, nb_iov = 0, first = 0;
+    int fast_retries = 5;
+    int64_t wait_since = 0;
+
+    if (!(h->flags & AVIO_FLAG_WRITE))
+        return AVERROR(EIO);
+    if (nb_vec > URL_MAX_IOVEC)
+        return AVERROR(EINVAL);
+
+    for (i = 0; i < nb_vec; i++) {
+        if (vec[i].len > 0)
+            iov[nb_iov++] = vec[i];
+        size += vec[i].len;
+    }
+    if (size > INT_MAX)
+        return AVERROR(EINVAL);
+    /* avoid sending too big packets */
+    if (h->max_packet_size && size > h->max_packet_size)
+        return AVERROR(EIO);
+
+    if (!h->prot->url_writev) {
+        for (i = 0; i < nb_iov; i++) {
+            ret = ffurl_write(h, iov[i].base, iov[i].len);
+            if (ret < 0)
+                return ret;
+        }
+        return size;
+    }
+
+    /* same retry logic as retry_transfer_wrapper(), but a short write
+     * may end in the middle of any of the buffers */
+    while (len < size) {
+        if (ff_check_interrupt(&h->interrupt_callback))
+            return AVERROR_EXIT;
+        ret = h->prot->url_writev(h, iov + first, nb_iov - first);
+        if (ret == AVERROR(EINTR))
+            continue;
+        if (h->flags & AVIO_FLAG_NONBLOCK)
+            return ret;
+        if (ret == AVERROR(EAGAIN)) {
+            ret = 0;
+            if (fast_retries) {
+                fast_retries--;
+            } else {
+                if (h->rw_timeout) {
+                    if (!wait_since)
+                        wait_since = av_gettime_relative();
+                    else if (av_gettime_relative() > wait_since + h->rw_timeout)
+                        return AVERROR(EIO);
+                }
+                av_usleep(1000);
+            }
+        } else if (ret == AVERROR_EOF)
+            return (len > 0) ? len : AVERROR_EOF;
+        else if (ret < 0)
+            return ret;
+        if (ret) {
+            fast_retries = FFMAX(fast_retries, 2);
+            wait_since = 0;
+        }
+        len += ret;
+        while (first < nb_iov && ret >= iov[first].len)
+            ret -= iov[first++].len;
+        if (ret) {
+            iov[first].base += ret;
+            iov[first].len  -= ret;
+        }
+    }
+    return len;
+}
+
 int64_t ffurl_seek(URLContext *h, int64_t pos, int whence)
 {
     int64_t ret;
@@ -157,10 +157,27 @@ void avio_context_free(AVIOContext **ps)
     av_freep(ps);
 }
 
+static void writeout_done(AVIOContext *s, int len, int ret)
+{
+    if (ret < 0) {
+        s->error = ret;
+    } else {
+        if (s->pos + len > s->written)
+            s->written = s->pos + len;
+    }
+    if (s->current_type == AVIO_DATA_MARKER_SYNC_POINT ||
+        s->current_type == AVIO_DATA_MARKER_BOUNDARY_POINT) {
+        s->current_type = AVIO_DATA_MARKER_UNKNOWN;
+    }
+    s->last_time = AV_NOPTS_VALUE;
+    s->writeout_count ++;
+    s->pos += len;
+}
+
 static void writeout(AVIOContext *s, const uint8_t *data, int len)
 {
+    int ret = 0;
     if (!s->error) {
-        int ret = 0;
         if (s->write_data_type)
             ret = s->write_data_type(s->opaque, (uint8_t *)data,
                                      len,
@@ -168,20 +185,49 @@ static void writeout(AVIOContext *s, const uint8_t *data, int len)
                                      s->last_time);
         else if (s->write_packet)
             ret = s->write_packet(s->opaque, (uint8_t *)data, len);
-        if (ret < 0) {
-            s->error = ret;
-        } else {
-            if (s->pos + len > s->written)
-                s->written = s->pos + len;
-        }
-    }
-    if (s->current_type == AVIO_DATA_MARKER_SYNC_POINT ||
-        s->current_type == AVIO_DATA_MARKER_BOUNDARY_POINT) {
-        s->current_type = AVIO_DATA_MARKER_UNKNOWN;
     }
-    s->last_time = AV_NOPTS_VALUE;
-    s->writeout_count ++;
-    s->pos += len;
+    writeout_done(s, len, ret);
+}
+
+/**
+ * Write the buffered bytes followed by data with scatter-gather calls of
+ * the underlying protocol, without copying data into the buffer. Packetized
+ * protocols get the same max_packet_size sized writes as through the buffer;
+ * a trailing partial packet is left to the caller.
+ *
+ * @return the number of bytes of data consumed, or AVERROR(ENOSYS) if the
+ *         context cannot do vectored writes
+ */
+static int writeout_vec(AVIOContext *s, const uint8_t *data, int len)
+{
+    URLContext *h = ffio_geturlcontext(s);
+    int buffered = s->buf_ptr - s->buffer;
+    int max_size, done = 0;
+
+    if (!h || !h->prot->url_writev || s->write_data_type ||
+        s->write_packet != (int (*)(void *, uint8_t *, int))ffurl_write)
+        return AVERROR(ENOSYS);
+    max_size = h->max_packet_size ? h->max_packet_size : INT_MAX;
+    if (buffered >= max_size)
+        return AVERROR(ENOSYS);
+
+    do {
+        URLIOVec vec[2];
+        int nb_vec = 0, ret = 0;
+        int n = FFMIN(len - done, max_size - buffered);
+
+        if (buffered)
+            vec[nb_vec++] = (URLIOVec){ s->buffer, buffered };
+        vec[nb_vec++] = (URLIOVec){ data + done, n };
+        if (!s->error)
+            ret = ffurl_writev(h, vec, nb_vec);
+        writeout_done(s, buffered + n, ret);
+        buffered = 0;
+        done    += n;
+    } while (len - done >= max_size);
+
+    s->buf_ptr = s->buf_ptr_max = s->buffer;
+    return done;
 }
 
 static void flush_buffer(AVIOContext *s)
@@ -229,6 +275,17 @@ void avio_write(AVIOContext *s, const unsigned char *buf, int size)
         writeout(s, buf, size);
         return;
     }
+    /* Payloads that would fill the buffer anyway are handed to the
+     * protocol together with the pending bytes instead of being copied,
+     * unless the caller has seeked back into the buffer. */
+    if (size >= s->buffer_size && !s->update_checksum && s->write_flag &&
+        s->buf_ptr >= s->buf_ptr_max) {
+        int ret = writeout_vec(s, buf, size);
+        if (ret >= 0) {
+            buf  += ret;
+            size -= ret;
+        }
+    }
     while (size > 0) {
         int len = FFMIN(s->buf_end - s->buf_ptr, size);
         memcpy(s->buf_ptr, buf, len);
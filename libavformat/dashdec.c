@@ -27,10 +27,12 @@
 #include "internal.h"
 #include "avio_internal.h"
 #include "dash.h"
+#include "prefetch.h"
 
 #define INITIAL_BUFFER_SIZE 32768
 #define MAX_BPRINT_READ_SIZE (UINT_MAX - 1)
 #define DEFAULT_MANIFEST_SIZE 8 * 1024
+#define MAX_PREFETCH 16
 
 struct fragment {
     int64_t url_offset;
@@ -69,6 +71,13 @@ struct timeline {
     int64_t duration;
 };
 
+/* A fragment being downloaded ahead of the one being read. */
+struct prefetch {
+    char *url;
+    int64_t url_offset;
+    PrefetchDownload *download;
+};
+
 /*
  * Each playlist has its own demuxer. If it is currently active,
  * it has an opened AVIOContext too, and potentially an AVPacket
@@ -93,6 +102,11 @@ struct representation {
 
     int n_timelines;
     struct timeline **timelines;
+    /* set when only the SegmentTimeline entries that were not known before
+     * a manifest refresh were parsed; timeline_start is the start time of
+     * the first entry in the new manifest */
+    int timelines_incremental;
+    int64_t timeline_start;
 
     int64_t first_seq_no;
     int64_t last_seq_no;
@@ -116,6 +130,12 @@ struct representation {
     uint32_t init_sec_buf_read_offset;
     int64_t cur_timestamp;
     int is_restart_needed;
+
+    struct prefetch prefetch[MAX_PREFETCH];
+    int n_prefetch;
+    PrefetchDownload *cur_download; /* the current fragment is read from this if set */
+    int64_t prefetch_hits;
+    int64_t prefetch_misses;
 };
 
 typedef struct DASHContext {
@@ -157,6 +177,16 @@ typedef struct DASHContext {
     int is_init_section_common_audio;
     int is_init_section_common_subtitle;
 
+    /* representations in use while the manifest is refreshed */
+    int n_old_videos;
+    struct representation **old_videos;
+    int n_old_audios;
+    struct representation **old_audios;
+
+    int prefetch;
+    int prefetch_buffer_size;
+    int64_t prefetch_hits;
+    int64_t prefetch_misses;
 } DASHContext;
 
 static int ishttp(char *url)
@@ -314,6 +344,25 @@ finish:
     return num;
 }
 
+/* End time of the last segment of the timeline, -1 if it is open-ended. */
+static int64_t get_timelines_end(struct representation *pls)
+{
+    int64_t end = 0;
+    int i;
+
+    if (!pls->n_timelines)
+        return -1;
+    for (i = 0; i < pls->n_timelines; i++) {
+        struct timeline *tml = pls->timelines[i];
+        if (tml->repeat < 0 || tml->duration <= 0)
+            return -1;
+        if (tml->starttime > 0)
+            end = tml->starttime;
+        end += tml->duration * (tml->repeat + 1);
+    }
+    return end;
+}
+
 static void free_fragment(struct fragment **seg)
 {
     if (!(*seg)) {
@@ -345,8 +394,29 @@ static void free_timelines_list(struct representation *pls)
     pls->n_timelines = 0;
 }
 
+static void prefetch_free(struct prefetch *p)
+{
+    ff_prefetch_free(&p->download);
+    av_freep(&p->url);
+}
+
+static void prefetch_close(struct representation *pls)
+{
+    int i;
+
+    for (i = 0; i < pls->n_prefetch; i++)
+        prefetch_free(&pls->prefetch[i]);
+    pls->n_prefetch = 0;
+    ff_prefetch_free(&pls->cur_download);
+}
+
 static void free_representation(struct representation *pls)
 {
+    prefetch_close(pls);
+    if (pls->prefetch_hits || pls->prefetch_misses)
+        av_log(pls->parent, AV_LOG_VERBOSE,
+               "Stream %d: %"PRId64" prefetched fragments used, %"PRId64" missed\n",
+               pls->stream_index, pls->prefetch_hits, pls->prefetch_misses);
     free_fragment_list(pls);
     free_timelines_list(pls);
     free_fragment(&pls->cur_seg);
@@ -398,13 +468,10 @@ static void free_subtitle_list(DASHContext *c)
     c->n_subtitles = 0;
 }
 
-static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
-                    AVDictionary **opts, AVDictionary *opts2, int *is_http)
+static int check_url(AVFormatContext *s, const char *url, int *is_http)
 {
     DASHContext *c = s->priv_data;
-    AVDictionary *tmp = NULL;
     const char *proto_name = NULL;
-    int ret;
 
     if (av_strstart(url, "crypto", NULL)) {
         if (url[6] == '+' || url[6] == ':')
@@ -438,6 +505,22 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     else if (strcmp(proto_name, "file") || !strncmp(url, "file,", 5))
         return AVERROR_INVALIDDATA;
 
+    if (is_http)
+        *is_http = av_strstart(proto_name, "http", NULL);
+
+    return 0;
+}
+
+static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
+                    AVDictionary **opts, AVDictionary *opts2, int *is_http)
+{
+    DASHContext *c = s->priv_data;
+    AVDictionary *tmp = NULL;
+    int ret;
+
+    if ((ret = check_url(s, url, is_http)) < 0)
+        return ret;
+
     av_freep(pb);
     av_dict_copy(&tmp, *opts, 0);
     av_dict_copy(&tmp, opts2, 0);
@@ -457,9 +540,6 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
 
     av_dict_free(&tmp);
 
-    if (is_http)
-        *is_http = av_strstart(proto_name, "http", NULL);
-
     return ret;
 }
 
@@ -657,43 +737,96 @@ static int parse_manifest_segmenturlnode(AVFormatContext *s, struct representati
     return 0;
 }
 
-static int parse_manifest_segmenttimeline(AVFormatContext *s, struct representation *rep,
+static int parse_manifest_segmenttimeline(AVFormatContext *s, struct timeline *tml,
                                           xmlNodePtr fragment_timeline_node)
 {
     xmlAttrPtr attr = NULL;
     char *val  = NULL;
-    int err;
 
-    if (!av_strcasecmp(fragment_timeline_node->name, "S")) {
-        struct timeline *tml = av_mallocz(sizeof(struct timeline));
-        if (!tml) {
-            return AVERROR(ENOMEM);
+    if (av_strcasecmp(fragment_timeline_node->name, "S"))
+        return 0;
+
+    attr = fragment_timeline_node->properties;
+    while (attr) {
+        val = xmlGetProp(fragment_timeline_node, attr->name);
+
+        if (!val) {
+            av_log(s, AV_LOG_WARNING, "parse_manifest_segmenttimeline attr->name = %s val is NULL\n", attr->name);
+            continue;
         }
-        attr = fragment_timeline_node->properties;
-        while (attr) {
-            val = xmlGetProp(fragment_timeline_node, attr->name);
 
-            if (!val) {
-                av_log(s, AV_LOG_WARNING, "parse_manifest_segmenttimeline attr->name = %s val is NULL\n", attr->name);
-                continue;
-            }
+        if (!av_strcasecmp(attr->name, "t")) {
+            tml->starttime = (int64_t)strtoll(val, NULL, 10);
+        } else if (!av_strcasecmp(attr->name, "r")) {
+            tml->repeat =(int64_t) strtoll(val, NULL, 10);
+        } else if (!av_strcasecmp(attr->name, "d")) {
+            tml->duration = (int64_t)strtoll(val, NULL, 10);
+        }
+        attr = attr->next;
+        xmlFree(val);
+    }
+
+    return 1;
+}
+
+/*
+ * Parse the S elements of a SegmentTimeline. When the manifest is refreshed,
+ * old is the representation currently in use and only the segments that
+ * come after its timeline are kept; merge_timelines() puts them together.
+ */
+static int parse_manifest_segmenttimelines(AVFormatContext *s, struct representation *rep,
+                                           xmlNodePtr fragment_timeline_node,
+                                           struct representation *old)
+{
+    int64_t known_end = old ? get_timelines_end(old) : -1;
+    int64_t start, end;
+    xmlNodePtr node;
+    int first, err;
+
+restart:
+    end   = 0;
+    first = 1;
+    for (node = xmlFirstElementChild(fragment_timeline_node); node;
+         node = xmlNextElementSibling(node)) {
+        struct timeline tml = { 0 }, *new_tml;
 
-            if (!av_strcasecmp(attr->name, "t")) {
-                tml->starttime = (int64_t)strtoll(val, NULL, 10);
-            } else if (!av_strcasecmp(attr->name, "r")) {
-                tml->repeat =(int64_t) strtoll(val, NULL, 10);
-            } else if (!av_strcasecmp(attr->name, "d")) {
-                tml->duration = (int64_t)strtoll(val, NULL, 10);
+        if (!parse_manifest_segmenttimeline(s, &tml, node))
+            continue;
+
+        start = tml.starttime > 0 ? tml.starttime : end;
+        end   = start + tml.duration * (tml.repeat + 1);
+        if (first)
+            rep->timeline_start = start;
+        first = 0;
+
+        if (known_end >= 0) {
+            if (tml.repeat < 0 || tml.duration <= 0) {
+                /* cannot tell which segments are new, keep all of them */
+                free_timelines_list(rep);
+                known_end = -1;
+                goto restart;
             }
-            attr = attr->next;
-            xmlFree(val);
+            if (end <= known_end)
+                continue;
+            if (start < known_end) {
+                int64_t known = (known_end - start + tml.duration - 1) / tml.duration;
+                start      += known * tml.duration;
+                tml.repeat -= known;
+            }
+            /* the entries before this one are not part of the list */
+            tml.starttime = start;
         }
-        err = av_dynarray_add_nofree(&rep->timelines, &rep->n_timelines, tml);
+
+        new_tml = av_memdup(&tml, sizeof(tml));
+        if (!new_tml)
+            return AVERROR(ENOMEM);
+        err = av_dynarray_add_nofree(&rep->timelines, &rep->n_timelines, new_tml);
         if (err < 0) {
-            av_free(tml);
+            av_free(new_tml);
             return err;
         }
     }
+    rep->timelines_incremental = known_end >= 0;
 
     return 0;
 }
@@ -845,6 +978,7 @@ static int parse_manifest_representation(AVFormatContext *s, const char *url,
     xmlNodePtr representation_node = node;
     char *rep_bandwidth_val;
     enum AVMediaType type = AVMEDIA_TYPE_UNKNOWN;
+    struct representation *old = NULL;
 
     // try get information from representation
     if (type == AVMEDIA_TYPE_UNKNOWN)
@@ -861,6 +995,12 @@ static int parse_manifest_representation(AVFormatContext *s, const char *url,
         return 0;
     }
 
+    // representation this one replaces if the manifest is being refreshed
+    if (type == AVMEDIA_TYPE_VIDEO && c->n_videos < c->n_old_videos)
+        old = c->old_videos[c->n_videos];
+    else if (type == AVMEDIA_TYPE_AUDIO && c->n_audios < c->n_old_audios)
+        old = c->old_audios[c->n_audios];
+
     // convert selected representation to our internal struct
     rep = av_mallocz(sizeof(struct representation));
     if (!rep)
@@ -974,13 +1114,9 @@ static int parse_manifest_representation(AVFormatContext *s, const char *url,
         if (!fragment_timeline_node)
             fragment_timeline_node = find_child_node_by_name(period_segmentlist_node, "SegmentTimeline");
         if (fragment_timeline_node) {
-            fragment_timeline_node = xmlFirstElementChild(fragment_timeline_node);
-            while (fragment_timeline_node) {
-                ret = parse_manifest_segmenttimeline(s, rep, fragment_timeline_node);
-                if (ret < 0)
-                    goto free;
-                fragment_timeline_node = xmlNextElementSibling(fragment_timeline_node);
-            }
+            ret = parse_manifest_segmenttimelines(s, rep, fragment_timeline_node, old);
+            if (ret < 0)
+                goto free;
         }
     } else if (representation_baseurl_node && !representation_segmentlist_node) {
         seg = av_mallocz(sizeof(struct fragment));
@@ -1037,13 +1173,9 @@ static int parse_manifest_representation(AVFormatContext *s, const char *url,
         if (!fragment_timeline_node)
             fragment_timeline_node = find_child_node_by_name(period_segmentlist_node, "SegmentTimeline");
         if (fragment_timeline_node) {
-            fragment_timeline_node = xmlFirstElementChild(fragment_timeline_node);
-            while (fragment_timeline_node) {
-                ret = parse_manifest_segmenttimeline(s, rep, fragment_timeline_node);
-                if (ret < 0)
-                    goto free;
-                fragment_timeline_node = xmlNextElementSibling(fragment_timeline_node);
-            }
+            ret = parse_manifest_segmenttimelines(s, rep, fragment_timeline_node, old);
+            if (ret < 0)
+                goto free;
         }
     } else {
         av_log(s, AV_LOG_ERROR, "Unknown format of Representation node id '%s' \n",
@@ -1465,6 +1597,85 @@ static void move_timelines(struct representation *rep_src, struct representation
     }
 }
 
+/*
+ * Counterpart of move_timelines() for a timeline that was parsed
+ * incrementally: drop the segments of rep_dest that are not in the new
+ * manifest anymore and append the new ones from rep_src.
+ */
+static int merge_timelines(struct representation *rep_src, struct representation *rep_dest,
+                           DASHContext *c, int64_t cur_time)
+{
+    struct representation merged = { 0 };
+    struct timeline *split = NULL;
+    int64_t start = 0, seq_no;
+    int i, n_old, first = rep_dest->n_timelines;
+
+    for (i = 0; i < rep_dest->n_timelines; i++) {
+        struct timeline *tml = rep_dest->timelines[i];
+        int64_t end;
+
+        if (tml->starttime > 0)
+            start = tml->starttime;
+        end = start + tml->duration * (tml->repeat + 1);
+        if (end > rep_src->timeline_start) {
+            first = i;
+            /* the start time of the first kept entry may be implied by the
+             * expired ones, so replace it by a copy with an explicit one,
+             * without the segments that expired */
+            if (first > 0 || start < rep_src->timeline_start) {
+                int64_t expired = start < rep_src->timeline_start ?
+                                  (rep_src->timeline_start - start) / tml->duration : 0;
+                split = av_memdup(tml, sizeof(*tml));
+                if (!split)
+                    return AVERROR(ENOMEM);
+                split->starttime = start + expired * tml->duration;
+                split->repeat   -= expired;
+            }
+            break;
+        }
+        start = end;
+    }
+
+    n_old = rep_dest->n_timelines - first;
+    merged.n_timelines = n_old + rep_src->n_timelines;
+    merged.timelines   = av_malloc_array(merged.n_timelines, sizeof(*merged.timelines));
+    if (!merged.timelines) {
+        av_free(split);
+        return merged.n_timelines ? AVERROR(ENOMEM) : 0;
+    }
+    memcpy(merged.timelines, rep_dest->timelines + first, n_old * sizeof(*merged.timelines));
+    memcpy(merged.timelines + n_old, rep_src->timelines,
+           rep_src->n_timelines * sizeof(*merged.timelines));
+    if (split)
+        merged.timelines[0] = split;
+
+    /* same as when the timeline was not moved by refresh_manifest() */
+    seq_no = calc_next_seg_no_from_timelines(&merged, cur_time);
+    if (seq_no < 0) {
+        av_free(split);
+        av_free(merged.timelines);
+        return 0;
+    }
+
+    av_log(rep_dest->parent, AV_LOG_DEBUG,
+           "Timeline refreshed: %d entries expired, %d added\n",
+           first, rep_src->n_timelines);
+    for (i = 0; i < first; i++)
+        av_free(rep_dest->timelines[i]);
+    if (split)
+        av_free(rep_dest->timelines[first]);
+    av_free(rep_dest->timelines);
+    rep_dest->timelines   = merged.timelines;
+    rep_dest->n_timelines = merged.n_timelines;
+    av_freep(&rep_src->timelines);
+    rep_src->n_timelines = 0;
+
+    rep_dest->first_seq_no = rep_src->first_seq_no;
+    rep_dest->last_seq_no  = calc_max_seg_no(rep_dest, c);
+    rep_dest->cur_seq_no   = seq_no;
+    return 0;
+}
+
 static void move_segments(struct representation *rep_src, struct representation *rep_dest, DASHContext *c)
 {
     if (rep_dest && rep_src ) {
@@ -1503,7 +1714,15 @@ static int refresh_manifest(AVFormatContext *s)
     c->audios = NULL;
     c->n_subtitles = 0;
     c->subtitles = NULL;
+    c->n_old_videos = n_videos;
+    c->old_videos = videos;
+    c->n_old_audios = n_audios;
+    c->old_audios = audios;
     ret = parse_manifest(s, s->url, NULL);
+    c->n_old_videos = 0;
+    c->old_videos = NULL;
+    c->n_old_audios = 0;
+    c->old_audios = NULL;
     if (ret)
         goto finish;
 
@@ -1533,9 +1752,15 @@ static int refresh_manifest(AVFormatContext *s)
             // calc current time
             int64_t currentTime = get_segment_start_time_based_on_timeline(cur_video, cur_video->cur_seq_no) / cur_video->fragment_timescale;
             // update segments
-            ccur_video->cur_seq_no = calc_next_seg_no_from_timelines(ccur_video, currentTime * cur_video->fragment_timescale - 1);
-            if (ccur_video->cur_seq_no >= 0) {
-                move_timelines(ccur_video, cur_video, c);
+            if (ccur_video->timelines_incremental) {
+                ret = merge_timelines(ccur_video, cur_video, c, currentTime * cur_video->fragment_timescale - 1);
+                if (ret < 0)
+                    goto finish;
+            } else {
+                ccur_video->cur_seq_no = calc_next_seg_no_from_timelines(ccur_video, currentTime * cur_video->fragment_timescale - 1);
+                if (ccur_video->cur_seq_no >= 0) {
+                    move_timelines(ccur_video, cur_video, c);
+                }
             }
         }
         if (cur_video->fragments) {
@@ -1549,9 +1774,15 @@ static int refresh_manifest(AVFormatContext *s)
             // calc current time
             int64_t currentTime = get_segment_start_time_based_on_timeline(cur_audio, cur_audio->cur_seq_no) / cur_audio->fragment_timescale;
             // update segments
-            ccur_audio->cur_seq_no = calc_next_seg_no_from_timelines(ccur_audio, currentTime * cur_audio->fragment_timescale - 1);
-            if (ccur_audio->cur_seq_no >= 0) {
-                move_timelines(ccur_audio, cur_audio, c);
+            if (ccur_audio->timelines_incremental) {
+                ret = merge_timelines(ccur_audio, cur_audio, c, currentTime * cur_audio->fragment_timescale - 1);
+                if (ret < 0)
+                    goto finish;
+            } else {
+                ccur_audio->cur_seq_no = calc_next_seg_no_from_timelines(ccur_audio, currentTime * cur_audio->fragment_timescale - 1);
+                if (ccur_audio->cur_seq_no >= 0) {
+                    move_timelines(ccur_audio, cur_audio, c);
+                }
             }
         }
         if (cur_audio->fragments) {
@@ -1582,6 +1813,43 @@ finish:
     return ret;
 }
 
+static struct fragment *get_template_fragment(struct representation *pls, int64_t seq_no)
+{
+    DASHContext *c = pls->parent->priv_data;
+    struct fragment *seg;
+    char *tmpfilename;
+
+    if (!pls->url_template) {
+        av_log(pls->parent, AV_LOG_ERROR, "Cannot get fragment, missing template URL\n");
+        return NULL;
+    }
+    seg = av_mallocz(sizeof(struct fragment));
+    if (!seg) {
+        return NULL;
+    }
+    tmpfilename = av_mallocz(c->max_url_size);
+    if (!tmpfilename) {
+        av_free(seg);
+        return NULL;
+    }
+    ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, seq_no, 0, get_segment_start_time_based_on_timeline(pls, seq_no));
+    seg->url = av_strireplace(pls->url_template, pls->url_template, tmpfilename);
+    if (!seg->url) {
+        av_log(pls->parent, AV_LOG_WARNING, "Unable to resolve template url '%s', try to use origin template\n", pls->url_template);
+        seg->url = av_strdup(pls->url_template);
+        if (!seg->url) {
+            av_log(pls->parent, AV_LOG_ERROR, "Cannot resolve template url '%s'\n", pls->url_template);
+            av_free(tmpfilename);
+            av_free(seg);
+            return NULL;
+        }
+    }
+    av_free(tmpfilename);
+    seg->size = -1;
+
+    return seg;
+}
+
 static struct fragment *get_current_fragment(struct representation *pls)
 {
     int64_t min_seq_no = 0;
@@ -1624,42 +1892,9 @@ static struct fragment *get_current_fragment(struct representation *pls)
         } else if (pls->cur_seq_no > max_seq_no) {
             av_log(pls->parent, AV_LOG_VERBOSE, "new fragment: min[%"PRId64"] max[%"PRId64"]\n", min_seq_no, max_seq_no);
         }
-        seg = av_mallocz(sizeof(struct fragment));
-        if (!seg) {
-            return NULL;
-        }
+        seg = get_template_fragment(pls, pls->cur_seq_no);
     } else if (pls->cur_seq_no <= pls->last_seq_no) {
-        seg = av_mallocz(sizeof(struct fragment));
-        if (!seg) {
-            return NULL;
-        }
-    }
-    if (seg) {
-        char *tmpfilename;
-        if (!pls->url_template) {
-            av_log(pls->parent, AV_LOG_ERROR, "Cannot get fragment, missing template URL\n");
-            av_free(seg);
-            return NULL;
-        }
-        tmpfilename = av_mallocz(c->max_url_size);
-        if (!tmpfilename) {
-            av_free(seg);
-            return NULL;
-        }
-        ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, pls->cur_seq_no, 0, get_segment_start_time_based_on_timeline(pls, pls->cur_seq_no));
-        seg->url = av_strireplace(pls->url_template, pls->url_template, tmpfilename);
-        if (!seg->url) {
-            av_log(pls->parent, AV_LOG_WARNING, "Unable to resolve template url '%s', try to use origin template\n", pls->url_template);
-            seg->url = av_strdup(pls->url_template);
-            if (!seg->url) {
-                av_log(pls->parent, AV_LOG_ERROR, "Cannot resolve template url '%s'\n", pls->url_template);
-                av_free(tmpfilename);
-                av_free(seg);
-                return NULL;
-            }
-        }
-        av_free(tmpfilename);
-        seg->size = -1;
+        seg = get_template_fragment(pls, pls->cur_seq_no);
     }
 
     return seg;
@@ -1674,7 +1909,10 @@ static int read_from_url(struct representation *pls, struct fragment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, pls->cur_seg_size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    if (pls->cur_download)
+        ret = ff_prefetch_read(pls->cur_download, buf, buf_size);
+    else
+        ret = avio_read(pls->input, buf, buf_size);
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1713,6 +1951,120 @@ cleanup:
     return ret;
 }
 
+static int prefetch_start(DASHContext *c, struct representation *pls,
+                          struct prefetch *p, const struct fragment *seg)
+{
+    AVDictionary *opts = NULL;
+    char *url;
+    int ret;
+
+    url = av_mallocz(c->max_url_size);
+    if (!url)
+        return AVERROR(ENOMEM);
+    ff_make_absolute_url(url, c->max_url_size, c->base_url, seg->url);
+    if ((ret = check_url(pls->parent, url, NULL)) < 0)
+        goto cleanup;
+
+    if ((ret = av_dict_copy(&opts, c->avio_opts, 0)) < 0)
+        goto cleanup;
+    if (seg->size >= 0) {
+        av_dict_set_int(&opts, "offset", seg->url_offset, 0);
+        av_dict_set_int(&opts, "end_offset", seg->url_offset + seg->size, 0);
+    }
+    ret = ff_prefetch_start(&p->download, pls->parent, url, opts, 0, seg->size,
+                            c->prefetch_buffer_size, 0);
+    if (ret < 0)
+        goto cleanup;
+    av_log(pls->parent, AV_LOG_DEBUG, "Prefetching url '%s', offset %"PRId64"\n",
+           url, seg->url_offset);
+
+    p->url_offset = seg->url_offset;
+    p->url = av_strdup(seg->url);
+    if (!p->url) {
+        ff_prefetch_free(&p->download);
+        ret = AVERROR(ENOMEM);
+    }
+
+cleanup:
+    av_dict_free(&opts);
+    av_free(url);
+    return ret;
+}
+
+/* Keep downloads running for the fragments following the current one. */
+static void prefetch_fragments(DASHContext *c, struct representation *pls)
+{
+    struct prefetch old[MAX_PREFETCH];
+    int64_t seq_no, last_seq_no;
+    int i, n_old = pls->n_prefetch;
+
+    if (pls->n_fragments)
+        last_seq_no = pls->n_fragments - 1;
+    else if (c->is_live)
+        last_seq_no = calc_max_seg_no(pls, c);
+    else
+        last_seq_no = pls->last_seq_no;
+    last_seq_no = FFMIN(last_seq_no, pls->cur_seq_no + c->prefetch);
+
+    memcpy(old, pls->prefetch, n_old * sizeof(*old));
+    pls->n_prefetch = 0;
+    for (seq_no = pls->cur_seq_no + 1; seq_no <= last_seq_no; seq_no++) {
+        struct fragment *tmpl = NULL;
+        const struct fragment *seg;
+        struct prefetch *p = &pls->prefetch[pls->n_prefetch];
+
+        if (pls->n_fragments) {
+            seg = pls->fragments[seq_no];
+        } else {
+            seg = tmpl = get_template_fragment(pls, seq_no);
+            if (!seg)
+                break;
+        }
+
+        for (i = 0; i < n_old; i++)
+            if (old[i].download && !strcmp(old[i].url, seg->url) &&
+                old[i].url_offset == seg->url_offset)
+                break;
+        if (i < n_old) {
+            *p = old[i];
+            memset(&old[i], 0, sizeof(old[i]));
+            pls->n_prefetch++;
+        } else if (prefetch_start(c, pls, p, seg) >= 0) {
+            pls->n_prefetch++;
+        }
+        free_fragment(&tmpl);
+    }
+    for (i = 0; i < n_old; i++)
+        prefetch_free(&old[i]);
+}
+
+/* Use the download of seg as the current input, if there is one. */
+static int prefetch_take(DASHContext *c, struct representation *pls, struct fragment *seg)
+{
+    int i;
+
+    if (!c->prefetch)
+        return 0;
+    for (i = 0; i < pls->n_prefetch; i++) {
+        struct prefetch *p = &pls->prefetch[i];
+        if (!strcmp(p->url, seg->url) && p->url_offset == seg->url_offset) {
+            pls->cur_download = p->download;
+            p->download = NULL;
+            prefetch_free(p);
+            memmove(p, p + 1, (pls->n_prefetch - i - 1) * sizeof(*p));
+            pls->n_prefetch--;
+            pls->cur_seg_offset = 0;
+            pls->cur_seg_size = seg->size;
+            pls->prefetch_hits++;
+            c->prefetch_hits++;
+            return 1;
+        }
+    }
+    pls->prefetch_misses++;
+    c->prefetch_misses++;
+    return 0;
+}
+
 static int update_init_section(struct representation *pls)
 {
     static const int max_init_section_size = 1024 * 1024;
@@ -1762,7 +2114,7 @@ static int update_init_section(struct representation *pls)
 static int64_t seek_data(void *opaque, int64_t offset, int whence)
 {
     struct representation *v = opaque;
-    if (v->n_fragments && !v->init_sec_data_len) {
+    if (v->n_fragments && !v->init_sec_data_len && !v->cur_download) {
         return avio_seek(v->input, offset, whence);
     }
 
@@ -1776,7 +2128,7 @@ static int read_data(void *opaque, uint8_t *buf, int buf_size)
     DASHContext *c = v->parent->priv_data;
 
 restart:
-    if (!v->input) {
+    if (!v->input && !v->cur_download) {
         free_fragment(&v->cur_seg);
         v->cur_seg = get_current_fragment(v);
         if (!v->cur_seg) {
@@ -1789,7 +2141,8 @@ restart:
         if (ret)
             goto end;
 
-        ret = open_input(c, v, v->cur_seg);
+        if (!prefetch_take(c, v, v->cur_seg))
+            ret = open_input(c, v, v->cur_seg);
         if (ret < 0) {
             if (ff_check_interrupt(c->interrupt_callback)) {
                 ret = AVERROR_EXIT;
@@ -1799,6 +2152,8 @@ restart:
             v->cur_seq_no++;
             goto restart;
         }
+        if (c->prefetch)
+            prefetch_fragments(c, v);
     }
 
     if (v->init_sec_buf_read_offset < v->init_sec_data_len) {
@@ -1821,6 +2176,14 @@ restart:
     ret = read_from_url(v, v->cur_seg, buf, buf_size);
     if (ret > 0)
         goto end;
+    if (v->cur_download && !v->cur_seg_offset && ret != AVERROR_EOF &&
+        ret != AVERROR_EXIT) {
+        /* the fragment may not have been available yet, open it again */
+        ff_prefetch_free(&v->cur_download);
+        v->prefetch_hits--;
+        c->prefetch_hits--;
+        goto restart;
+    }
 
     if (c->is_live || v->cur_seq_no < v->last_seq_no) {
         if (!v->is_restart_needed)
@@ -2061,6 +2424,13 @@ static int dash_read_header(AVFormatContext *s)
     if ((ret = save_avio_options(s)) < 0)
         goto fail;
 
+    if (c->prefetch && (s->flags & AVFMT_FLAG_CUSTOM_IO || !HAVE_THREADS ||
+                        !ff_format_io_is_default(s))) {
+        av_log(s, AV_LOG_WARNING,
+               "Prefetching is not supported with custom IO or without threads\n");
+        c->prefetch = 0;
+    }
+
     if ((ret = parse_manifest(s, s->url, s->pb)) < 0)
         goto fail;
 
@@ -2190,6 +2560,7 @@ static void recheck_discard_flags(AVFormatContext *s, struct representation **p,
         } else if (!needed && pls->ctx) {
             close_demux_for_component(pls);
             ff_format_io_close(pls->parent, &pls->input);
+            prefetch_close(pls);
             av_log(s, AV_LOG_INFO, "No longer receiving stream_index %d\n", pls->stream_index);
         }
     }
@@ -2251,6 +2622,7 @@ static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
             cur->cur_seg_offset = 0;
             cur->init_sec_buf_read_offset = 0;
             ff_format_io_close(cur->parent, &cur->input);
+            ff_prefetch_free(&cur->cur_download);
             ret = reopen_demux_for_component(s, cur);
             cur->is_restart_needed = 0;
         }
@@ -2290,6 +2662,7 @@ static int dash_seek(AVFormatContext *s, struct representation *pls, int64_t see
     }
 
     ff_format_io_close(pls->parent, &pls->input);
+    ff_prefetch_free(&pls->cur_download);
 
     // find the nearest fragment
     if (pls->n_timelines > 0 && pls->fragment_timescale > 0) {
@@ -2387,6 +2760,16 @@ static const AVOption dash_options[] = {
         OFFSET(allowed_extensions), AV_OPT_TYPE_STRING,
         {.str = "aac,m4a,m4s,m4v,mov,mp4,webm,ts"},
         INT_MIN, INT_MAX, FLAGS},
+    {"prefetch", "Number of fragments to download ahead of the current one",
+        OFFSET(prefetch), AV_OPT_TYPE_INT, {.i64 = 0}, 0, MAX_PREFETCH, FLAGS},
+    {"prefetch_buffer_size", "Maximum amount of data buffered for each prefetched fragment",
+        OFFSET(prefetch_buffer_size), AV_OPT_TYPE_INT, {.i64 = 4 << 20}, 4096, INT_MAX, FLAGS},
+    {"prefetch_hits", "Number of fragments read from a prefetched download",
+        OFFSET(prefetch_hits), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX,
+        FLAGS | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY},
+    {"prefetch_misses", "Number of fragments opened because they were not prefetched",
+        OFFSET(prefetch_misses), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX,
+        FLAGS | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY},
     {NULL}
 };
 
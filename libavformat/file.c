@@ -19,6 +19,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _DEFAULT_SOURCE /* madvise(), syscall() and MAP_POPULATE */
+
 #include "libavutil/avstring.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
@@ -34,6 +36,17 @@
 #include <unistd.h>
 #endif
 #include <sys/stat.h>
+#if HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#if HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#endif
 #include <stdlib.h>
 #include "os_support.h"
 #include "url.h"
@@ -74,6 +87,19 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int use_io_uring;
+    int uring_depth;
+    int uring_block_size;
+    struct FileUring *uring;
+    int use_mmap;
+    uint8_t *map;
+    int64_t map_size;
+    int64_t map_pos;
+    int64_t map_run;            ///< bytes read since the last seek
+    int64_t map_prefetched;     ///< end of the range advised with MADV_WILLNEED
+    int64_t map_unchecked;      ///< bytes read since the file size was checked
+    int map_advice;
+    long page_size;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -84,6 +110,10 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "mmap", "Read regular files through a memory mapping", offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "io_uring", "Read through io_uring with read-ahead if available", offsetof(FileContext, use_io_uring), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "io_uring_depth", "Number of blocks read ahead with io_uring", offsetof(FileContext, uring_depth), AV_OPT_TYPE_INT, { .i64 = 4 }, 1, 64, AV_OPT_FLAG_DECODING_PARAM },
+    { "io_uring_block_size", "Size of the blocks read ahead with io_uring", offsetof(FileContext, uring_block_size), AV_OPT_TYPE_INT, { .i64 = 262144 }, 4096, 1 << 26, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -106,10 +136,446 @@ static const AVClass pipe_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if HAVE_MMAP
+
+/* Size of the range prefetched ahead of the read position once the file
+ * is read sequentially. */
+#define MAP_READAHEAD (2 << 20)
+/* Bytes read without seeking before access is considered sequential. */
+#define MAP_SEQUENTIAL_THRESHOLD (1 << 20)
+/* Bytes read from the mapping between two checks of the file size. */
+#define MAP_CHECK_INTERVAL (2 << 20)
+
+#if HAVE_MADVISE
+static void map_advise(FileContext *c, int advice)
+{
+    if (c->map_advice != advice && !madvise(c->map, c->map_size, advice))
+        c->map_advice = advice;
+}
+
+static void map_prefetch(FileContext *c)
+{
+    int64_t start = c->map_pos & ~(int64_t)(c->page_size - 1);
+    int64_t end   = FFMIN(start + MAP_READAHEAD, c->map_size);
+
+    /* refill the prefetched range once half of it has been consumed */
+    if (c->map_prefetched - c->map_pos > MAP_READAHEAD / 2 || start >= end)
+        return;
+    madvise(c->map + start, end - start, MADV_WILLNEED);
+    c->map_prefetched = end;
+}
+#endif
+
+/**
+ * Check from time to time that the file still covers the whole mapping:
+ * touching pages past the end of a file truncated since it was mapped
+ * raises SIGBUS. The size is checked once every MAP_CHECK_INTERVAL bytes
+ * read, so that most reads need no system call. If the file shrank, the
+ * mapping is dropped and reads go through read() from then on.
+ *
+ * @return 1 if the mapping can be read, 0 if it was dropped, a negative
+ *         AVERROR code on failure
+ */
+static int map_check(URLContext *h, int size)
+{
+    FileContext *c = h->priv_data;
+    struct stat st;
+
+    if (c->map_unchecked + size <= MAP_CHECK_INTERVAL) {
+        c->map_unchecked += size;
+        return 1;
+    }
+    if (fstat(c->fd, &st) < 0)
+        return AVERROR(errno);
+    if (st.st_size >= c->map_size) {
+        c->map_unchecked = 0;
+        return 1;
+    }
+
+    av_log(h, AV_LOG_WARNING, "File shrank from %"PRId64" to %"PRId64" bytes "
+           "while mapped, falling back to read()\n", c->map_size, (int64_t)st.st_size);
+    munmap(c->map, c->map_size);
+    c->map = NULL;
+    if (lseek(c->fd, c->map_pos, SEEK_SET) < 0)
+        return AVERROR(errno);
+    return 0;
+}
+
+static int map_read(URLContext *h, unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+
+    if (c->map_pos >= c->map_size)
+        return AVERROR_EOF;
+    size = FFMIN3(size, c->blocksize, c->map_size - c->map_pos);
+
+#if HAVE_MADVISE
+    c->map_run += size;
+    if (c->map_run >= MAP_SEQUENTIAL_THRESHOLD) {
+        map_advise(c, MADV_SEQUENTIAL);
+        map_prefetch(c);
+    }
+#endif
+
+    memcpy(buf, c->map + c->map_pos, size);
+    c->map_pos += size;
+    return size;
+}
+
+static int64_t map_seek(FileContext *c, int64_t pos, int whence)
+{
+    if (whence == SEEK_CUR)
+        pos += c->map_pos;
+    else if (whence == SEEK_END)
+        pos += c->map_size;
+    else if (whence != SEEK_SET)
+        return AVERROR(EINVAL);
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+#if HAVE_MADVISE
+    /* Jumping around means the demuxer is looking things up (index tables,
+     * interleaved tracks), so stop the kernel from reading ahead around
+     * every page fault until the file is read sequentially again. */
+    if (pos != c->map_pos) {
+        c->map_run        = 0;
+        c->map_prefetched = 0;
+        map_advise(c, MADV_RANDOM);
+    }
+#endif
+    c->map_pos = pos;
+    return pos;
+}
+
+static int map_open(URLContext *h, int64_t size)
+{
+    FileContext *c = h->priv_data;
+    void *map;
+
+    if (size <= 0 || size > SIZE_MAX)
+        return AVERROR(EINVAL);
+    map = mmap(NULL, size, PROT_READ, MAP_SHARED, c->fd, 0);
+    if (map == MAP_FAILED)
+        return AVERROR(errno);
+
+    c->map        = map;
+    c->map_size   = size;
+    c->map_pos    = 0;
+    c->map_unchecked = 0;
+#if HAVE_MADVISE
+    c->map_advice = MADV_NORMAL;
+    c->page_size  = sysconf(_SC_PAGESIZE);
+    if (c->page_size <= 0)
+        c->page_size = 4096;
+#endif
+    return 0;
+}
+
+#endif /* HAVE_MMAP */
+
+#if HAVE_LINUX_IO_URING_H
+
+/* io_uring read-ahead: a window of up to nb_blocks consecutive blocks
+ * starting at the read position is kept queued in the kernel. */
+
+typedef struct FileUringBlock {
+    struct iovec iov;
+    int64_t offset;             ///< file offset of the block
+    int result;                 ///< bytes read or AVERROR code, once completed
+    int pending;                ///< read submitted but not completed yet
+} FileUringBlock;
+
+typedef struct FileUring {
+    int fd;
+    uint8_t *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+
+    uint8_t *buf;
+    FileUringBlock *blocks;
+    int nb_blocks;
+    int block_size;
+    int fixed;                  ///< block buffers are registered with the ring
+    int first;                  ///< index of the block containing pos
+    int nb_queued;              ///< number of blocks in the window
+    int nb_pending;             ///< number of reads in flight
+    int nb_unsubmitted;         ///< SQEs queued but not yet submitted
+    int64_t next_offset;        ///< file offset of the next block to queue
+    int64_t pos;                ///< current read position
+} FileUring;
+
+static int uring_enter(FileUring *u, unsigned to_submit, unsigned min_complete,
+                       unsigned flags)
+{
+    int ret = syscall(__NR_io_uring_enter, u->fd, to_submit, min_complete,
+                      flags, NULL, 0);
+    return ret < 0 ? AVERROR(errno) : ret;
+}
+
+static void uring_reap(FileUring *u)
+{
+    unsigned head = *u->cq_head;
+    unsigned tail = atomic_load_explicit((atomic_uint *)u->cq_tail,
+                                         memory_order_acquire);
+
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+        FileUringBlock *b = &u->blocks[cqe->user_data];
+
+        b->result  = cqe->res < 0 ? AVERROR(-cqe->res) : cqe->res;
+        b->pending = 0;
+        u->nb_pending--;
+    }
+    atomic_store_explicit((atomic_uint *)u->cq_head, head, memory_order_release);
+}
+
+static int uring_submit(FileUring *u)
+{
+    while (u->nb_unsubmitted) {
+        int ret = uring_enter(u, u->nb_unsubmitted, 0, 0);
+        if (ret == AVERROR(EINTR) || ret == AVERROR(EAGAIN))
+            continue;
+        if (ret < 0)
+            return ret;
+        u->nb_unsubmitted -= ret;
+    }
+    return 0;
+}
+
+static int uring_wait(FileUring *u, FileUringBlock *b)
+{
+    int ret;
+
+    while (1) {
+        uring_reap(u);
+        if (b ? !b->pending : !u->nb_pending)
+            return 0;
+        ret = uring_enter(u, 0, 1, IORING_ENTER_GETEVENTS);
+        if (ret < 0 && ret != AVERROR(EINTR))
+            return ret;
+    }
+}
+
+static void uring_queue_block(FileUring *u, int fd)
+{
+    int idx = (u->first + u->nb_queued) % u->nb_blocks;
+    FileUringBlock *b = &u->blocks[idx];
+    unsigned tail = *u->sq_tail;
+    unsigned slot = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[slot];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd        = fd;
+    sqe->off       = u->next_offset;
+    sqe->user_data = idx;
+    if (u->fixed) {
+        sqe->opcode    = IORING_OP_READ_FIXED;
+        sqe->addr      = (uintptr_t)b->iov.iov_base;
+        sqe->len       = b->iov.iov_len;
+        sqe->buf_index = idx;
+    } else {
+        sqe->opcode    = IORING_OP_READV;
+        sqe->addr      = (uintptr_t)&b->iov;
+        sqe->len       = 1;
+    }
+    u->sq_array[slot] = slot;
+    atomic_store_explicit((atomic_uint *)u->sq_tail, tail + 1,
+                          memory_order_release);
+
+    b->offset  = u->next_offset;
+    b->result  = 0;
+    b->pending = 1;
+    u->next_offset += u->block_size;
+    u->nb_queued++;
+    u->nb_pending++;
+    u->nb_unsubmitted++;
+}
+
+/* Drop the whole window and restart read-ahead at pos. */
+static int uring_reset(FileUring *u, int64_t pos)
+{
+    int ret = uring_wait(u, NULL);
+    u->first       = 0;
+    u->nb_queued   = 0;
+    u->next_offset = pos;
+    u->pos         = pos;
+    return ret;
+}
+
+static void uring_free(FileUring **pu)
+{
+    FileUring *u = *pu;
+
+    if (!u)
+        return;
+    if (u->nb_pending)
+        uring_wait(u, NULL);
+    if (u->fd >= 0)
+        close(u->fd);
+    if (u->sq_ring)
+        munmap(u->sq_ring, u->sq_ring_size);
+    if (u->cq_ring)
+        munmap(u->cq_ring, u->cq_ring_size);
+    if (u->sqes)
+        munmap(u->sqes, u->sqes_size);
+    av_freep(&u->blocks);
+    av_freep(&u->buf);
+    av_freep(pu);
+}
+
+static void *uring_mmap(FileUring *u, size_t size, off_t offset)
+{
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, u->fd, offset);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+static int uring_init(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    struct io_uring_params p = { 0 };
+    struct iovec *iovs;
+    FileUring *u;
+    int i, ret;
+
+    u = av_mallocz(sizeof(*u));
+    if (!u)
+        return AVERROR(ENOMEM);
+    c->uring = u;
+
+    u->fd = syscall(__NR_io_uring_setup, c->uring_depth, &p);
+    if (u->fd < 0)
+        return AVERROR(errno);
+
+    u->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_ring_size = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->sqes_size    = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sq_ring = uring_mmap(u, u->sq_ring_size, IORING_OFF_SQ_RING);
+    u->cq_ring = uring_mmap(u, u->cq_ring_size, IORING_OFF_CQ_RING);
+    u->sqes    = uring_mmap(u, u->sqes_size,    IORING_OFF_SQES);
+    if (!u->sq_ring || !u->cq_ring || !u->sqes)
+        return AVERROR(ENOMEM);
+    u->sq_tail  = (unsigned *)(u->sq_ring + p.sq_off.tail);
+    u->sq_mask  = (unsigned *)(u->sq_ring + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)(u->sq_ring + p.sq_off.array);
+    u->cq_head  = (unsigned *)(u->cq_ring + p.cq_off.head);
+    u->cq_tail  = (unsigned *)(u->cq_ring + p.cq_off.tail);
+    u->cq_mask  = (unsigned *)(u->cq_ring + p.cq_off.ring_mask);
+    u->cqes     = (struct io_uring_cqe *)(u->cq_ring + p.cq_off.cqes);
+
+    u->nb_blocks  = c->uring_depth;
+    u->block_size = c->uring_block_size;
+    u->buf    = av_malloc_array(u->nb_blocks, u->block_size);
+    u->blocks = av_calloc(u->nb_blocks, sizeof(*u->blocks));
+    iovs      = av_calloc(u->nb_blocks, sizeof(*iovs));
+    if (!u->buf || !u->blocks || !iovs) {
+        av_free(iovs);
+        return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < u->nb_blocks; i++) {
+        iovs[i].iov_base = u->buf + (size_t)i * u->block_size;
+        iovs[i].iov_len  = u->block_size;
+        u->blocks[i].iov = iovs[i];
+    }
+    /* Registering pins the buffers and counts against RLIMIT_MEMLOCK;
+     * plain vectored reads are used if that is not possible. */
+    ret = syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_BUFFERS,
+                  iovs, u->nb_blocks);
+    u->fixed = ret >= 0;
+    av_free(iovs);
+
+    av_log(h, AV_LOG_DEBUG, "Using io_uring with %d blocks of %d bytes%s\n",
+           u->nb_blocks, u->block_size, u->fixed ? " (registered)" : "");
+    return 0;
+}
+
+static int uring_read(URLContext *h, unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+    FileUring *u = c->uring;
+    FileUringBlock *b;
+    int ret, offset, avail;
+
+    while (u->nb_queued < u->nb_blocks)
+        uring_queue_block(u, c->fd);
+    if ((ret = uring_submit(u)) < 0)
+        return ret;
+
+    b = &u->blocks[u->first];
+    if ((ret = uring_wait(u, b)) < 0)
+        return ret;
+    if (b->result < 0) {
+        ret = b->result;
+        uring_reset(u, u->pos);
+        return ret;
+    }
+
+    offset = u->pos - b->offset;
+    avail  = b->result - offset;
+    if (avail <= 0) {
+        /* Short read: the end of file is at or before pos. Restart from
+         * pos so that a later read sees data appended in the meantime. */
+        uring_reset(u, u->pos);
+        return AVERROR_EOF;
+    }
+
+    size = FFMIN3(size, avail, c->blocksize);
+    memcpy(buf, (uint8_t *)b->iov.iov_base + offset, size);
+    u->pos += size;
+    if (u->pos == b->offset + u->block_size) {
+        u->first = (u->first + 1) % u->nb_blocks;
+        u->nb_queued--;
+    } else if (size == avail) {
+        uring_reset(u, u->pos);
+    }
+    return size;
+}
+
+static int64_t uring_seek(FileUring *u, int64_t pos)
+{
+    int ret;
+
+    /* Stay in the window if pos is in one of the queued blocks; the
+     * blocks before it have to complete before they can be reused. */
+    while (u->nb_queued) {
+        FileUringBlock *b = &u->blocks[u->first];
+        if (pos < b->offset)
+            break;
+        if (pos < b->offset + u->block_size) {
+            u->pos = pos;
+            return pos;
+        }
+        if ((ret = uring_wait(u, b)) < 0)
+            return ret;
+        u->first = (u->first + 1) % u->nb_blocks;
+        u->nb_queued--;
+    }
+    ret = uring_reset(u, pos);
+    return ret < 0 ? ret : pos;
+}
+
+#endif /* HAVE_LINUX_IO_URING_H */
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
+#if HAVE_MMAP
+    if (c->map) {
+        ret = map_check(h, FFMIN(size, c->blocksize));
+        if (ret < 0)
+            return ret;
+        if (ret)
+            return map_read(h, buf, size);
+    }
+#endif
+#if HAVE_LINUX_IO_URING_H
+    if (c->uring)
+        return uring_read(h, buf, size);
+#endif
     size = FFMIN(size, c->blocksize);
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
@@ -128,6 +594,23 @@ static int file_write(URLContext *h, const unsigned char *buf, int size)
     return (ret == -1) ? AVERROR(errno) : ret;
 }
 
+#if HAVE_SYS_UIO_H
+static int file_writev(URLContext *h, const URLIOVec *vec, int nb_vec)
+{
+    FileContext *c = h->priv_data;
+    struct iovec iov[URL_MAX_IOVEC];
+    int i, size = 0;
+    ssize_t ret;
+    for (i = 0; i < nb_vec && size < c->blocksize; i++) {
+        iov[i].iov_base = (void *)vec[i].base;
+        iov[i].iov_len  = FFMIN(vec[i].len, c->blocksize - size);
+        size += iov[i].iov_len;
+    }
+    ret = writev(c->fd, iov, i);
+    return (ret == -1) ? AVERROR(errno) : ret;
+}
+#endif
+
 static int file_get_handle(URLContext *h)
 {
     FileContext *c = h->priv_data;
@@ -243,6 +726,32 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+#if HAVE_MMAP
+    if (c->use_mmap && !(flags & AVIO_FLAG_WRITE) && !c->follow &&
+        !fstat(fd, &st) && S_ISREG(st.st_mode)) {
+        int ret = map_open(h, st.st_size);
+        if (ret < 0)
+            av_log(h, AV_LOG_VERBOSE, "Cannot map the file (%s), "
+                   "falling back to read()\n", av_err2str(ret));
+        else
+            av_log(h, AV_LOG_DEBUG, "Reading through a memory mapping of "
+                   "%"PRId64" bytes\n", c->map_size);
+    }
+#endif
+
+    if (c->use_io_uring && !c->map && !(flags & AVIO_FLAG_WRITE) &&
+        !c->follow && !fstat(fd, &st) && S_ISREG(st.st_mode)) {
+        int ret = AVERROR(ENOSYS);
+#if HAVE_LINUX_IO_URING_H
+        ret = uring_init(h);
+        if (ret < 0)
+            uring_free(&c->uring);
+#endif
+        if (ret < 0)
+            av_log(h, AV_LOG_VERBOSE, "io_uring not available (%s), "
+                   "falling back to read()\n", av_err2str(ret));
+    }
+
     return 0;
 }
 
@@ -258,6 +767,22 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
         return ret < 0 ? AVERROR(errno) : (S_ISFIFO(st.st_mode) ? 0 : st.st_size);
     }
 
+#if HAVE_MMAP
+    if (c->map)
+        return map_seek(c, pos, whence);
+#endif
+#if HAVE_LINUX_IO_URING_H
+    /* reads are positioned, the file offset is only used for validation */
+    if (c->uring) {
+        if (whence == SEEK_CUR) {
+            pos   += c->uring->pos;
+            whence = SEEK_SET;
+        }
+        ret = lseek(c->fd, pos, whence);
+        return ret < 0 ? AVERROR(errno) : uring_seek(c->uring, ret);
+    }
+#endif
+
     ret = lseek(c->fd, pos, whence);
 
     return ret < 0 ? AVERROR(errno) : ret;
@@ -266,6 +791,13 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
+#if HAVE_MMAP
+    if (c->map)
+        munmap(c->map, c->map_size);
+#endif
+#if HAVE_LINUX_IO_URING_H
+    uring_free(&c->uring);
+#endif
     return close(c->fd);
 }
 
@@ -358,6 +890,9 @@ const URLProtocol ff_file_protocol = {
     .url_open            = file_open,
     .url_read            = file_read,
     .url_write           = file_write,
+#if HAVE_SYS_UIO_H
+    .url_writev          = file_writev,
+#endif
     .url_seek            = file_seek,
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
@@ -404,6 +939,9 @@ const URLProtocol ff_pipe_protocol = {
     .url_open            = pipe_open,
     .url_read            = file_read,
     .url_write           = file_write,
+#if HAVE_SYS_UIO_H
+    .url_writev          = file_writev,
+#endif
     .url_get_file_handle = file_get_handle,
     .url_check           = file_check,
     .priv_data_size      = sizeof(FileContext),
@@ -38,6 +38,7 @@
 #include "internal.h"
 #include "avio_internal.h"
 #include "id3v2.h"
+#include "prefetch.h"
 
 #define INITIAL_BUFFER_SIZE 32768
 
@@ -47,6 +48,8 @@
 #define MPEG_TIME_BASE 90000
 #define MPEG_TIME_BASE_Q (AVRational){1, MPEG_TIME_BASE}
 
+#define MAX_PREFETCH 16
+
 /*
  * An apple http stream consists of a playlist with media segment files,
  * played sequentially. There may be several playlists with the same
@@ -85,6 +88,14 @@ enum PlaylistType {
     PLS_TYPE_VOD
 };
 
+/* A segment being downloaded ahead of the one being read. */
+struct prefetch {
+    int64_t seq_no;
+    int64_t url_offset;
+    char *url;
+    PrefetchDownload *download;
+};
+
 /*
  * Each playlist has its own demuxer. If it currently is active,
  * it has an open AVIOContext too, and potentially an AVPacket
@@ -98,6 +109,12 @@ struct playlist {
     int input_read_done;
     AVIOContext *input_next;
     int input_next_requested;
+    struct prefetch prefetch[MAX_PREFETCH];
+    int n_prefetch;
+    PrefetchDownload *cur_download; /* the current segment is read from this if set */
+    PrefetchDownload *reload;       /* next version of the playlist */
+    int64_t prefetch_hits;
+    int64_t prefetch_misses;
     AVFormatContext *parent;
     int index;
     AVFormatContext *ctx;
@@ -212,6 +229,10 @@ typedef struct HLSContext {
     int http_persistent;
     int http_multiple;
     int http_seekable;
+    int prefetch;
+    int prefetch_buffer_size;
+    int64_t prefetch_hits;
+    int64_t prefetch_misses;
     AVIOContext *playlist_pb;
 } HLSContext;
 
@@ -243,6 +264,8 @@ static void free_init_section_list(struct playlist *pls)
     pls->n_init_sections = 0;
 }
 
+static void prefetch_close(struct playlist *pls);
+
 static void free_playlist_list(HLSContext *c)
 {
     int i;
@@ -262,6 +285,11 @@ static void free_playlist_list(HLSContext *c)
         pls->input_read_done = 0;
         ff_format_io_close(c->ctx, &pls->input_next);
         pls->input_next_requested = 0;
+        prefetch_close(pls);
+        if (pls->prefetch_hits || pls->prefetch_misses)
+            av_log(c->ctx, AV_LOG_VERBOSE,
+                   "Playlist %d: %"PRId64" prefetched segments used, %"PRId64" missed\n",
+                   pls->index, pls->prefetch_hits, pls->prefetch_misses);
         if (pls->ctx) {
             pls->ctx->pb = NULL;
             avformat_close_input(&pls->ctx);
@@ -621,13 +649,10 @@ static int open_url_keepalive(AVFormatContext *s, AVIOContext **pb,
 #endif
 }
 
-static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
-                    AVDictionary **opts, AVDictionary *opts2, int *is_http_out)
+static int check_url(AVFormatContext *s, const char *url, int *is_http_out)
 {
     HLSContext *c = s->priv_data;
-    AVDictionary *tmp = NULL;
     const char *proto_name = NULL;
-    int ret;
     int is_http = 0;
 
     if (av_strstart(url, "crypto", NULL)) {
@@ -669,6 +694,22 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     else if (strcmp(proto_name, "file") || !strncmp(url, "file,", 5))
         return AVERROR_INVALIDDATA;
 
+    *is_http_out = is_http;
+    return 0;
+}
+
+static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
+                    AVDictionary **opts, AVDictionary *opts2, int *is_http_out)
+{
+    HLSContext *c = s->priv_data;
+    AVDictionary *tmp = NULL;
+    int ret;
+    int is_http = 0;
+
+    ret = check_url(s, url, &is_http);
+    if (ret < 0)
+        return ret;
+
     av_dict_copy(&tmp, *opts, 0);
     av_dict_copy(&tmp, opts2, 0);
 
@@ -1012,6 +1053,177 @@ static struct segment *next_segment(struct playlist *pls)
     return pls->segments[n];
 }
 
+static int64_t default_reload_interval(struct playlist *pls)
+{
+    return pls->n_segments > 0 ?
+                          pls->segments[pls->n_segments - 1]->duration :
+                          pls->target_duration;
+}
+
+static void prefetch_free(struct prefetch *p)
+{
+    ff_prefetch_free(&p->download);
+    av_freep(&p->url);
+}
+
+static int prefetch_start(HLSContext *c, struct prefetch *p, struct segment *seg)
+{
+    AVDictionary *opts = NULL;
+    int is_http = 0;
+    int ret;
+
+    if ((ret = check_url(c->ctx, seg->url, &is_http)) < 0)
+        return ret;
+    if (!(p->url = av_strdup(seg->url)))
+        return AVERROR(ENOMEM);
+    p->url_offset = seg->url_offset;
+
+    av_dict_copy(&opts, c->avio_opts, 0);
+    if (seg->size >= 0) {
+        av_dict_set_int(&opts, "offset", seg->url_offset, 0);
+        av_dict_set_int(&opts, "end_offset", seg->url_offset + seg->size, 0);
+    }
+    /* as in open_input(), only seek if the offset was not requested */
+    ret = ff_prefetch_start(&p->download, c->ctx, seg->url, opts,
+                            is_http ? 0 : seg->url_offset, seg->size,
+                            c->prefetch_buffer_size, 0);
+    av_dict_free(&opts);
+    if (ret < 0)
+        av_freep(&p->url);
+    return ret;
+}
+
+/* Keep downloads running for the segments following the current one. */
+static void prefetch_segments(HLSContext *c, struct playlist *pls)
+{
+    int64_t seq_no, last = FFMIN(pls->cur_seq_no + c->prefetch,
+                                 pls->start_seq_no + pls->n_segments - 1);
+    int i, n = 0;
+
+    /* drop what is no longer ahead of us or changed in a playlist reload */
+    for (i = 0; i < pls->n_prefetch; i++) {
+        struct prefetch *p = &pls->prefetch[i];
+        struct segment *seg = p->seq_no > pls->cur_seq_no && p->seq_no <= last ?
+                              pls->segments[p->seq_no - pls->start_seq_no] : NULL;
+        if (seg && !strcmp(seg->url, p->url) && seg->url_offset == p->url_offset)
+            pls->prefetch[n++] = *p;
+        else
+            prefetch_free(p);
+    }
+    pls->n_prefetch = n;
+
+    for (seq_no = pls->cur_seq_no + 1; seq_no <= last; seq_no++) {
+        struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+        struct prefetch *p = &pls->prefetch[pls->n_prefetch];
+
+        /* keys are handled by open_input() */
+        if (seg->key_type != KEY_NONE)
+            break;
+        for (i = 0; i < pls->n_prefetch; i++)
+            if (pls->prefetch[i].seq_no == seq_no)
+                break;
+        if (i < pls->n_prefetch)
+            continue;
+
+        av_log(pls->parent, AV_LOG_VERBOSE, "HLS prefetch for url '%s', offset %"PRId64", playlist %d\n",
+               seg->url, seg->url_offset, pls->index);
+        if (prefetch_start(c, p, seg) < 0)
+            break;
+        p->seq_no = seq_no;
+        pls->n_prefetch++;
+    }
+}
+
+/* Read the current segment from its download, if there is one. */
+static int prefetch_take(HLSContext *c, struct playlist *pls, struct segment *seg)
+{
+    int i;
+
+    if (!c->prefetch)
+        return 0;
+    for (i = 0; i < pls->n_prefetch; i++) {
+        struct prefetch *p = &pls->prefetch[i];
+        if (p->seq_no == pls->cur_seq_no && !strcmp(p->url, seg->url) &&
+            p->url_offset == seg->url_offset) {
+            pls->cur_download = p->download;
+            p->download = NULL;
+            prefetch_free(p);
+            memmove(p, p + 1, (pls->n_prefetch - i - 1) * sizeof(*p));
+            pls->n_prefetch--;
+            pls->cur_seg_offset = 0;
+            pls->prefetch_hits++;
+            c->prefetch_hits++;
+            return 1;
+        }
+    }
+    pls->prefetch_misses++;
+    c->prefetch_misses++;
+    return 0;
+}
+
+static void prefetch_close(struct playlist *pls)
+{
+    int i;
+
+    for (i = 0; i < pls->n_prefetch; i++)
+        prefetch_free(&pls->prefetch[i]);
+    pls->n_prefetch = 0;
+    ff_prefetch_free(&pls->cur_download);
+    ff_prefetch_free(&pls->reload);
+}
+
+/* Start downloading the next version of a live playlist in the background,
+ * so that it is there by the time the reload interval has elapsed. */
+static void schedule_reload(HLSContext *c, struct playlist *pls)
+{
+    AVDictionary *opts = NULL;
+
+    if (!c->prefetch || pls->finished || pls->reload)
+        return;
+    av_dict_copy(&opts, c->avio_opts, 0);
+    ff_prefetch_start(&pls->reload, c->ctx, pls->url, opts, 0, -1, 0,
+                      pls->last_load_time + default_reload_interval(pls));
+    av_dict_free(&opts);
+}
+
+static int reload_playlist(HLSContext *c, struct playlist *pls)
+{
+    if (pls->reload) {
+        const char *location, *cookies;
+        int64_t load_time;
+        uint8_t *data = NULL;
+        AVIOContext pb;
+        int ret;
+
+        ret = ff_prefetch_wait(pls->reload);
+        load_time = ff_prefetch_load_time(pls->reload);
+        location  = ff_prefetch_location(pls->reload);
+        cookies   = ff_prefetch_cookies(pls->reload);
+        // update cookies on http response with setcookies, as open_url() does
+        if (ret >= 0 && cookies)
+            av_dict_set(&c->avio_opts, "cookies", cookies, 0);
+        if (ret == 0)
+            ret = AVERROR_INVALIDDATA;
+        else if (ret > 0 && !(data = av_malloc(ret)))
+            ret = AVERROR(ENOMEM);
+        if (ret > 0) {
+            ret = ff_prefetch_read(pls->reload, data, ret);
+            ffio_init_context(&pb, data, ret, 0, NULL, NULL, NULL, NULL);
+            ret = parse_playlist(c, location ? location : pls->url, pls, &pb);
+            if (ret >= 0)
+                pls->last_load_time = load_time;
+        }
+        av_free(data);
+        ff_prefetch_free(&pls->reload);
+        if (ret >= 0 || ret == AVERROR_EXIT)
+            return ret;
+        av_log(c->ctx, AV_LOG_VERBOSE,
+               "Background reload of playlist %d failed, reloading it again\n",
+               pls->index);
+    }
+    return parse_playlist(c, pls->url, pls, NULL);
+}
+
 static int read_from_url(struct playlist *pls, struct segment *seg,
                          uint8_t *buf, int buf_size)
 {
@@ -1021,7 +1233,10 @@ static int read_from_url(struct playlist *pls, struct segment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    if (pls->cur_download)
+        ret = ff_prefetch_read(pls->cur_download, buf, buf_size);
+    else
+        ret = avio_read(pls->input, buf, buf_size);
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1370,13 +1585,6 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
     return 0;
 }
 
-static int64_t default_reload_interval(struct playlist *pls)
-{
-    return pls->n_segments > 0 ?
-                          pls->segments[pls->n_segments - 1]->duration :
-                          pls->target_duration;
-}
-
 static int playlist_needed(struct playlist *pls)
 {
     AVFormatContext *s = pls->parent;
@@ -1436,7 +1644,8 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if ((!v->input && !v->cur_download) ||
+        (c->http_persistent && v->input_read_done)) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1459,7 +1668,7 @@ reload:
             return AVERROR_EOF;
         if (!v->finished &&
             av_gettime_relative() - v->last_load_time >= reload_interval) {
-            if ((ret = parse_playlist(c, v->url, v, NULL)) < 0) {
+            if ((ret = reload_playlist(c, v)) < 0) {
                 if (ret != AVERROR_EXIT)
                     av_log(v->parent, AV_LOG_WARNING, "Failed to reload playlist %d\n",
                            v->index);
@@ -1512,6 +1721,9 @@ reload:
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
             ret = 0;
+        } else if (prefetch_take(c, v, seg)) {
+            ff_format_io_close(v->parent, &v->input);
+            ret = 0;
         } else {
             ret = open_input(c, v, seg, &v->input);
         }
@@ -1525,9 +1737,13 @@ reload:
             goto reload;
         }
         just_opened = 1;
+        if (c->prefetch) {
+            prefetch_segments(c, v);
+            schedule_reload(c, v);
+        }
     }
 
-    if (c->http_multiple == -1) {
+    if (c->http_multiple == -1 && v->input) {
         uint8_t *http_version_opt = NULL;
         int r = av_opt_get(v->input, "http_version", AV_OPT_SEARCH_CHILDREN, &http_version_opt);
         if (r >= 0) {
@@ -1537,7 +1753,7 @@ reload:
     }
 
     seg = next_segment(v);
-    if (c->http_multiple == 1 && !v->input_next_requested &&
+    if (c->http_multiple == 1 && !c->prefetch && !v->input_next_requested &&
         seg && seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         ret = open_input(c, v, seg, &v->input_next);
         if (ret < 0) {
@@ -1570,7 +1786,9 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (v->cur_download) {
+        ff_prefetch_free(&v->cur_download);
+    } else if (c->http_persistent &&
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
@@ -1876,6 +2094,13 @@ static int hls_read_header(AVFormatContext *s)
        the range header */
     av_dict_set_int(&c->avio_opts, "seekable", c->http_seekable, 0);
 
+    if (c->prefetch && (!HAVE_THREADS || s->flags & AVFMT_FLAG_CUSTOM_IO ||
+                        !ff_format_io_is_default(s))) {
+        av_log(s, AV_LOG_WARNING, "Segment prefetching is not supported %s, disabling it\n",
+               HAVE_THREADS ? "with custom I/O" : "without threads");
+        c->prefetch = 0;
+    }
+
     if ((ret = parse_playlist(c, s->url, NULL, s->pb)) < 0)
         goto fail;
 
@@ -2094,6 +2319,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             }
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %"PRId64"\n", i, pls->cur_seq_no);
         } else if (first && !cur_needed && pls->needed) {
+            prefetch_close(pls);
             ff_format_io_close(pls->parent, &pls->input);
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
@@ -2334,6 +2560,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
     for (i = 0; i < c->n_playlists; i++) {
         /* Reset reading */
         struct playlist *pls = c->playlists[i];
+        ff_prefetch_free(&pls->cur_download);
         ff_format_io_close(pls->parent, &pls->input);
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
@@ -2399,6 +2626,16 @@ static const AVOption hls_options[] = {
         OFFSET(http_multiple), AV_OPT_TYPE_BOOL, {.i64 = -1}, -1, 1, FLAGS},
     {"http_seekable", "Use HTTP partial requests, 0 = disable, 1 = enable, -1 = auto",
         OFFSET(http_seekable), AV_OPT_TYPE_BOOL, { .i64 = -1}, -1, 1, FLAGS},
+    {"prefetch", "Number of segments to download ahead of the current one",
+        OFFSET(prefetch), AV_OPT_TYPE_INT, {.i64 = 0}, 0, MAX_PREFETCH, FLAGS},
+    {"prefetch_buffer_size", "Maximum amount of data buffered per prefetched segment",
+        OFFSET(prefetch_buffer_size), AV_OPT_TYPE_INT, {.i64 = 4 << 20}, 4096, INT_MAX, FLAGS},
+    {"prefetch_hits", "Number of segments read from a prefetched download",
+        OFFSET(prefetch_hits), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX,
+        FLAGS | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY},
+    {"prefetch_misses", "Number of segments opened because they were not prefetched",
+        OFFSET(prefetch_misses), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX,
+        FLAGS | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY},
     {NULL}
 };
 
@@ -153,6 +153,11 @@ struct AVFormatInternal {
      * Set if chapter ids are strictly monotonic.
      */
     int chapter_ids_monotonic;
+
+    /**
+     * Cached stream parameters and indexes, see AVFormatContext.probe_cache.
+     */
+    struct ProbeCache *probe_cache;
 };
 
 struct AVStreamInternal {
@@ -234,6 +239,11 @@ struct AVStreamInternal {
         int64_t fps_last_dts;
         int     fps_last_dts_idx;
 
+        /**
+         * Packets waiting to be decoded with AVFMT_FLAG_FAST_PROBE.
+         */
+        struct PacketList *probe_pkts;
+        struct PacketList *probe_pkts_end;
     } *info;
 
     int64_t interleaver_chunk_size;
@@ -349,6 +359,15 @@ struct AVStreamInternal {
      * last packet in packet_buffer for this stream when muxing.
      */
     struct PacketList *last_in_packet_buffer;
+
+    /**
+     * Compact form of the index, set instead of AVStream.index_entries
+     * by ff_index_pack(). AVStream.nb_index_entries is 0 meanwhile, so that
+     * API users never index a NULL array; the entry count is kept in
+     * nb_packed_entries.
+     */
+    struct FFPackedIndex *packed_index;
+    int nb_packed_entries;
 };
 
 #ifdef __GNUC__
@@ -544,6 +563,35 @@ int ff_add_index_entry(AVIndexEntry **index_entries,
 
 void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance);
 
+/**
+ * Replace the index of st by a compact read-only form, for demuxers that
+ * keep large indexes. The index must not be accessed through
+ * AVStream.index_entries and AVStream.nb_index_entries afterwards, but
+ * through ff_index_nb_entries(), ff_index_get_entry() and
+ * av_index_search_timestamp(); functions modifying the index restore the
+ * AVIndexEntry array first.
+ */
+int ff_index_pack(AVStream *st);
+
+/**
+ * Restore AVStream.index_entries if the index of st was packed.
+ */
+int ff_index_unpack(AVStream *st);
+
+/**
+ * @return the number of entries of the index of st, packed or not
+ */
+int ff_index_nb_entries(const AVStream *st);
+
+/**
+ * Get an entry of the index of st, packed or not.
+ *
+ * @param tmp storage for the entry if the index is packed
+ * @return a pointer to the entry, which is only part of the index itself
+ *         if the index is not packed
+ */
+AVIndexEntry *ff_index_get_entry(AVStream *st, int idx, AVIndexEntry *tmp);
+
 /**
  * Add a new chapter.
  *
@@ -808,6 +856,13 @@ int ff_format_output_open(AVFormatContext *s, const char *url, AVDictionary **op
  */
 void ff_format_io_close(AVFormatContext *s, AVIOContext **pb);
 
+/**
+ * @return 1 if s opens and closes nested URLs with the default callbacks,
+ *         i.e. the caller did not replace AVFormatContext.io_open or
+ *         AVFormatContext.io_close, 0 otherwise
+ */
+int ff_format_io_is_default(const AVFormatContext *s);
+
 /**
  * Utility function to check if the file uses http or https protocol
  *
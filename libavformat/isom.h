@@ -155,6 +155,31 @@ typedef struct MOVIndexRange {
     int64_t end;
 } MOVIndexRange;
 
+/**
+ * Position in the sample tables of the next sample to add to the index,
+ * kept between calls when the index is built as the stream is read.
+ */
+typedef struct MOVIndexBuilder {
+    int pending;                ///< the index does not have all samples yet
+    unsigned int chunk;
+    unsigned int chunk_sample;  ///< next sample within the chunk
+    unsigned int current_sample;
+    unsigned int stts_index;
+    unsigned int stts_sample;
+    unsigned int stsc_index;
+    unsigned int stss_index;
+    unsigned int stps_index;
+    unsigned int rap_group_index;
+    unsigned int rap_group_sample;
+    unsigned int distance;
+    int key_off;
+    int64_t offset;
+    int64_t dts;
+    int64_t last_dts;
+    int64_t dts_correction;
+    uint64_t stream_size;
+} MOVIndexBuilder;
+
 typedef struct MOVStreamContext {
     AVIOContext *pb;
     int pb_is_copied;
@@ -191,6 +216,8 @@ typedef struct MOVStreamContext {
     int64_t min_corrected_pts;  ///< minimum Composition time shown by the edits excluding empty edits.
     int current_sample;
     int64_t current_index;
+    AVIndexEntry packed_sample; ///< current sample, if the index is packed
+    MOVIndexBuilder index_builder;
     MOVIndexRange* index_ranges;
     MOVIndexRange* current_index_range;
     unsigned int bytes_per_frame;
@@ -294,6 +321,8 @@ typedef struct MOVContext {
     uint8_t *decryption_key;
     int decryption_key_len;
     int enable_drefs;
+    int compact_index;
+    int lazy_index;
     int32_t movie_display_matrix[3][3]; ///< display matrix from mvhd
     int have_read_mfra_size;
     uint32_t mfra_size;
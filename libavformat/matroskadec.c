@@ -56,6 +56,7 @@
 #include "isom.h"
 #include "matroska.h"
 #include "oggdec.h"
+#include "probecache.h"
 /* For ff_codec_get_id(). */
 #include "riff.h"
 #include "rmsipr.h"
@@ -3848,7 +3849,11 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
     /* Parse the CUES now since we need the index data to seek. */
     if (matroska->cues_parsing_deferred > 0) {
         matroska->cues_parsing_deferred = 0;
-        matroska_parse_cues(matroska);
+        if (ff_probe_cache_get_index(s) <= 0) {
+            matroska_parse_cues(matroska);
+            if (!matroska->cues_parsing_deferred)
+                ff_probe_cache_set_index(s);
+        }
     }
 
     if (!st->nb_index_entries)
@@ -53,6 +53,7 @@
 #include "libavcodec/mlp_parse.h"
 #include "avformat.h"
 #include "internal.h"
+#include "packedindex.h"
 #include "avio_internal.h"
 #include "riff.h"
 #include "isom.h"
@@ -3795,17 +3796,209 @@ static void mov_fix_index(MOVContext *mov, AVStream *st)
     msc->current_index = msc->index_ranges[0].start;
 }
 
+/**
+ * Add the next nb_samples samples described by the sample tables to the
+ * index, starting where the previous call stopped.
+ *
+ * @return 0 on success, a negative AVERROR if the tables are inconsistent
+ */
+static int mov_build_index_samples(MOVContext *mov, AVStream *st, int nb_samples)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVIndexBuilder *b = &sc->index_builder;
+    int rap_group_present = sc->rap_group_count && sc->rap_group;
+
+    while (b->chunk < sc->chunk_count) {
+        unsigned int i = b->chunk;
+
+        if (!b->chunk_sample) {
+            int64_t next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
+            b->offset = sc->chunk_offsets[i];
+            while (mov_stsc_index_valid(b->stsc_index, sc->stsc_count) &&
+                i + 1 == sc->stsc_data[b->stsc_index + 1].first)
+                b->stsc_index++;
+
+            if (next_offset > b->offset && sc->sample_size>0 && sc->sample_size < sc->stsz_sample_size &&
+                sc->stsc_data[b->stsc_index].count * (int64_t)sc->stsz_sample_size > next_offset - b->offset) {
+                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too large), ignoring\n", sc->stsz_sample_size);
+                sc->stsz_sample_size = sc->sample_size;
+            }
+            if (sc->stsz_sample_size>0 && sc->stsz_sample_size < sc->sample_size) {
+                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too small), ignoring\n", sc->stsz_sample_size);
+                sc->stsz_sample_size = sc->sample_size;
+            }
+        }
+
+        for (; b->chunk_sample < sc->stsc_data[b->stsc_index].count; b->chunk_sample++) {
+            unsigned int j = b->chunk_sample;
+            unsigned int sample_size;
+            int keyframe = 0;
+
+            /* check the end of the tables first, so that the index is
+             * never left pending once all samples have been added */
+            if (b->current_sample >= sc->sample_count) {
+                av_log(mov->fc, AV_LOG_ERROR, "wrong sample count\n");
+                b->pending = 0;
+                return AVERROR_INVALIDDATA;
+            }
+            if (nb_samples-- <= 0)
+                return 0;
+
+            if (!sc->keyframe_absent && (!sc->keyframe_count || b->current_sample+b->key_off == sc->keyframes[b->stss_index])) {
+                keyframe = 1;
+                if (b->stss_index + 1 < sc->keyframe_count)
+                    b->stss_index++;
+            } else if (sc->stps_count && b->current_sample+b->key_off == sc->stps_data[b->stps_index]) {
+                keyframe = 1;
+                if (b->stps_index + 1 < sc->stps_count)
+                    b->stps_index++;
+            }
+            if (rap_group_present && b->rap_group_index < sc->rap_group_count) {
+                if (sc->rap_group[b->rap_group_index].index > 0)
+                    keyframe = 1;
+                if (++b->rap_group_sample == sc->rap_group[b->rap_group_index].count) {
+                    b->rap_group_sample = 0;
+                    b->rap_group_index++;
+                }
+            }
+            if (sc->keyframe_absent
+                && !sc->stps_count
+                && !rap_group_present
+                && (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO || (i==0 && j==0)))
+                 keyframe = 1;
+            if (keyframe)
+                b->distance = 0;
+            sample_size = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[b->current_sample];
+            if (sc->pseudo_stream_id == -1 ||
+               sc->stsc_data[b->stsc_index].id - 1 == sc->pseudo_stream_id) {
+                AVIndexEntry *e;
+                if (sample_size > 0x3FFFFFFF) {
+                    av_log(mov->fc, AV_LOG_ERROR, "Sample size %u is too large\n", sample_size);
+                    b->pending = 0;
+                    return AVERROR_INVALIDDATA;
+                }
+                e = &st->index_entries[st->nb_index_entries++];
+                e->pos = b->offset;
+                e->timestamp = b->dts;
+                e->size = sample_size;
+                e->min_distance = b->distance;
+                e->flags = keyframe ? AVINDEX_KEYFRAME : 0;
+                av_log(mov->fc, AV_LOG_TRACE, "AVIndex stream %d, sample %u, offset %"PRIx64", dts %"PRId64", "
+                        "size %u, distance %u, keyframe %d\n", st->index, b->current_sample,
+                        b->offset, b->dts, sample_size, b->distance, keyframe);
+                if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && st->nb_index_entries < 100 &&
+                    st->internal->info)
+                    ff_rfps_add_frame(mov->fc, st, b->dts);
+            }
+
+            b->offset += sample_size;
+            b->stream_size += sample_size;
+
+            /* A negative sample duration is invalid based on the spec,
+             * but some samples need it to correct the DTS. */
+            if (sc->stts_data[b->stts_index].duration < 0) {
+                av_log(mov->fc, AV_LOG_WARNING,
+                       "Invalid SampleDelta %d in STTS, at %d st:%d\n",
+                       sc->stts_data[b->stts_index].duration, b->stts_index,
+                       st->index);
+                b->dts_correction += sc->stts_data[b->stts_index].duration - 1;
+                sc->stts_data[b->stts_index].duration = 1;
+            }
+            b->dts += sc->stts_data[b->stts_index].duration;
+            if (!b->dts_correction || b->dts + b->dts_correction > b->last_dts) {
+                b->dts += b->dts_correction;
+                b->dts_correction = 0;
+            } else {
+                /* Avoid creating non-monotonous DTS */
+                b->dts_correction += b->dts - b->last_dts - 1;
+                b->dts = b->last_dts + 1;
+            }
+            b->last_dts = b->dts;
+            b->distance++;
+            b->stts_sample++;
+            b->current_sample++;
+            if (b->stts_index + 1 < sc->stts_count && b->stts_sample == sc->stts_data[b->stts_index].count) {
+                b->stts_sample = 0;
+                b->stts_index++;
+            }
+        }
+        b->chunk++;
+        b->chunk_sample = 0;
+    }
+    b->pending = 0;
+    return 0;
+}
+
+/**
+ * Add up to nb_samples more samples to an index that is still being built.
+ *
+ * @param nb_samples at least 1, so that each call makes progress
+ */
+static int mov_extend_index(MOVContext *mov, AVStream *st, unsigned int nb_samples)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVIndexBuilder *b = &sc->index_builder;
+
+    av_assert1(nb_samples > 0);
+    if (!b->pending)
+        return 0;
+    nb_samples = FFMIN(nb_samples, sc->sample_count - b->current_sample);
+    if (av_reallocp_array(&st->index_entries,
+                          st->nb_index_entries + nb_samples,
+                          sizeof(*st->index_entries)) < 0) {
+        st->nb_index_entries = 0;
+        b->pending = 0;
+        return AVERROR(ENOMEM);
+    }
+    st->index_entries_allocated_size = (st->nb_index_entries + nb_samples) * sizeof(*st->index_entries);
+
+    return mov_build_index_samples(mov, st, nb_samples);
+}
+
+/**
+ * Whether mov_fix_index() would leave the index unchanged, so that it can
+ * be built as the stream is read rather than all at once.
+ */
+static int mov_index_is_complete_without_edits(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int64_t duration = 0;
+    unsigned int i;
+
+    if (!sc->elst_count || mov->ignore_editlist || !mov->advanced_editlist)
+        return 1;
+
+    /* a single edit covering the whole media from its start */
+    if (sc->elst_count > 1 || sc->elst_data[0].time || sc->elst_data[0].rate != 1.0f ||
+        sc->ctts_data || mov->time_scale <= 0)
+        return 0;
+    for (i = 0; i < sc->stts_count; i++) {
+        if (sc->stts_data[i].duration < 0)
+            return 0;
+        duration += (int64_t)sc->stts_data[i].count * sc->stts_data[i].duration;
+    }
+    return av_rescale(sc->elst_data[0].duration, sc->time_scale, mov->time_scale) >= duration;
+}
+
+static uint64_t mov_get_stream_size(MOVStreamContext *sc)
+{
+    uint64_t size = 0;
+    unsigned int i;
+
+    if (sc->stsz_sample_size > 0)
+        return (uint64_t)sc->stsz_sample_size * sc->sample_count;
+    for (i = 0; i < sc->sample_count; i++)
+        size += sc->sample_sizes[i];
+    return size;
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
     int64_t current_offset;
     int64_t current_dts = 0;
-    unsigned int stts_index = 0;
     unsigned int stsc_index = 0;
-    unsigned int stss_index = 0;
-    unsigned int stps_index = 0;
     unsigned int i, j;
-    uint64_t stream_size = 0;
     MOVStts *ctts_data_old = sc->ctts_data;
     unsigned int ctts_count_old = sc->ctts_count;
 
@@ -3855,31 +4048,15 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
     /* only use old uncompressed audio chunk demuxing when stts specifies it */
     if (!(st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
           sc->stts_count == 1 && sc->stts_data[0].duration == 1)) {
-        unsigned int current_sample = 0;
-        unsigned int stts_sample = 0;
-        unsigned int sample_size;
-        unsigned int distance = 0;
-        unsigned int rap_group_index = 0;
-        unsigned int rap_group_sample = 0;
-        int64_t last_dts = 0;
-        int64_t dts_correction = 0;
-        int rap_group_present = sc->rap_group_count && sc->rap_group;
-        int key_off = (sc->keyframe_count && sc->keyframes[0] > 0) || (sc->stps_count && sc->stps_data[0] > 0);
+        MOVIndexBuilder *b = &sc->index_builder;
+        int lazy;
 
         current_dts -= sc->dts_shift;
-        last_dts     = current_dts;
 
         if (!sc->sample_count || st->nb_index_entries)
             return;
         if (sc->sample_count >= UINT_MAX / sizeof(*st->index_entries) - st->nb_index_entries)
             return;
-        if (av_reallocp_array(&st->index_entries,
-                              st->nb_index_entries + sc->sample_count,
-                              sizeof(*st->index_entries)) < 0) {
-            st->nb_index_entries = 0;
-            return;
-        }
-        st->index_entries_allocated_size = (st->nb_index_entries + sc->sample_count) * sizeof(*st->index_entries);
 
         if (ctts_data_old) {
             // Expand ctts entries such that we have a 1-1 mapping with samples
@@ -3906,109 +4083,19 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
             av_free(ctts_data_old);
         }
 
-        for (i = 0; i < sc->chunk_count; i++) {
-            int64_t next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
-            current_offset = sc->chunk_offsets[i];
-            while (mov_stsc_index_valid(stsc_index, sc->stsc_count) &&
-                i + 1 == sc->stsc_data[stsc_index + 1].first)
-                stsc_index++;
-
-            if (next_offset > current_offset && sc->sample_size>0 && sc->sample_size < sc->stsz_sample_size &&
-                sc->stsc_data[stsc_index].count * (int64_t)sc->stsz_sample_size > next_offset - current_offset) {
-                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too large), ignoring\n", sc->stsz_sample_size);
-                sc->stsz_sample_size = sc->sample_size;
-            }
-            if (sc->stsz_sample_size>0 && sc->stsz_sample_size < sc->sample_size) {
-                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too small), ignoring\n", sc->stsz_sample_size);
-                sc->stsz_sample_size = sc->sample_size;
-            }
-
-            for (j = 0; j < sc->stsc_data[stsc_index].count; j++) {
-                int keyframe = 0;
-                if (current_sample >= sc->sample_count) {
-                    av_log(mov->fc, AV_LOG_ERROR, "wrong sample count\n");
-                    return;
-                }
-
-                if (!sc->keyframe_absent && (!sc->keyframe_count || current_sample+key_off == sc->keyframes[stss_index])) {
-                    keyframe = 1;
-                    if (stss_index + 1 < sc->keyframe_count)
-                        stss_index++;
-                } else if (sc->stps_count && current_sample+key_off == sc->stps_data[stps_index]) {
-                    keyframe = 1;
-                    if (stps_index + 1 < sc->stps_count)
-                        stps_index++;
-                }
-                if (rap_group_present && rap_group_index < sc->rap_group_count) {
-                    if (sc->rap_group[rap_group_index].index > 0)
-                        keyframe = 1;
-                    if (++rap_group_sample == sc->rap_group[rap_group_index].count) {
-                        rap_group_sample = 0;
-                        rap_group_index++;
-                    }
-                }
-                if (sc->keyframe_absent
-                    && !sc->stps_count
-                    && !rap_group_present
-                    && (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO || (i==0 && j==0)))
-                     keyframe = 1;
-                if (keyframe)
-                    distance = 0;
-                sample_size = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[current_sample];
-                if (sc->pseudo_stream_id == -1 ||
-                   sc->stsc_data[stsc_index].id - 1 == sc->pseudo_stream_id) {
-                    AVIndexEntry *e;
-                    if (sample_size > 0x3FFFFFFF) {
-                        av_log(mov->fc, AV_LOG_ERROR, "Sample size %u is too large\n", sample_size);
-                        return;
-                    }
-                    e = &st->index_entries[st->nb_index_entries++];
-                    e->pos = current_offset;
-                    e->timestamp = current_dts;
-                    e->size = sample_size;
-                    e->min_distance = distance;
-                    e->flags = keyframe ? AVINDEX_KEYFRAME : 0;
-                    av_log(mov->fc, AV_LOG_TRACE, "AVIndex stream %d, sample %u, offset %"PRIx64", dts %"PRId64", "
-                            "size %u, distance %u, keyframe %d\n", st->index, current_sample,
-                            current_offset, current_dts, sample_size, distance, keyframe);
-                    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && st->nb_index_entries < 100)
-                        ff_rfps_add_frame(mov->fc, st, current_dts);
-                }
+        memset(b, 0, sizeof(*b));
+        b->pending  = 1;
+        b->dts      = current_dts;
+        b->last_dts = current_dts;
+        b->key_off  = (sc->keyframe_count && sc->keyframes[0] > 0) || (sc->stps_count && sc->stps_data[0] > 0);
 
-                current_offset += sample_size;
-                stream_size += sample_size;
-
-                /* A negative sample duration is invalid based on the spec,
-                 * but some samples need it to correct the DTS. */
-                if (sc->stts_data[stts_index].duration < 0) {
-                    av_log(mov->fc, AV_LOG_WARNING,
-                           "Invalid SampleDelta %d in STTS, at %d st:%d\n",
-                           sc->stts_data[stts_index].duration, stts_index,
-                           st->index);
-                    dts_correction += sc->stts_data[stts_index].duration - 1;
-                    sc->stts_data[stts_index].duration = 1;
-                }
-                current_dts += sc->stts_data[stts_index].duration;
-                if (!dts_correction || current_dts + dts_correction > last_dts) {
-                    current_dts += dts_correction;
-                    dts_correction = 0;
-                } else {
-                    /* Avoid creating non-monotonous DTS */
-                    dts_correction += current_dts - last_dts - 1;
-                    current_dts = last_dts + 1;
-                }
-                last_dts = current_dts;
-                distance++;
-                stts_sample++;
-                current_sample++;
-                if (stts_index + 1 < sc->stts_count && stts_sample == sc->stts_data[stts_index].count) {
-                    stts_sample = 0;
-                    stts_index++;
-                }
-            }
-        }
+        // the first samples are also needed for the frame rate and delay estimation
+        lazy = mov->lazy_index > 0 && mov_index_is_complete_without_edits(mov, st);
+        if (mov_extend_index(mov, st, lazy ? FFMAX(mov->lazy_index, 100) : UINT_MAX) < 0)
+            return;
         if (st->duration > 0)
-            st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
+            st->codecpar->bit_rate = (b->pending ? mov_get_stream_size(sc) : b->stream_size) *
+                                     8 * sc->time_scale / st->duration;
     } else {
         unsigned chunk_samples, total = 0;
 
@@ -4111,7 +4198,7 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
         }
     }
 
-    if (!mov->ignore_editlist && mov->advanced_editlist) {
+    if (!mov->ignore_editlist && mov->advanced_editlist && !sc->index_builder.pending) {
         // Fix index according to edit lists.
         mov_fix_index(mov, st);
     }
@@ -4355,14 +4442,16 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         && sc->time_scale == st->codecpar->sample_rate) {
             st->need_parsing = AVSTREAM_PARSE_FULL;
     }
-    /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
-    av_freep(&sc->stps_data);
+    /* Do not need those anymore, unless the index is built lazily. */
+    if (!sc->index_builder.pending) {
+        av_freep(&sc->chunk_offsets);
+        av_freep(&sc->sample_sizes);
+        av_freep(&sc->keyframes);
+        av_freep(&sc->stts_data);
+        av_freep(&sc->stps_data);
+        av_freep(&sc->rap_group);
+    }
     av_freep(&sc->elst_data);
-    av_freep(&sc->rap_group);
 
     return 0;
 }
@@ -4785,7 +4874,7 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     int64_t dts, pts = AV_NOPTS_VALUE;
     int data_offset = 0;
     unsigned entries, first_sample_flags = frag->flags;
-    int flags, distance, i;
+    int flags, distance, i, ret;
     int64_t prev_dts = AV_NOPTS_VALUE;
     int next_frag_index = -1, index_entry_pos;
     size_t requested_size;
@@ -4811,6 +4900,9 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     sc = st->priv_data;
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
+    if ((ret = mov_extend_index(c, st, UINT_MAX)) < 0 ||
+        (ret = ff_index_unpack(st)) < 0)
+        return ret;
 
     // Find the next frag_index index that has a valid index_entry for
     // the current track_id.
@@ -7246,6 +7338,7 @@ static void mov_read_chapters(AVFormatContext *s)
 
         sc = st->priv_data;
         cur_pos = avio_tell(sc->pb);
+        mov_extend_index(mov, st, UINT_MAX);
 
         if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
             st->disposition |= AV_DISPOSITION_ATTACHED_PIC | AV_DISPOSITION_TIMED_THUMBNAILS;
@@ -7817,6 +7910,20 @@ static int mov_read_header(AVFormatContext *s)
     }
     ff_configure_buffers_for_index(s, AV_TIME_BASE);
 
+    if (mov->compact_index && !mov->frag_index.nb_items && !mov->next_root_atom) {
+        for (i = 0; i < s->nb_streams; i++) {
+            MOVStreamContext *sc = s->streams[i]->priv_data;
+            if (sc->index_builder.pending)
+                continue;
+            if ((err = ff_index_pack(s->streams[i])) < 0)
+                goto fail;
+            if (s->streams[i]->internal->packed_index)
+                av_log(s, AV_LOG_VERBOSE, "Stream #%d: %d index entries packed into %zu bytes\n",
+                       i, ff_index_nb_entries(s->streams[i]),
+                       ff_packed_index_size(s->streams[i]->internal->packed_index));
+        }
+    }
+
     for (i = 0; i < mov->frag_index.nb_items; i++)
         if (mov->frag_index.item[i].moof_offset <= mov->fragment.moof_offset)
             mov->frag_index.item[i].headers_read = 1;
@@ -7829,14 +7936,18 @@ fail:
 
 static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
 {
+    MOVContext *mov = s->priv_data;
     AVIndexEntry *sample = NULL;
     int64_t best_dts = INT64_MAX;
     int i;
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         MOVStreamContext *msc = avst->priv_data;
-        if (msc->pb && msc->current_sample < avst->nb_index_entries) {
-            AVIndexEntry *current_sample = &avst->index_entries[msc->current_sample];
+        while (msc->index_builder.pending && msc->current_sample + 1 >= avst->nb_index_entries)
+            mov_extend_index(mov, avst, mov->lazy_index);
+        if (msc->pb && msc->current_sample < ff_index_nb_entries(avst)) {
+            AVIndexEntry *current_sample = ff_index_get_entry(avst, msc->current_sample,
+                                                              &msc->packed_sample);
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
             av_log(s, AV_LOG_TRACE, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
             if (!sample || (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL) && current_sample->pos < sample->pos) ||
@@ -8039,8 +8150,9 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             sc->ctts_sample = 0;
         }
     } else {
-        int64_t next_dts = (sc->current_sample < st->nb_index_entries) ?
-            st->index_entries[sc->current_sample].timestamp : st->duration;
+        AVIndexEntry tmp;
+        int64_t next_dts = (sc->current_sample < ff_index_nb_entries(st)) ?
+            ff_index_get_entry(st, sc->current_sample, &tmp)->timestamp : st->duration;
 
         if (next_dts >= pkt->dts)
             pkt->duration = next_dts - pkt->dts;
@@ -8107,7 +8219,9 @@ static int mov_seek_fragment(AVFormatContext *s, AVStream *st, int64_t timestamp
 
 static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp, int flags)
 {
+    MOVContext *mov = s->priv_data;
     MOVStreamContext *sc = st->priv_data;
+    AVIndexEntry tmp;
     int sample, time_sample, ret;
     unsigned int i;
 
@@ -8119,9 +8233,18 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     if (ret < 0)
         return ret;
 
+    while (sc->index_builder.pending &&
+           (!st->nb_index_entries ||
+            st->index_entries[st->nb_index_entries - 1].timestamp <= timestamp))
+        mov_extend_index(mov, st, mov->lazy_index);
     sample = av_index_search_timestamp(st, timestamp, flags);
+    while (sample < 0 && sc->index_builder.pending) {
+        mov_extend_index(mov, st, mov->lazy_index);
+        sample = av_index_search_timestamp(st, timestamp, flags);
+    }
     av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
-    if (sample < 0 && st->nb_index_entries && timestamp < st->index_entries[0].timestamp)
+    if (sample < 0 && ff_index_nb_entries(st) &&
+        timestamp < ff_index_get_entry(st, 0, &tmp)->timestamp)
         sample = 0;
     if (sample < 0) /* not sure what to do */
         return AVERROR_INVALIDDATA;
@@ -8162,8 +8285,9 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
 static int64_t mov_get_skip_samples(AVStream *st, int sample)
 {
     MOVStreamContext *sc = st->priv_data;
-    int64_t first_ts = st->index_entries[0].timestamp;
-    int64_t ts = st->index_entries[sample].timestamp;
+    AVIndexEntry tmp;
+    int64_t first_ts = ff_index_get_entry(st, 0, &tmp)->timestamp;
+    int64_t ts = ff_index_get_entry(st, sample, &tmp)->timestamp;
     int64_t off;
 
     if (st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
@@ -8192,7 +8316,8 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
 
     if (mc->seek_individually) {
         /* adjust seek timestamp to found sample timestamp */
-        int64_t seek_timestamp = st->index_entries[sample].timestamp;
+        AVIndexEntry tmp;
+        int64_t seek_timestamp = ff_index_get_entry(st, sample, &tmp)->timestamp;
         st->internal->skip_samples = mov_get_skip_samples(st, sample);
 
         for (i = 0; i < s->nb_streams; i++) {
@@ -8275,6 +8400,10 @@ static const AVOption mov_options[] = {
     { "decryption_key", "The media decryption key (hex)", OFFSET(decryption_key), AV_OPT_TYPE_BINARY, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "enable_drefs", "Enable external track support.", OFFSET(enable_drefs), AV_OPT_TYPE_BOOL,
         {.i64 = 0}, 0, 1, FLAGS },
+    { "compact_index", "Keep the sample index in a compact form after reading the header.",
+        OFFSET(compact_index), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
+    { "lazy_index", "Add samples to the index this many at a time as the file is read, 0 to index all samples when opening.",
+        OFFSET(lazy_index), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS },
 
     { NULL },
 };
@@ -840,6 +840,8 @@ int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
         av_packet_unref(pkt);
         return AVERROR(ENOMEM);
     }
+    if (!pkt->buf)
+        s->nb_packet_copies++;
     if ((ret = av_packet_make_refcounted(pkt)) < 0) {
         av_free(this_pktl);
         av_packet_unref(pkt);
@@ -196,6 +196,11 @@ static void io_close_default(AVFormatContext *s, AVIOContext *pb)
     avio_close(pb);
 }
 
+int ff_format_io_is_default(const AVFormatContext *s)
+{
+    return s->io_open == io_open_default && s->io_close == io_close_default;
+}
+
 static void avformat_get_context_defaults(AVFormatContext *s)
 {
     memset(s, 0, sizeof(AVFormatContext));
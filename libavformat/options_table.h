@@ -52,6 +52,7 @@ static const AVOption avformat_options[] = {
 {"keepside", "deprecated, does nothing", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_KEEP_SIDE_DATA }, INT_MIN, INT_MAX, D, "fflags"},
 #endif
 {"fastseek", "fast but inaccurate seeks", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_FAST_SEEK }, INT_MIN, INT_MAX, D, "fflags"},
+{"fastprobe", "only decode streams whose parameters parsers and headers do not give", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_FAST_PROBE }, INT_MIN, INT_MAX, D, "fflags"},
 #if FF_API_LAVF_MP4A_LATM
 {"latm", "deprecated, does nothing", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_MP4A_LATM }, INT_MIN, INT_MAX, E, "fflags"},
 #endif
@@ -112,6 +113,9 @@ static const AVOption avformat_options[] = {
 {"max_streams", "maximum number of streams", OFFSET(max_streams), AV_OPT_TYPE_INT, { .i64 = 1000 }, 0, INT_MAX, D },
 {"skip_estimate_duration_from_pts", "skip duration calculation in estimate_timings_from_pts", OFFSET(skip_estimate_duration_from_pts), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, D},
 {"max_probe_packets", "Maximum number of packets to probe a codec", OFFSET(max_probe_packets), AV_OPT_TYPE_INT, { .i64 = 2500 }, 0, INT_MAX, D },
+{"probe_threads", "number of threads decoding streams with fastprobe", OFFSET(probe_threads), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+{"probe_cache", "directory to cache stream parameters and indexes of local files in", OFFSET(probe_cache), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+{"packet_copies", "number of packets copied instead of referenced", OFFSET(nb_packet_copies), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D|E|AV_OPT_FLAG_EXPORT|AV_OPT_FLAG_READONLY },
 {NULL},
 };
 
@@ -0,0 +1,401 @@
+/*
+ * Compact read-only storage for stream indexes
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "libavcodec/get_bits.h"
+#include "libavcodec/put_bits.h"
+#include "packedindex.h"
+
+#define BLOCK_BITS 6
+#define BLOCK_SIZE (1 << BLOCK_BITS)
+/* maximum number of blocks sharing the bases of a super block */
+#define SUPER_BLOCKS 64
+/* bits of a variable length code */
+#define MAX_VLC_BITS 129
+
+enum PackedIndexField {
+    FIELD_FLAGS,
+    FIELD_SIZE,
+    FIELD_TIMESTAMP,
+    FIELD_POS,
+    FIELD_DISTANCE,
+    NB_FIELDS
+};
+
+/* block header, then up to 64 bits per field and entry */
+#define MAX_BLOCK_BYTES ((2 * MAX_VLC_BITS + NB_FIELDS * (MAX_VLC_BITS + 7) + \
+                          BLOCK_SIZE * NB_FIELDS * 64 + 7) >> 3)
+
+/**
+ * The bases of a run of blocks. Their own bases are stored relative to
+ * these, so that they fit in 32 bits.
+ */
+typedef struct PackedIndexSuper {
+    int64_t ts_base;
+    int64_t pos_base;
+    size_t  offset;             ///< byte offset of the data of its first block
+    int     first_block;
+} PackedIndexSuper;
+
+/**
+ * The data of a block starts with the timestamp step and the distance of
+ * the first entry, then the base and width of each field. Each entry then
+ * stores its fields as their differences from the field base, in as many
+ * bits as the field width. The size and flags are stored as such, the
+ * timestamp, position and distance as their differences from those
+ * predicted from the previous entry: the timestamp growing by the step,
+ * the position following the previous packet and the distance growing by
+ * one until the next keyframe.
+ */
+typedef struct PackedIndexBlock {
+    uint32_t offset;            ///< byte offset of the data from that of the super block
+    int32_t  ts;                ///< first timestamp, relative to ts_base of the super block
+    int32_t  pos;               ///< first position, relative to pos_base of the super block
+} PackedIndexBlock;
+
+struct FFPackedIndex {
+    PackedIndexSuper *supers;
+    int nb_supers;
+    PackedIndexBlock *blocks;
+    int nb_blocks;
+    int nb_entries;
+    uint8_t *data;
+    size_t data_size;
+
+    /* entries of the last block read */
+    AVIndexEntry cache[BLOCK_SIZE];
+    int cached_block;
+};
+
+static int bit_length(uint64_t v)
+{
+    int n = 0;
+
+    if (v >> 32) {
+        n   = 32;
+        v >>= 32;
+    }
+    return v ? n + av_log2(v) + 1 : n;
+}
+
+/* the length of v in unary, followed by v without its leading 1 */
+static void put_uv(PutBitContext *pb, uint64_t v)
+{
+    int len = bit_length(v);
+
+    if (len)
+        put_bits64(pb, len, 0);
+    put_bits(pb, 1, 1);
+    if (len > 1)
+        put_bits64(pb, len - 1, v & ((UINT64_C(1) << (len - 1)) - 1));
+}
+
+static uint64_t get_uv(GetBitContext *gb)
+{
+    int len = 0;
+
+    while (len < 64 && !get_bits1(gb))
+        len++;
+    if (len <= 1)
+        return len;
+    return (UINT64_C(1) << (len - 1)) | get_bits64(gb, len - 1);
+}
+
+static void put_sv(PutBitContext *pb, uint64_t v)
+{
+    put_uv(pb, (v << 1) ^ (uint64_t)((int64_t)v >> 63));
+}
+
+static uint64_t get_sv(GetBitContext *gb)
+{
+    uint64_t v = get_uv(gb);
+    return (v >> 1) ^ -(v & 1);
+}
+
+static int write_block(PackedIndexBlock *blk, const PackedIndexSuper *super,
+                       const AVIndexEntry *e, int n, uint8_t *buf)
+{
+    uint64_t res[BLOCK_SIZE][NB_FIELDS];
+    int64_t min[NB_FIELDS], max[NB_FIELDS];
+    int bits[NB_FIELDS];
+    int64_t step = 0;
+    PutBitContext pb;
+    int i, j;
+
+    if (n > 1)
+        step = (int64_t)(e[n - 1].timestamp - (uint64_t)e[0].timestamp) / (n - 1);
+
+    for (j = 0; j < n; j++) {
+        uint64_t ts = e[0].timestamp, pos = e[0].pos, distance = e[0].min_distance;
+
+        if (j) {
+            ts       = e[j - 1].timestamp + (uint64_t)step;
+            pos      = e[j - 1].pos       + (uint64_t)e[j - 1].size;
+            distance = e[j].flags & AVINDEX_KEYFRAME ? 0 : e[j - 1].min_distance + 1;
+        }
+        res[j][FIELD_FLAGS]     = e[j].flags & 3;
+        res[j][FIELD_SIZE]      = e[j].size;
+        res[j][FIELD_TIMESTAMP] = e[j].timestamp    - ts;
+        res[j][FIELD_POS]       = e[j].pos          - pos;
+        res[j][FIELD_DISTANCE]  = e[j].min_distance - distance;
+        for (i = 0; i < NB_FIELDS; i++) {
+            if (!j || (int64_t)res[j][i] < min[i])
+                min[i] = res[j][i];
+            if (!j || (int64_t)res[j][i] > max[i])
+                max[i] = res[j][i];
+        }
+    }
+
+    blk->ts  = e[0].timestamp - (uint64_t)super->ts_base;
+    blk->pos = e[0].pos       - (uint64_t)super->pos_base;
+
+    init_put_bits(&pb, buf, MAX_BLOCK_BYTES);
+    put_sv(&pb, step);
+    put_uv(&pb, e[0].min_distance);
+    for (i = 0; i < NB_FIELDS; i++) {
+        bits[i] = bit_length(max[i] - (uint64_t)min[i]);
+        put_sv(&pb, min[i]);
+        put_bits(&pb, 7, bits[i]);
+    }
+    for (j = 0; j < n; j++)
+        for (i = 0; i < NB_FIELDS; i++)
+            if (bits[i])
+                put_bits64(&pb, bits[i], res[j][i] - min[i]);
+    flush_put_bits(&pb);
+    return put_bits_count(&pb) >> 3;
+}
+
+static int fits_int32(int64_t base, int64_t v)
+{
+    int64_t d = v - (uint64_t)base;
+    return d >= INT32_MIN && d <= INT32_MAX;
+}
+
+static PackedIndexSuper *add_super(FFPackedIndex *pi, unsigned *supers_size,
+                                   const AVIndexEntry *e, int b)
+{
+    PackedIndexSuper *super;
+
+    super = av_fast_realloc(pi->supers, supers_size,
+                            (pi->nb_supers + 1) * sizeof(*pi->supers));
+    if (!super)
+        return NULL;
+    pi->supers  = super;
+    super      += pi->nb_supers++;
+    super->ts_base     = e->timestamp;
+    super->pos_base    = e->pos;
+    super->offset      = pi->data_size;
+    super->first_block = b;
+    return super;
+}
+
+FFPackedIndex *ff_packed_index_alloc(const AVIndexEntry *entries, int nb_entries)
+{
+    FFPackedIndex *pi = av_mallocz(sizeof(*pi));
+    PackedIndexSuper *super = NULL;
+    unsigned supers_size = 0, data_alloc = 0;
+    uint8_t *buf = NULL, *data;
+    int b;
+
+    if (!pi)
+        return NULL;
+    pi->nb_entries   = nb_entries;
+    pi->nb_blocks    = (nb_entries + BLOCK_SIZE - 1) >> BLOCK_BITS;
+    pi->cached_block = -1;
+    pi->blocks       = av_malloc_array(pi->nb_blocks, sizeof(*pi->blocks));
+    buf              = av_malloc(MAX_BLOCK_BYTES);
+    if (!pi->blocks || !buf)
+        goto fail;
+
+    for (b = 0; b < pi->nb_blocks; b++) {
+        const AVIndexEntry *e = &entries[b << BLOCK_BITS];
+        PackedIndexBlock *blk = &pi->blocks[b];
+        int n = FFMIN(BLOCK_SIZE, nb_entries - (b << BLOCK_BITS));
+        int size;
+
+        if (!super || b - super->first_block == SUPER_BLOCKS ||
+            !fits_int32(super->ts_base,  e->timestamp) ||
+            !fits_int32(super->pos_base, e->pos) ||
+            pi->data_size - super->offset > UINT32_MAX - MAX_BLOCK_BYTES) {
+            if (!(super = add_super(pi, &supers_size, e, b)))
+                goto fail;
+        }
+        blk->offset = pi->data_size - super->offset;
+
+        size = write_block(blk, super, e, n, buf);
+        data = av_fast_realloc(pi->data, &data_alloc, pi->data_size + size);
+        if (!data)
+            goto fail;
+        pi->data = data;
+        memcpy(pi->data + pi->data_size, buf, size);
+        pi->data_size += size;
+    }
+
+    /* trim the data to its size, with the padding the bit reader needs */
+    data = av_realloc(pi->data, pi->data_size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!data)
+        goto fail;
+    pi->data = data;
+    memset(pi->data + pi->data_size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    av_free(buf);
+    return pi;
+
+fail:
+    av_free(buf);
+    ff_packed_index_free(&pi);
+    return NULL;
+}
+
+static const PackedIndexSuper *find_super(const FFPackedIndex *pi, int b)
+{
+    int lo = 0, hi = pi->nb_supers - 1;
+
+    while (lo < hi) {
+        int m = (lo + hi + 1) >> 1;
+        if (pi->supers[m].first_block <= b)
+            lo = m;
+        else
+            hi = m - 1;
+    }
+    return &pi->supers[lo];
+}
+
+static void read_block(FFPackedIndex *pi, int b)
+{
+    const PackedIndexBlock *blk   = &pi->blocks[b];
+    const PackedIndexSuper *super = find_super(pi, b);
+    size_t offset = super->offset + blk->offset;
+    int n = FFMIN(BLOCK_SIZE, pi->nb_entries - (b << BLOCK_BITS));
+    uint64_t ts  = super->ts_base  + (uint64_t)blk->ts;
+    uint64_t pos = super->pos_base + (uint64_t)blk->pos;
+    uint64_t base[NB_FIELDS], step, distance;
+    int bits[NB_FIELDS];
+    GetBitContext gb;
+    int i, j;
+
+    init_get_bits8(&gb, pi->data + offset, FFMIN(pi->data_size - offset, MAX_BLOCK_BYTES));
+    step     = get_sv(&gb);
+    distance = get_uv(&gb);
+    for (i = 0; i < NB_FIELDS; i++) {
+        base[i] = get_sv(&gb);
+        bits[i] = get_bits(&gb, 7);
+    }
+
+    for (j = 0; j < n; j++) {
+        AVIndexEntry *e = &pi->cache[j];
+        uint64_t v[NB_FIELDS];
+
+        for (i = 0; i < NB_FIELDS; i++)
+            v[i] = base[i] + get_bits64(&gb, bits[i]);
+
+        e->flags = v[FIELD_FLAGS];
+        e->size  = v[FIELD_SIZE];
+        if (j) {
+            ts      += step;
+            distance = e->flags & AVINDEX_KEYFRAME ? 0 : distance + 1;
+        }
+        e->timestamp    = ts       + v[FIELD_TIMESTAMP];
+        e->pos          = pos      + v[FIELD_POS];
+        e->min_distance = distance + v[FIELD_DISTANCE];
+
+        ts       = e->timestamp;
+        pos      = e->pos + e->size;
+        distance = e->min_distance;
+    }
+    pi->cached_block = b;
+}
+
+const AVIndexEntry *ff_packed_index_get(FFPackedIndex *pi, int idx)
+{
+    if (pi->cached_block != idx >> BLOCK_BITS)
+        read_block(pi, idx >> BLOCK_BITS);
+    return &pi->cache[idx & (BLOCK_SIZE - 1)];
+}
+
+int ff_packed_index_search(FFPackedIndex *pi, int64_t wanted_timestamp,
+                           int flags)
+{
+    int nb_entries = pi->nb_entries;
+    const AVIndexEntry *e;
+    int a, b, m;
+
+    a = -1;
+    b = nb_entries;
+
+    if (b) {
+        e = ff_packed_index_get(pi, b - 1);
+        if (e->timestamp < wanted_timestamp)
+            a = b - 1;
+    }
+
+    while (b - a > 1) {
+        m = (a + b) >> 1;
+        e = ff_packed_index_get(pi, m);
+
+        // Search for the next non-discarded packet.
+        while ((e->flags & AVINDEX_DISCARD_FRAME) && m < b && m < nb_entries - 1) {
+            e = ff_packed_index_get(pi, ++m);
+            if (m == b && e->timestamp >= wanted_timestamp) {
+                m = b - 1;
+                e = ff_packed_index_get(pi, m);
+                break;
+            }
+        }
+
+        if (e->timestamp >= wanted_timestamp)
+            b = m;
+        if (e->timestamp <= wanted_timestamp)
+            a = m;
+    }
+    m = (flags & AVSEEK_FLAG_BACKWARD) ? a : b;
+
+    if (!(flags & AVSEEK_FLAG_ANY)) {
+        while (m >= 0 && m < nb_entries) {
+            e = ff_packed_index_get(pi, m);
+            if (e->flags & AVINDEX_KEYFRAME)
+                break;
+            m += (flags & AVSEEK_FLAG_BACKWARD) ? -1 : 1;
+        }
+    }
+
+    if (m == nb_entries)
+        return -1;
+    return m;
+}
+
+size_t ff_packed_index_size(const FFPackedIndex *pi)
+{
+    return sizeof(*pi) + pi->nb_supers * sizeof(*pi->supers) +
+           pi->nb_blocks * sizeof(*pi->blocks) +
+           pi->data_size + AV_INPUT_BUFFER_PADDING_SIZE;
+}
+
+void ff_packed_index_free(FFPackedIndex **ppi)
+{
+    FFPackedIndex *pi = *ppi;
+
+    if (!pi)
+        return;
+    av_freep(&pi->supers);
+    av_freep(&pi->blocks);
+    av_freep(&pi->data);
+    av_freep(ppi);
+}
@@ -0,0 +1,66 @@
+/*
+ * Compact read-only storage for stream indexes
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_PACKEDINDEX_H
+#define AVFORMAT_PACKEDINDEX_H
+
+#include <stddef.h>
+
+#include "avformat.h"
+
+/**
+ * An array of index entries stored as blocks of 64 entries, each entry
+ * coded as its difference from the one predicted from the previous entry.
+ * A block is decoded as a whole when one of its entries is read, and kept
+ * until an entry of another block is read. The bases of the blocks are
+ * relative to those of a coarser table of super blocks, so that the block
+ * table stays small too.
+ */
+typedef struct FFPackedIndex FFPackedIndex;
+
+/**
+ * Pack an array of index entries.
+ *
+ * @return the packed index, NULL on allocation failure
+ */
+FFPackedIndex *ff_packed_index_alloc(const AVIndexEntry *entries, int nb_entries);
+
+/**
+ * Read entry idx of the index.
+ *
+ * @return the entry, valid until an entry of another block of the index
+ *         is read
+ */
+const AVIndexEntry *ff_packed_index_get(FFPackedIndex *pi, int idx);
+
+/**
+ * Same as ff_index_search_timestamp() on the unpacked entries.
+ */
+int ff_packed_index_search(FFPackedIndex *pi, int64_t wanted_timestamp,
+                           int flags);
+
+/**
+ * @return the number of bytes allocated for the index
+ */
+size_t ff_packed_index_size(const FFPackedIndex *pi);
+
+void ff_packed_index_free(FFPackedIndex **pi);
+
+#endif /* AVFORMAT_PACKEDINDEX_H */
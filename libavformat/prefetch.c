@@ -0,0 +1,342 @@
+/*
+ * Background downloads for the adaptive streaming demuxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/avassert.h"
+#include "libavutil/error.h"
+#include "libavutil/fifo.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "prefetch.h"
+
+#if HAVE_THREADS
+
+#include <stdatomic.h>
+
+#define READ_SIZE 32768
+
+struct PrefetchDownload {
+    AVFormatContext *s;
+    char *url;
+    AVDictionary *opts;
+    int64_t seek_offset;
+    int64_t size;
+    int max_buffered;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    /* The interrupt callback of the demuxer is only called from the
+     * demuxer thread, which sets abort when it fires. */
+    AVIOInterruptCB interrupt_callback;
+    atomic_int abort;
+
+    /* protected by lock */
+    int64_t start_time;
+    AVFifoBuffer *fifo;
+    int done;
+    int error;
+
+    /* written by the thread, valid once done is set */
+    int64_t load_time;
+    char *location;
+    char *cookies;
+};
+
+static int download_interrupt_cb(void *opaque)
+{
+    PrefetchDownload *d = opaque;
+    return atomic_load(&d->abort);
+}
+
+/**
+ * Wait for the download thread with d->lock held, aborting the download
+ * if the interrupt callback of the demuxer fires meanwhile.
+ */
+static int download_cond_wait(PrefetchDownload *d)
+{
+    int64_t t = av_gettime() + 100000;
+    struct timespec tv = { .tv_sec  =  t / 1000000,
+                           .tv_nsec = (t % 1000000) * 1000 };
+
+    if (ff_check_interrupt(&d->s->interrupt_callback)) {
+        atomic_store(&d->abort, 1);
+        pthread_cond_broadcast(&d->cond);
+        return AVERROR_EXIT;
+    }
+    pthread_cond_timedwait(&d->cond, &d->lock, &tv);
+    return 0;
+}
+
+static int download_write(PrefetchDownload *d, const uint8_t *buf, int size)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&d->lock);
+    while (!atomic_load(&d->abort) && d->max_buffered &&
+           av_fifo_size(d->fifo) &&
+           av_fifo_size(d->fifo) + size > d->max_buffered)
+        pthread_cond_wait(&d->cond, &d->lock);
+    if (atomic_load(&d->abort))
+        ret = AVERROR_EXIT;
+    else if (av_fifo_space(d->fifo) < size)
+        ret = av_fifo_grow(d->fifo, size);
+    if (ret >= 0) {
+        av_fifo_generic_write(d->fifo, (void *)buf, size, NULL);
+        pthread_cond_broadcast(&d->cond);
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ret;
+}
+
+static void *download_thread(void *arg)
+{
+    PrefetchDownload *d = arg;
+    AVIOContext *in = NULL;
+    uint8_t buf[READ_SIZE];
+    int64_t remaining = d->size;
+    int ret;
+
+    pthread_mutex_lock(&d->lock);
+    while (!atomic_load(&d->abort)) {
+        int64_t now = av_gettime_relative(), t;
+        struct timespec tv;
+
+        if (now >= d->start_time)
+            break;
+        /* the condition waits on the wall clock, start_time is monotonic */
+        t = av_gettime() + d->start_time - now;
+        tv.tv_sec  =  t / 1000000;
+        tv.tv_nsec = (t % 1000000) * 1000;
+        pthread_cond_timedwait(&d->cond, &d->lock, &tv);
+    }
+    pthread_mutex_unlock(&d->lock);
+    d->load_time = av_gettime_relative();
+
+    /* Open directly rather than through io_open so that the whole protocol
+     * stack sees our interrupt callback and can be aborted. */
+    ret = ffio_open_whitelist(&in, d->url, AVIO_FLAG_READ,
+                              &d->interrupt_callback, &d->opts,
+                              d->s->protocol_whitelist, d->s->protocol_blacklist);
+    if (ret >= 0 && d->seek_offset) {
+        int64_t pos = avio_seek(in, d->seek_offset, SEEK_SET);
+        ret = pos < 0 ? pos : 0;
+    }
+    if (ret >= 0) {
+        av_opt_get(in, "location", AV_OPT_SEARCH_CHILDREN, (uint8_t **)&d->location);
+        av_opt_get(in, "cookies",  AV_OPT_SEARCH_CHILDREN, (uint8_t **)&d->cookies);
+    }
+
+    while (ret >= 0 && remaining) {
+        int len = remaining < 0 ? sizeof(buf) : FFMIN(remaining, sizeof(buf));
+
+        ret = avio_read(in, buf, len);
+        if (ret <= 0)
+            break;
+        if (remaining > 0)
+            remaining -= ret;
+        ret = download_write(d, buf, ret);
+    }
+    avio_closep(&in);
+
+    pthread_mutex_lock(&d->lock);
+    d->done  = 1;
+    d->error = ret == AVERROR_EOF ? 0 : FFMIN(ret, 0);
+    pthread_cond_broadcast(&d->cond);
+    pthread_mutex_unlock(&d->lock);
+    return NULL;
+}
+
+int ff_prefetch_start(PrefetchDownload **pd, AVFormatContext *s,
+                      const char *url, AVDictionary *opts,
+                      int64_t seek_offset, int64_t size,
+                      int max_buffered, int64_t start_time)
+{
+    PrefetchDownload *d = av_mallocz(sizeof(*d));
+    int ret;
+
+    *pd = NULL;
+    if (!d)
+        return AVERROR(ENOMEM);
+    d->s            = s;
+    d->seek_offset  = seek_offset;
+    d->size         = size;
+    d->start_time   = start_time;
+    d->max_buffered = max_buffered;
+    d->interrupt_callback.callback = download_interrupt_cb;
+    d->interrupt_callback.opaque   = d;
+    atomic_init(&d->abort, 0);
+
+    d->url  = av_strdup(url);
+    d->fifo = av_fifo_alloc(max_buffered ? max_buffered : READ_SIZE);
+    if (!d->url || !d->fifo) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = av_dict_copy(&d->opts, opts, 0)) < 0)
+        goto fail;
+
+    if ((ret = AVERROR(pthread_mutex_init(&d->lock, NULL))))
+        goto fail;
+    if ((ret = AVERROR(pthread_cond_init(&d->cond, NULL)))) {
+        pthread_mutex_destroy(&d->lock);
+        goto fail;
+    }
+    if ((ret = AVERROR(pthread_create(&d->thread, NULL, download_thread, d)))) {
+        pthread_cond_destroy(&d->cond);
+        pthread_mutex_destroy(&d->lock);
+        goto fail;
+    }
+    *pd = d;
+    return 0;
+
+fail:
+    av_fifo_freep(&d->fifo);
+    av_dict_free(&d->opts);
+    av_freep(&d->url);
+    av_freep(&d);
+    return ret;
+}
+
+int ff_prefetch_read(PrefetchDownload *d, uint8_t *buf, int size)
+{
+    int len = 0, ret = 0;
+
+    pthread_mutex_lock(&d->lock);
+    while (len < size) {
+        int n = FFMIN(size - len, av_fifo_size(d->fifo));
+        if (n) {
+            av_fifo_generic_read(d->fifo, buf + len, n, NULL);
+            len += n;
+            pthread_cond_broadcast(&d->cond);
+        } else if (d->done) {
+            break;
+        } else if ((ret = download_cond_wait(d)) < 0) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&d->lock);
+    if (len)
+        return len;
+    if (ret < 0)
+        return ret;
+    return d->error < 0 ? d->error : AVERROR_EOF;
+}
+
+int ff_prefetch_wait(PrefetchDownload *d)
+{
+    int ret = 0;
+
+    /* no buffering limit, or the download would never finish */
+    av_assert0(!d->max_buffered);
+    pthread_mutex_lock(&d->lock);
+    d->start_time = 0;
+    pthread_cond_broadcast(&d->cond);
+    while (!d->done && ret >= 0)
+        ret = download_cond_wait(d);
+    if (ret >= 0)
+        ret = d->error < 0 ? d->error : av_fifo_size(d->fifo);
+    pthread_mutex_unlock(&d->lock);
+    return ret;
+}
+
+const char *ff_prefetch_location(PrefetchDownload *d)
+{
+    return d->location;
+}
+
+const char *ff_prefetch_cookies(PrefetchDownload *d)
+{
+    return d->cookies;
+}
+
+int64_t ff_prefetch_load_time(PrefetchDownload *d)
+{
+    return d->load_time;
+}
+
+void ff_prefetch_free(PrefetchDownload **pd)
+{
+    PrefetchDownload *d = *pd;
+
+    if (!d)
+        return;
+    pthread_mutex_lock(&d->lock);
+    atomic_store(&d->abort, 1);
+    pthread_cond_broadcast(&d->cond);
+    pthread_mutex_unlock(&d->lock);
+    pthread_join(d->thread, NULL);
+
+    pthread_cond_destroy(&d->cond);
+    pthread_mutex_destroy(&d->lock);
+    av_fifo_freep(&d->fifo);
+    av_dict_free(&d->opts);
+    av_freep(&d->location);
+    av_freep(&d->cookies);
+    av_freep(&d->url);
+    av_freep(pd);
+}
+
+#else
+
+int ff_prefetch_start(PrefetchDownload **pd, AVFormatContext *s,
+                      const char *url, AVDictionary *opts,
+                      int64_t seek_offset, int64_t size,
+                      int max_buffered, int64_t start_time)
+{
+    *pd = NULL;
+    return AVERROR(ENOSYS);
+}
+
+int ff_prefetch_read(PrefetchDownload *d, uint8_t *buf, int size)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_prefetch_wait(PrefetchDownload *d)
+{
+    return AVERROR(ENOSYS);
+}
+
+const char *ff_prefetch_location(PrefetchDownload *d)
+{
+    return NULL;
+}
+
+const char *ff_prefetch_cookies(PrefetchDownload *d)
+{
+    return NULL;
+}
+
+int64_t ff_prefetch_load_time(PrefetchDownload *d)
+{
+    return 0;
+}
+
+void ff_prefetch_free(PrefetchDownload **pd)
+{
+}
+
+#endif /* HAVE_THREADS */
@@ -0,0 +1,104 @@
+/*
+ * Background downloads for the adaptive streaming demuxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_PREFETCH_H
+#define AVFORMAT_PREFETCH_H
+
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "avformat.h"
+
+/**
+ * A URL being read into memory by a thread of its own, so that segments
+ * and manifests can be fetched before the demuxer gets to them.
+ */
+typedef struct PrefetchDownload PrefetchDownload;
+
+/**
+ * Start downloading a URL in the background.
+ *
+ * The URL is opened with ffio_open_whitelist() using the white- and
+ * blacklists of s, so the caller is responsible for any further checks
+ * on it. Since AVFormatContext.io_open is bypassed, prefetching must only
+ * be used if ff_format_io_is_default() is true for s. The download is aborted when the interrupt callback of s fires
+ * while ff_prefetch_read() or ff_prefetch_wait() wait for it; the callback
+ * is never called from the download thread.
+ *
+ * @param pd           pointer to the new download
+ * @param s            demuxer the download is done for
+ * @param url          URL to read
+ * @param opts         options to open the URL with, not modified
+ * @param seek_offset  position to seek to after opening the URL, for
+ *                     protocols that do not take an offset option
+ * @param size         number of bytes to read, -1 to read until EOF
+ * @param max_buffered the download pauses while this many bytes are
+ *                     waiting to be read, 0 for no limit
+ * @param start_time   do not open the URL before this time, as given by
+ *                     av_gettime_relative(); 0 to start immediately
+ * @return 0 on success, a negative AVERROR code on failure;
+ *         AVERROR(ENOSYS) if built without thread support
+ */
+int ff_prefetch_start(PrefetchDownload **pd, AVFormatContext *s,
+                      const char *url, AVDictionary *opts,
+                      int64_t seek_offset, int64_t size,
+                      int max_buffered, int64_t start_time);
+
+/**
+ * Read downloaded data, waiting for it if necessary. Like avio_read(),
+ * less than size bytes are only returned at the end of the download.
+ *
+ * @return number of bytes read, AVERROR_EOF at the end of the download,
+ *         or the error the download failed with
+ */
+int ff_prefetch_read(PrefetchDownload *d, uint8_t *buf, int size);
+
+/**
+ * Start the download now if it was delayed, and wait until it is done.
+ *
+ * @return number of bytes waiting to be read, or the error the download
+ *         failed with
+ */
+int ff_prefetch_wait(PrefetchDownload *d);
+
+/**
+ * @return the URL the request was redirected to, or NULL if it was not
+ *         redirected; only valid once ff_prefetch_wait() has returned
+ */
+const char *ff_prefetch_location(PrefetchDownload *d);
+
+/**
+ * @return the cookies of the HTTP response, or NULL if there are none; only
+ *         valid once ff_prefetch_wait() has returned
+ */
+const char *ff_prefetch_cookies(PrefetchDownload *d);
+
+/**
+ * @return the av_gettime_relative() time the URL was opened at; only
+ *         valid once ff_prefetch_wait() has returned
+ */
+int64_t ff_prefetch_load_time(PrefetchDownload *d);
+
+/**
+ * Abort the download if it is still running and free it.
+ */
+void ff_prefetch_free(PrefetchDownload **pd);
+
+#endif /* AVFORMAT_PREFETCH_H */
@@ -0,0 +1,564 @@
+/*
+ * On-disk cache of stream parameters and indexes
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#include <sys/stat.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/md5.h"
+#include "libavutil/mem.h"
+#include "libavutil/random_seed.h"
+#include "config.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "os_support.h"
+#include "probecache.h"
+#include "version.h"
+
+#define CACHE_MAGIC   MKBETAG('F', 'F', 'P', 'C')
+#define CACHE_VERSION 2
+
+#define CACHE_HAS_INFO  1
+#define CACHE_HAS_INDEX 2
+
+#define INDEX_ENTRY_SIZE 25
+
+typedef struct ProbeCacheStream {
+    /* as created by the demuxer, before avformat_find_stream_info() */
+    enum AVMediaType codec_type;
+    enum AVCodecID codec_id;
+    AVRational time_base;
+
+    AVCodecParameters *par;
+    AVRational r_frame_rate;
+    AVRational avg_frame_rate;
+    AVRational sample_aspect_ratio;
+    int64_t start_time;
+    int64_t duration;
+    int64_t nb_frames;
+    int codec_info_nb_frames;
+    /* not part of the codec parameters, but used for timestamps */
+    int ticks_per_frame;
+    AVRational framerate;
+
+    AVIndexEntry *index_entries;
+    int nb_index_entries;
+} ProbeCacheStream;
+
+struct ProbeCache {
+    char *filename;
+    int64_t size;
+    int64_t mtime;          ///< in nanoseconds where the system provides them
+
+    ProbeCacheStream *streams;
+    int nb_streams;
+
+    int flags;
+    int64_t start_time;
+    int64_t duration;
+    int64_t bit_rate;
+
+    /* set when there is something to write */
+    int dirty;
+};
+
+static void reset_cache(ProbeCache *pc)
+{
+    int i;
+
+    for (i = 0; i < pc->nb_streams; i++) {
+        avcodec_parameters_free(&pc->streams[i].par);
+        av_freep(&pc->streams[i].index_entries);
+        pc->streams[i].nb_index_entries = 0;
+    }
+    pc->flags = 0;
+}
+
+static void write_rational(AVIOContext *pb, AVRational q)
+{
+    avio_wb32(pb, q.num);
+    avio_wb32(pb, q.den);
+}
+
+static AVRational read_rational(AVIOContext *pb)
+{
+    AVRational q;
+
+    q.num = avio_rb32(pb);
+    q.den = avio_rb32(pb);
+    return q;
+}
+
+static void write_par(AVIOContext *pb, const AVCodecParameters *par)
+{
+    avio_wb32(pb, par->codec_type);
+    avio_wb32(pb, par->codec_id);
+    avio_wb32(pb, par->codec_tag);
+    avio_wb32(pb, par->extradata_size);
+    avio_write(pb, par->extradata, par->extradata_size);
+    avio_wb32(pb, par->format);
+    avio_wb64(pb, par->bit_rate);
+    avio_wb32(pb, par->bits_per_coded_sample);
+    avio_wb32(pb, par->bits_per_raw_sample);
+    avio_wb32(pb, par->profile);
+    avio_wb32(pb, par->level);
+    avio_wb32(pb, par->width);
+    avio_wb32(pb, par->height);
+    write_rational(pb, par->sample_aspect_ratio);
+    avio_wb32(pb, par->field_order);
+    avio_wb32(pb, par->color_range);
+    avio_wb32(pb, par->color_primaries);
+    avio_wb32(pb, par->color_trc);
+    avio_wb32(pb, par->color_space);
+    avio_wb32(pb, par->chroma_location);
+    avio_wb32(pb, par->video_delay);
+    avio_wb64(pb, par->channel_layout);
+    avio_wb32(pb, par->channels);
+    avio_wb32(pb, par->sample_rate);
+    avio_wb32(pb, par->block_align);
+    avio_wb32(pb, par->frame_size);
+    avio_wb32(pb, par->initial_padding);
+    avio_wb32(pb, par->trailing_padding);
+    avio_wb32(pb, par->seek_preroll);
+}
+
+static int read_par(AVIOContext *pb, AVCodecParameters *par, int64_t max_size)
+{
+    int ret;
+
+    par->codec_type = (int)avio_rb32(pb);
+    par->codec_id   = avio_rb32(pb);
+    par->codec_tag  = avio_rb32(pb);
+    ret = avio_rb32(pb);
+    if (ret < 0 || ret > max_size)
+        return AVERROR_INVALIDDATA;
+    if (ret && (ret = ff_get_extradata(NULL, par, pb, ret)) < 0)
+        return ret;
+    par->format                = (int)avio_rb32(pb);
+    par->bit_rate              = avio_rb64(pb);
+    par->bits_per_coded_sample = avio_rb32(pb);
+    par->bits_per_raw_sample   = avio_rb32(pb);
+    par->profile               = (int)avio_rb32(pb);
+    par->level                 = (int)avio_rb32(pb);
+    par->width                 = avio_rb32(pb);
+    par->height                = avio_rb32(pb);
+    par->sample_aspect_ratio   = read_rational(pb);
+    par->field_order           = avio_rb32(pb);
+    par->color_range           = avio_rb32(pb);
+    par->color_primaries       = avio_rb32(pb);
+    par->color_trc             = avio_rb32(pb);
+    par->color_space           = avio_rb32(pb);
+    par->chroma_location       = avio_rb32(pb);
+    par->video_delay           = avio_rb32(pb);
+    par->channel_layout        = avio_rb64(pb);
+    par->channels              = avio_rb32(pb);
+    par->sample_rate           = avio_rb32(pb);
+    par->block_align           = avio_rb32(pb);
+    par->frame_size            = avio_rb32(pb);
+    par->initial_padding       = avio_rb32(pb);
+    par->trailing_padding      = avio_rb32(pb);
+    par->seek_preroll          = avio_rb32(pb);
+    return 0;
+}
+
+static void write_str(AVIOContext *pb, const char *str)
+{
+    int len = strlen(str);
+
+    avio_wb32(pb, len);
+    avio_write(pb, str, len);
+}
+
+static int check_str(AVIOContext *pb, const char *str)
+{
+    int len = strlen(str);
+    uint8_t buf[256];
+
+    if (avio_rb32(pb) != len)
+        return 0;
+    while (len > 0) {
+        int n = FFMIN(len, sizeof(buf));
+        if (avio_read(pb, buf, n) != n || memcmp(buf, str, n))
+            return 0;
+        str += n;
+        len -= n;
+    }
+    return 1;
+}
+
+static int read_cache(AVFormatContext *s, ProbeCache *pc, AVIOContext *pb)
+{
+    int64_t file_size = avio_size(pb);
+    int i, j, ret;
+
+    if (avio_rb32(pb) != CACHE_MAGIC || avio_rb32(pb) != CACHE_VERSION ||
+        avio_rb32(pb) != LIBAVFORMAT_VERSION_INT ||
+        !check_str(pb, s->url) || !check_str(pb, s->iformat->name) ||
+        avio_rb64(pb) != pc->size || avio_rb64(pb) != pc->mtime ||
+        avio_rb32(pb) != pc->nb_streams)
+        return 0;
+    for (i = 0; i < pc->nb_streams; i++) {
+        ProbeCacheStream *ps = &pc->streams[i];
+        AVRational tb;
+
+        if ((int)avio_rb32(pb) != ps->codec_type || avio_rb32(pb) != ps->codec_id)
+            return 0;
+        tb = read_rational(pb);
+        if (av_cmp_q(tb, ps->time_base))
+            return 0;
+    }
+
+    pc->flags = avio_rb32(pb);
+    if (pc->flags & CACHE_HAS_INFO) {
+        pc->start_time = avio_rb64(pb);
+        pc->duration   = avio_rb64(pb);
+        pc->bit_rate   = avio_rb64(pb);
+        for (i = 0; i < pc->nb_streams; i++) {
+            ProbeCacheStream *ps = &pc->streams[i];
+
+            if (!(ps->par = avcodec_parameters_alloc()))
+                return AVERROR(ENOMEM);
+            if ((ret = read_par(pb, ps->par, file_size - avio_tell(pb))) < 0)
+                return ret;
+            ps->r_frame_rate         = read_rational(pb);
+            ps->avg_frame_rate       = read_rational(pb);
+            ps->sample_aspect_ratio  = read_rational(pb);
+            ps->start_time           = avio_rb64(pb);
+            ps->duration             = avio_rb64(pb);
+            ps->nb_frames            = avio_rb64(pb);
+            ps->codec_info_nb_frames = avio_rb32(pb);
+            ps->ticks_per_frame      = avio_rb32(pb);
+            ps->framerate            = read_rational(pb);
+        }
+    }
+    if (pc->flags & CACHE_HAS_INDEX) {
+        for (i = 0; i < pc->nb_streams; i++) {
+            ProbeCacheStream *ps = &pc->streams[i];
+            unsigned nb_entries = avio_rb32(pb);
+
+            if (nb_entries > (file_size - avio_tell(pb)) / INDEX_ENTRY_SIZE)
+                return AVERROR_INVALIDDATA;
+            if (!nb_entries)
+                continue;
+            ps->index_entries = av_malloc_array(nb_entries, sizeof(*ps->index_entries));
+            if (!ps->index_entries)
+                return AVERROR(ENOMEM);
+            ps->nb_index_entries = nb_entries;
+            for (j = 0; j < nb_entries; j++) {
+                AVIndexEntry *e = &ps->index_entries[j];
+                e->pos          = avio_rb64(pb);
+                e->timestamp    = avio_rb64(pb);
+                e->size         = avio_rb32(pb);
+                e->flags        = avio_r8(pb);
+                e->min_distance = avio_rb32(pb);
+            }
+        }
+    }
+    if (pb->error)
+        return pb->error;
+    return avio_feof(pb) ? AVERROR_INVALIDDATA : 1;
+}
+
+static int write_cache(AVFormatContext *s, ProbeCache *pc, AVIOContext *pb)
+{
+    int i, j;
+
+    avio_wb32(pb, CACHE_MAGIC);
+    avio_wb32(pb, CACHE_VERSION);
+    avio_wb32(pb, LIBAVFORMAT_VERSION_INT);
+    write_str(pb, s->url);
+    write_str(pb, s->iformat->name);
+    avio_wb64(pb, pc->size);
+    avio_wb64(pb, pc->mtime);
+    avio_wb32(pb, pc->nb_streams);
+    for (i = 0; i < pc->nb_streams; i++) {
+        avio_wb32(pb, pc->streams[i].codec_type);
+        avio_wb32(pb, pc->streams[i].codec_id);
+        write_rational(pb, pc->streams[i].time_base);
+    }
+
+    avio_wb32(pb, pc->flags);
+    if (pc->flags & CACHE_HAS_INFO) {
+        avio_wb64(pb, pc->start_time);
+        avio_wb64(pb, pc->duration);
+        avio_wb64(pb, pc->bit_rate);
+        for (i = 0; i < pc->nb_streams; i++) {
+            ProbeCacheStream *ps = &pc->streams[i];
+
+            write_par(pb, ps->par);
+            write_rational(pb, ps->r_frame_rate);
+            write_rational(pb, ps->avg_frame_rate);
+            write_rational(pb, ps->sample_aspect_ratio);
+            avio_wb64(pb, ps->start_time);
+            avio_wb64(pb, ps->duration);
+            avio_wb64(pb, ps->nb_frames);
+            avio_wb32(pb, ps->codec_info_nb_frames);
+            avio_wb32(pb, ps->ticks_per_frame);
+            write_rational(pb, ps->framerate);
+        }
+    }
+    if (pc->flags & CACHE_HAS_INDEX) {
+        for (i = 0; i < pc->nb_streams; i++) {
+            ProbeCacheStream *ps = &pc->streams[i];
+
+            avio_wb32(pb, ps->nb_index_entries);
+            for (j = 0; j < ps->nb_index_entries; j++) {
+                const AVIndexEntry *e = &ps->index_entries[j];
+                avio_wb64(pb, e->pos);
+                avio_wb64(pb, e->timestamp);
+                avio_wb32(pb, e->size);
+                avio_w8  (pb, e->flags);
+                avio_wb32(pb, e->min_distance);
+            }
+        }
+    }
+    avio_flush(pb);
+    return pb->error;
+}
+
+void ff_probe_cache_open(AVFormatContext *s)
+{
+    const char *path = s->url, *proto;
+    uint8_t md5[16];
+    char hex[2 * sizeof(md5) + 1];
+    struct stat st;
+    AVIOContext *pb;
+    ProbeCache *pc;
+    int i, ret;
+
+    if (!s->probe_cache || !s->pb || !s->nb_streams ||
+        s->flags & AVFMT_FLAG_CUSTOM_IO || s->ctx_flags & AVFMTCTX_NOHEADER)
+        return;
+    proto = avio_find_protocol_name(s->url);
+    if (!proto || strcmp(proto, "file"))
+        return;
+    av_strstart(path, "file:", &path);
+#ifndef _WIN32
+    ret = stat(path, &st);
+#else
+    ret = win32_stat(path, &st);
+#endif
+    if (ret < 0 || !S_ISREG(st.st_mode))
+        return;
+
+    pc = av_mallocz(sizeof(*pc));
+    if (!pc)
+        return;
+    pc->size       = st.st_size;
+    pc->mtime      = st.st_mtime * INT64_C(1000000000);
+#if HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+    /* a file rewritten within the same second keeps its st_mtime */
+    pc->mtime     += st.st_mtim.tv_nsec;
+#endif
+    pc->nb_streams = s->nb_streams;
+    pc->streams    = av_mallocz_array(s->nb_streams, sizeof(*pc->streams));
+    av_md5_sum(md5, s->url, strlen(s->url));
+    ff_data_to_hex(hex, md5, sizeof(md5), 1);
+    hex[2 * sizeof(md5)] = 0;
+    pc->filename = av_asprintf("%s/%s.ffpc", s->probe_cache, hex);
+    if (!pc->streams || !pc->filename) {
+        av_freep(&pc->streams);
+        av_freep(&pc->filename);
+        av_freep(&pc);
+        return;
+    }
+    for (i = 0; i < s->nb_streams; i++) {
+        pc->streams[i].codec_type = s->streams[i]->codecpar->codec_type;
+        pc->streams[i].codec_id   = s->streams[i]->codecpar->codec_id;
+        pc->streams[i].time_base  = s->streams[i]->time_base;
+    }
+    s->internal->probe_cache = pc;
+
+    if (ffio_open_whitelist(&pb, pc->filename, AVIO_FLAG_READ,
+                            &s->interrupt_callback, NULL,
+                            s->protocol_whitelist, s->protocol_blacklist) < 0)
+        return;
+    ret = read_cache(s, pc, pb);
+    avio_closep(&pb);
+    if (ret <= 0) {
+        if (ret < 0)
+            av_log(s, AV_LOG_VERBOSE, "Ignoring invalid probe cache %s\n",
+                   pc->filename);
+        reset_cache(pc);
+    }
+}
+
+int ff_probe_cache_get_info(AVFormatContext *s)
+{
+    ProbeCache *pc = s->internal->probe_cache;
+    int i, ret;
+
+    if (!pc || !(pc->flags & CACHE_HAS_INFO) || s->nb_streams != pc->nb_streams)
+        return 0;
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        ProbeCacheStream *ps = &pc->streams[i];
+
+        if ((ret = avcodec_parameters_copy(st->codecpar, ps->par)) < 0)
+            return ret;
+        st->r_frame_rate         = ps->r_frame_rate;
+        st->avg_frame_rate       = ps->avg_frame_rate;
+        st->sample_aspect_ratio  = ps->sample_aspect_ratio;
+        st->start_time           = ps->start_time;
+        st->duration             = ps->duration;
+        st->nb_frames            = ps->nb_frames;
+        st->codec_info_nb_frames = ps->codec_info_nb_frames;
+        st->internal->avctx->ticks_per_frame = ps->ticks_per_frame;
+        st->internal->avctx->framerate       = ps->framerate;
+    }
+    s->start_time = pc->start_time;
+    s->duration   = pc->duration;
+    s->bit_rate   = pc->bit_rate;
+    av_log(s, AV_LOG_VERBOSE, "Read the stream parameters from the probe cache\n");
+    return 1;
+}
+
+void ff_probe_cache_set_info(AVFormatContext *s)
+{
+    ProbeCache *pc = s->internal->probe_cache;
+    int i;
+
+    if (!pc || pc->flags & CACHE_HAS_INFO || s->nb_streams != pc->nb_streams)
+        return;
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        ProbeCacheStream *ps = &pc->streams[i];
+
+        if (!(ps->par = avcodec_parameters_alloc()) ||
+            avcodec_parameters_copy(ps->par, st->codecpar) < 0)
+            goto fail;
+        ps->r_frame_rate         = st->r_frame_rate;
+        ps->avg_frame_rate       = st->avg_frame_rate;
+        ps->sample_aspect_ratio  = st->sample_aspect_ratio;
+        ps->start_time           = st->start_time;
+        ps->duration             = st->duration;
+        ps->nb_frames            = st->nb_frames;
+        ps->codec_info_nb_frames = st->codec_info_nb_frames;
+        ps->ticks_per_frame      = st->internal->avctx->ticks_per_frame;
+        ps->framerate            = st->internal->avctx->framerate;
+    }
+    pc->start_time = s->start_time;
+    pc->duration   = s->duration;
+    pc->bit_rate   = s->bit_rate;
+    pc->flags     |= CACHE_HAS_INFO;
+    pc->dirty      = 1;
+    return;
+fail:
+    for (i = 0; i < pc->nb_streams; i++)
+        avcodec_parameters_free(&pc->streams[i].par);
+}
+
+int ff_probe_cache_get_index(AVFormatContext *s)
+{
+    ProbeCache *pc = s->internal->probe_cache;
+    int i, j;
+
+    if (!pc || !(pc->flags & CACHE_HAS_INDEX) || s->flags & AVFMT_FLAG_IGNIDX ||
+        s->nb_streams != pc->nb_streams)
+        return 0;
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        ProbeCacheStream *ps = &pc->streams[i];
+
+        if (!ps->nb_index_entries)
+            continue;
+        if (!st->nb_index_entries) {
+            AVIndexEntry *entries = av_memdup(ps->index_entries,
+                                              ps->nb_index_entries * sizeof(*entries));
+            if (!entries)
+                return AVERROR(ENOMEM);
+            av_freep(&st->index_entries);
+            st->index_entries    = entries;
+            st->nb_index_entries = ps->nb_index_entries;
+            st->index_entries_allocated_size = ps->nb_index_entries * sizeof(*entries);
+            continue;
+        }
+        for (j = 0; j < ps->nb_index_entries; j++) {
+            const AVIndexEntry *e = &ps->index_entries[j];
+            av_add_index_entry(st, e->pos, e->timestamp, e->size,
+                               e->min_distance, e->flags);
+        }
+    }
+    av_log(s, AV_LOG_VERBOSE, "Read the index from the probe cache\n");
+    return 1;
+}
+
+void ff_probe_cache_set_index(AVFormatContext *s)
+{
+    ProbeCache *pc = s->internal->probe_cache;
+    int i;
+
+    if (!pc || s->flags & AVFMT_FLAG_IGNIDX || s->nb_streams != pc->nb_streams)
+        return;
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        ProbeCacheStream *ps = &pc->streams[i];
+
+        av_freep(&ps->index_entries);
+        ps->nb_index_entries = 0;
+        if (!st->nb_index_entries)
+            continue;
+        ps->index_entries = av_memdup(st->index_entries,
+                                      st->nb_index_entries * sizeof(*st->index_entries));
+        if (!ps->index_entries)
+            return;
+        ps->nb_index_entries = st->nb_index_entries;
+    }
+    pc->flags |= CACHE_HAS_INDEX;
+    pc->dirty  = 1;
+}
+
+void ff_probe_cache_close(AVFormatContext *s)
+{
+    ProbeCache *pc = s->internal->probe_cache;
+    AVIOContext *pb;
+    char *tmp;
+    int ret;
+
+    if (!pc)
+        return;
+    if (pc->dirty && pc->flags &&
+        (tmp = av_asprintf("%s.%08x.tmp", pc->filename, av_get_random_seed()))) {
+        /* write to a temporary file so that concurrent opens never see
+         * a partial entry */
+        ret = ffio_open_whitelist(&pb, tmp, AVIO_FLAG_WRITE,
+                                  &s->interrupt_callback, NULL,
+                                  s->protocol_whitelist, s->protocol_blacklist);
+        if (ret >= 0) {
+            ret = write_cache(s, pc, pb);
+            avio_closep(&pb);
+            if (ret >= 0)
+                ret = ff_rename(tmp, pc->filename, s);
+            if (ret < 0)
+                avpriv_io_delete(tmp);
+        }
+        if (ret < 0)
+            av_log(s, AV_LOG_VERBOSE, "Could not write probe cache %s: %s\n",
+                   pc->filename, av_err2str(ret));
+        av_free(tmp);
+    }
+    reset_cache(pc);
+    av_freep(&pc->streams);
+    av_freep(&pc->filename);
+    av_freep(&s->internal->probe_cache);
+}
@@ -0,0 +1,72 @@
+/*
+ * On-disk cache of stream parameters and indexes
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_PROBECACHE_H
+#define AVFORMAT_PROBECACHE_H
+
+#include "avformat.h"
+
+/**
+ * What is known about a local input file from previous opens, stored in
+ * the directory set by AVFormatContext.probe_cache and keyed by the path,
+ * size and modification time of the file.
+ */
+typedef struct ProbeCache ProbeCache;
+
+/**
+ * Look up the input in the cache. Called by avformat_open_input() once
+ * the header has been read; the cache entry is only used if the demuxer
+ * created the same streams as when it was written.
+ */
+void ff_probe_cache_open(AVFormatContext *s);
+
+/**
+ * Set the stream parameters found by avformat_find_stream_info() from the
+ * cache.
+ *
+ * @return 1 if all streams were set, 0 if the caller has to find them
+ */
+int ff_probe_cache_get_info(AVFormatContext *s);
+
+/**
+ * Store the stream parameters found by avformat_find_stream_info().
+ */
+void ff_probe_cache_set_info(AVFormatContext *s);
+
+/**
+ * Add the cached index entries to the streams. Demuxers call this in place
+ * of reading their index from the file.
+ *
+ * @return 1 if the index was restored, 0 if the demuxer has to build it
+ */
+int ff_probe_cache_get_index(AVFormatContext *s);
+
+/**
+ * Store the index entries of all streams. Demuxers call this once their
+ * index is complete.
+ */
+void ff_probe_cache_set_index(AVFormatContext *s);
+
+/**
+ * Write what was stored since ff_probe_cache_open() and free the cache.
+ */
+void ff_probe_cache_close(AVFormatContext *s);
+
+#endif /* AVFORMAT_PROBECACHE_H */
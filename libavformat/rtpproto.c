@@ -61,6 +61,10 @@ typedef struct RTPContext {
     char *block;
     char *fec_options_str;
     int64_t rw_timeout;
+    int64_t bitrate;
+    int64_t burst_bits;
+    int tx_batch;
+    int txtime;
 } RTPContext;
 
 #define OFFSET(x) offsetof(RTPContext, x)
@@ -80,6 +84,10 @@ static const AVOption options[] = {
     { "sources",            "Source list",                                                      OFFSET(sources),         AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",              "Block list",                                                       OFFSET(block),           AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "fec",                "FEC",                                                              OFFSET(fec_options_str), AV_OPT_TYPE_STRING, { .str = NULL },               .flags = E },
+    { "bitrate",            "Bits to send per second",                                          OFFSET(bitrate),         AV_OPT_TYPE_INT64,  { .i64 =  0 },     0, INT64_MAX, .flags = E },
+    { "burst_bits",         "Max length of bursts in bits (when using bitrate)",                OFFSET(burst_bits),      AV_OPT_TYPE_INT64,  { .i64 =  0 },     0, INT64_MAX, .flags = E },
+    { "tx_batch",           "Max number of packets sent per system call (when using bitrate)",  OFFSET(tx_batch),        AV_OPT_TYPE_INT,    { .i64 =  0 },     0, INT_MAX, .flags = E },
+    { "txtime",             "Let the kernel send packets at their paced time (when using bitrate)", OFFSET(txtime),      AV_OPT_TYPE_BOOL,   { .i64 =  0 },     0, 1,       .flags = E },
     { NULL }
 };
 
@@ -175,7 +183,8 @@ static void build_udp_url(RTPContext *s,
                           const char *hostname,
                           int port, int local_port,
                           const char *include_sources,
-                          const char *exclude_sources)
+                          const char *exclude_sources,
+                          int paced)
 {
     ff_url_join(buf, buf_size, "udp", NULL, hostname, port, NULL);
     if (local_port >= 0)
@@ -190,7 +199,17 @@ static void build_udp_url(RTPContext *s,
         url_add_option(buf, buf_size, "connect=1");
     if (s->dscp >= 0)
         url_add_option(buf, buf_size, "dscp=%d", s->dscp);
-    url_add_option(buf, buf_size, "fifo_size=0");
+    if (paced) {
+        /* keep the default fifo, the sending thread paces the packets */
+        url_add_option(buf, buf_size, "bitrate=%"PRId64, s->bitrate);
+        if (s->burst_bits > 0)
+            url_add_option(buf, buf_size, "burst_bits=%"PRId64, s->burst_bits);
+        if (s->tx_batch > 0)
+            url_add_option(buf, buf_size, "tx_batch=%d", s->tx_batch);
+        if (s->txtime)
+            url_add_option(buf, buf_size, "txtime=1");
+    } else
+        url_add_option(buf, buf_size, "fifo_size=0");
     if (include_sources && include_sources[0])
         url_add_option(buf, buf_size, "sources=%s", include_sources);
     if (exclude_sources && exclude_sources[0])
@@ -209,6 +228,10 @@ static void build_udp_url(RTPContext *s,
  *         'block=ip[,ip]'    : list disallowed source IP addresses
  *         'write_to_source=0/1' : send packets to the source address of the latest received packet
  *         'dscp=n'           : set DSCP value to n (QoS)
+ *         'bitrate=n'        : pace the outgoing rtp packets to n bits per second
+ *         'burst_bits=n'     : allow bursts of up to n bits when pacing
+ *         'tx_batch=n'       : send up to n paced packets per system call
+ *         'txtime=0/1'       : let the kernel send the paced packets on time
  * deprecated option:
  *         'localport=n'      : set the local port to n
  *
@@ -230,7 +253,7 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
     char path[1024];
     const char *p;
     int i, max_retry_count = 3;
-    int rtcpflags;
+    int rtcpflags, paced;
 
     av_url_split(NULL, 0, NULL, 0, hostname, sizeof(hostname), &rtp_port,
                  path, sizeof(path), uri);
@@ -270,6 +293,18 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "timeout", p)) {
             s->rw_timeout = strtol(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "bitrate", p)) {
+            s->bitrate = strtoll(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "burst_bits", p)) {
+            s->burst_bits = strtoll(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "tx_batch", p)) {
+            s->tx_batch = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "txtime", p)) {
+            s->txtime = strtol(buf, NULL, 10);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "sources", p)) {
             av_strlcpy(include_sources, buf, sizeof(include_sources));
             ff_ip_parse_sources(h, buf, &s->filters);
@@ -287,6 +322,9 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
     }
     if (s->rw_timeout >= 0)
         h->rw_timeout = s->rw_timeout;
+    /* Packets sent to the source of the latest received packet bypass
+     * the udp protocol, so they cannot be paced. */
+    paced = s->bitrate > 0 && !(flags & AVIO_FLAG_READ) && !s->write_to_source;
 
     if (s->fec_options_str) {
         p = s->fec_options_str;
@@ -315,7 +353,7 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
     for (i = 0; i < max_retry_count; i++) {
         build_udp_url(s, buf, sizeof(buf),
                       hostname, rtp_port, s->local_rtpport,
-                      sources, block);
+                      sources, block, paced);
         if (ffurl_open_whitelist(&s->rtp_hd, buf, flags, &h->interrupt_callback,
                                  NULL, h->protocol_whitelist, h->protocol_blacklist, h) < 0)
             goto fail;
@@ -329,7 +367,7 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
             s->local_rtcpport = s->local_rtpport + 1;
             build_udp_url(s, buf, sizeof(buf),
                           hostname, s->rtcp_port, s->local_rtcpport,
-                          sources, block);
+                          sources, block, 0);
             if (ffurl_open_whitelist(&s->rtcp_hd, buf, rtcpflags,
                                      &h->interrupt_callback, NULL,
                                      h->protocol_whitelist, h->protocol_blacklist, h) < 0) {
@@ -340,7 +378,7 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
         }
         build_udp_url(s, buf, sizeof(buf),
                       hostname, s->rtcp_port, s->local_rtcpport,
-                      sources, block);
+                      sources, block, 0);
         if (ffurl_open_whitelist(&s->rtcp_hd, buf, rtcpflags, &h->interrupt_callback,
                                  NULL, h->protocol_whitelist, h->protocol_blacklist, h) < 0)
             goto fail;
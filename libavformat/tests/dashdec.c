@@ -0,0 +1,99 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavformat/dashdec.c"
+
+#include <stdio.h>
+
+/*
+ * Timeline currently in use: three entries of two segments of 10, covering
+ * 0 to 60, without explicit start times.
+ */
+static const struct timeline old_timeline[] = {
+    { 0, 1, 10 },
+    { 0, 1, 10 },
+    { 0, 1, 10 },
+};
+
+/* entry of the refreshed manifest that is not known yet */
+static const struct timeline new_timeline[] = {
+    { 60, 1, 10 },
+};
+
+static int add_timelines(struct representation *rep,
+                         const struct timeline *tml, int nb)
+{
+    int i, ret;
+
+    for (i = 0; i < nb; i++) {
+        struct timeline *new_tml = av_memdup(&tml[i], sizeof(*new_tml));
+        if (!new_tml)
+            return AVERROR(ENOMEM);
+        ret = av_dynarray_add_nofree(&rep->timelines, &rep->n_timelines, new_tml);
+        if (ret < 0) {
+            av_free(new_tml);
+            return ret;
+        }
+    }
+    return 0;
+}
+
+static int test_refresh(int64_t timeline_start, int64_t cur_time)
+{
+    DASHContext c = { 0 };
+    struct representation old = { 0 }, refreshed = { 0 };
+    int64_t i;
+    int ret;
+
+    printf("manifest starting at %"PRId64", reading at %"PRId64"\n",
+           timeline_start, cur_time);
+
+    if ((ret = add_timelines(&old, old_timeline, FF_ARRAY_ELEMS(old_timeline))) < 0 ||
+        (ret = add_timelines(&refreshed, new_timeline, FF_ARRAY_ELEMS(new_timeline))) < 0)
+        goto end;
+    refreshed.timelines_incremental = 1;
+    refreshed.timeline_start        = timeline_start;
+
+    if ((ret = merge_timelines(&refreshed, &old, &c, cur_time)) < 0)
+        goto end;
+
+    printf("timeline:");
+    for (i = 0; i < old.n_timelines; i++)
+        printf(" t=%"PRId64" d=%"PRId64" r=%"PRId64, old.timelines[i]->starttime,
+               old.timelines[i]->duration, old.timelines[i]->repeat);
+    printf("\nsegments:");
+    for (i = old.first_seq_no; i <= old.last_seq_no; i++)
+        printf(" %"PRId64, get_segment_start_time_based_on_timeline(&old, i));
+    printf("\ncur_seq_no: %"PRId64"\n", old.cur_seq_no);
+
+end:
+    free_timelines_list(&old);
+    free_timelines_list(&refreshed);
+    return ret;
+}
+
+int main(void)
+{
+    /* nothing expired, the first entry partly expired, the first entry
+     * expired */
+    if (test_refresh( 0, 35) < 0 ||
+        test_refresh(10, 35) < 0 ||
+        test_refresh(20, 35) < 0)
+        return 1;
+    return 0;
+}
@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() */
 
 #include "avformat.h"
 #include "avio_internal.h"
@@ -70,6 +71,10 @@
 #include "libavutil/thread.h"
 #endif
 
+#if HAVE_LINUX_NET_TSTAMP_H
+#include <linux/net_tstamp.h>
+#endif
+
 #ifndef IPV6_ADD_MEMBERSHIP
 #define IPV6_ADD_MEMBERSHIP IPV6_JOIN_GROUP
 #define IPV6_DROP_MEMBERSHIP IPV6_LEAVE_GROUP
@@ -79,6 +84,44 @@
 #define UDP_RX_BUF_SIZE 393216
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_MAX_RX_BATCH 1024
+#define UDP_MAX_TX_BATCH 1024
+#define UDP_TXTIME_LOOKAHEAD 1000 ///< how early packets are handed to the kernel with txtime, in us
+
+#if HAVE_RECVMMSG && HAVE_PTHREAD_CANCEL && !defined(_WIN32)
+#define UDP_RX_RING 1
+#else
+#define UDP_RX_RING 0
+#endif
+
+#if HAVE_SENDMMSG && HAVE_PTHREAD_CANCEL && !defined(_WIN32)
+#define UDP_TX_MMSG 1
+#else
+#define UDP_TX_MMSG 0
+#endif
+
+#if UDP_TX_MMSG && HAVE_LINUX_NET_TSTAMP_H && defined(SO_TXTIME) && defined(SCM_TXTIME)
+#define UDP_TXTIME 1
+#define UDP_TXTIME_CMSG_SIZE CMSG_SPACE(sizeof(uint64_t))
+#else
+#define UDP_TXTIME 0
+#endif
+
+#if UDP_RX_RING
+#define UDP_RX_RING_ACTIVE(s) ((s)->slots)
+#else
+#define UDP_RX_RING_ACTIVE(s) 0
+#endif
+
+#if UDP_RX_RING
+/**
+ * A datagram received by the batched receiving thread.
+ */
+typedef struct UDPSlot {
+    uint8_t *data;
+    int len;                    ///< -1 if rejected by the source filters
+} UDPSlot;
+#endif
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -102,6 +145,9 @@ typedef struct UDPContext {
     int circular_buffer_error;
     int64_t bitrate; /* number of bits to send per second */
     int64_t burst_bits;
+    int64_t pacer_start;        ///< time from which pacer_bits are counted
+    int64_t pacer_bits;         ///< bits allowed to be sent since pacer_start
+    int64_t pacer_burst;        ///< burst_bits as a duration
     int close_req;
 #if HAVE_PTHREAD_CANCEL
     pthread_t circular_buffer_thread;
@@ -109,7 +155,38 @@ typedef struct UDPContext {
     pthread_cond_t cond;
     int thread_started;
 #endif
+#if UDP_RX_RING
+    /* Ring of datagrams used in place of the fifo when receiving in batches */
+    UDPSlot *slots;
+    struct mmsghdr *msgs;       ///< one per slot, plus one for s->tmp
+    struct iovec *iovs;
+    struct sockaddr_storage *addrs;
+    uint8_t *slot_buf;
+    uint8_t *cmsg_buf;
+    int nb_slots;
+    int slot_size;
+    int slot_head;              ///< next slot to return
+    int slot_count;             ///< slots received and not returned yet
+#endif
+#if UDP_TX_MMSG
+    /* Packets sent together by the circular buffer thread */
+    struct mmsghdr *tx_msgs;
+    struct iovec *tx_iovs;
+    uint8_t *tx_buf;
+    uint8_t *tx_cmsg_buf;
+    int tx_slot_size;
+#endif
+    int tx_batch;
+    int txtime;
+    int rx_batch;
+    uint64_t nb_rx_packets;
+    uint64_t nb_rx_overruns;
+    uint64_t nb_rx_drops;
+    int64_t rx_packets;         ///< exported copies of the counters above
+    int64_t rx_overruns;
+    int64_t rx_drops;
     uint8_t tmp[UDP_MAX_PKT_SIZE+4];
+    int tmp_len;
     int remaining_in_dg;
     char *localaddr;
     int timeout;
@@ -126,6 +203,8 @@ static const AVOption options[] = {
     { "buffer_size",    "System data size (in bytes)",                     OFFSET(buffer_size),    AV_OPT_TYPE_INT,    { .i64 = -1 },    -1, INT_MAX, .flags = D|E },
     { "bitrate",        "Bits to send per second",                         OFFSET(bitrate),        AV_OPT_TYPE_INT64,  { .i64 = 0  },     0, INT64_MAX, .flags = E },
     { "burst_bits",     "Max length of bursts in bits (when using bitrate)", OFFSET(burst_bits),   AV_OPT_TYPE_INT64,  { .i64 = 0  },     0, INT64_MAX, .flags = E },
+    { "tx_batch",       "Max number of packets sent per system call (when using bitrate)", OFFSET(tx_batch), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, UDP_MAX_TX_BATCH, .flags = E },
+    { "txtime",         "Let the kernel send packets at their paced time (when using bitrate)", OFFSET(txtime), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, .flags = E },
     { "localport",      "Local port",                                      OFFSET(local_port),     AV_OPT_TYPE_INT,    { .i64 = -1 },    -1, INT_MAX, D|E },
     { "local_port",     "Local port",                                      OFFSET(local_port),     AV_OPT_TYPE_INT,    { .i64 = -1 },    -1, INT_MAX, .flags = D|E },
     { "localaddr",      "Local address",                                   OFFSET(localaddr),      AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
@@ -138,6 +217,10 @@ static const AVOption options[] = {
     { "connect",        "set if connect() should be called on socket",     OFFSET(is_connected),   AV_OPT_TYPE_BOOL,   { .i64 =  0 },     0, 1,       .flags = D|E },
     { "fifo_size",      "set the UDP receiving circular buffer size, expressed as a number of packets with size of 188 bytes", OFFSET(circular_buffer_size), AV_OPT_TYPE_INT, {.i64 = 7*4096}, 0, INT_MAX, D },
     { "overrun_nonfatal", "survive in case of UDP receiving circular buffer overrun", OFFSET(overrun_nonfatal), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,    D },
+    { "rx_batch",       "set the maximum number of datagrams received per system call into the circular buffer", OFFSET(rx_batch), AV_OPT_TYPE_INT, {.i64 = 0}, 0, UDP_MAX_RX_BATCH, D },
+    { "rx_packets",     "number of datagrams received",                    OFFSET(rx_packets),     AV_OPT_TYPE_INT64,  { .i64 = 0 },      0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "rx_overruns",    "number of datagrams lost because the circular buffer was full", OFFSET(rx_overruns), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "rx_drops",       "number of datagrams dropped by the system because the socket buffer was full", OFFSET(rx_drops), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { "timeout",        "set raise error timeout, in microseconds (only in read mode)",OFFSET(timeout),         AV_OPT_TYPE_INT,  {.i64 = 0}, 0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
@@ -496,9 +579,11 @@ static void *circular_buffer_task_rx( void *_URLContext)
         if (ff_ip_check_source_lists(&addr, &s->filters))
             continue;
         AV_WL32(s->tmp, len);
+        s->nb_rx_packets++;
 
         if(av_fifo_space(s->fifo) < len + 4) {
             /* No Space left */
+            s->nb_rx_overruns++;
             if (s->overrun_nonfatal) {
                 av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
                         "Surviving due to overrun_nonfatal option\n");
@@ -521,72 +606,285 @@ end:
     return NULL;
 }
 
-static void *circular_buffer_task_tx( void *_URLContext)
+#if UDP_RX_RING
+#ifdef SO_RXQ_OVFL
+#define UDP_CMSG_SIZE CMSG_SPACE(sizeof(uint32_t))
+#else
+#define UDP_CMSG_SIZE 0
+#endif
+
+static int rx_ring_alloc(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    int i;
+
+    s->slot_size = s->pkt_size > 0 ? FFMIN(s->pkt_size, UDP_MAX_PKT_SIZE) : UDP_MAX_PKT_SIZE;
+    s->nb_slots  = FFMAX(s->circular_buffer_size / s->slot_size, s->rx_batch);
+
+    s->slots    = av_malloc_array(s->nb_slots, sizeof(*s->slots));
+    s->msgs     = av_mallocz_array(s->nb_slots + 1, sizeof(*s->msgs));
+    s->iovs     = av_malloc_array(s->nb_slots + 1, sizeof(*s->iovs));
+    s->addrs    = av_malloc_array(s->nb_slots + 1, sizeof(*s->addrs));
+    s->slot_buf = av_malloc_array(s->nb_slots, s->slot_size);
+    if (UDP_CMSG_SIZE)
+        s->cmsg_buf = av_mallocz_array(s->nb_slots + 1, UDP_CMSG_SIZE);
+    if (!s->slots || !s->msgs || !s->iovs || !s->addrs || !s->slot_buf ||
+        (UDP_CMSG_SIZE && !s->cmsg_buf))
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i <= s->nb_slots; i++) {
+        struct msghdr *hdr = &s->msgs[i].msg_hdr;
+
+        if (i < s->nb_slots) {
+            s->slots[i].data     = s->slot_buf + (size_t)i * s->slot_size;
+            s->iovs[i].iov_base  = s->slots[i].data;
+            s->iovs[i].iov_len   = s->slot_size;
+        } else {
+            /* spare message used to drain the socket when the ring is full */
+            s->iovs[i].iov_base  = s->tmp;
+            s->iovs[i].iov_len   = sizeof(s->tmp);
+        }
+        hdr->msg_name    = &s->addrs[i];
+        hdr->msg_iov     = &s->iovs[i];
+        hdr->msg_iovlen  = 1;
+        hdr->msg_control = UDP_CMSG_SIZE ? s->cmsg_buf + (size_t)i * UDP_CMSG_SIZE : NULL;
+    }
+
+#ifdef SO_RXQ_OVFL
+    {
+        int one = 1;
+        if (setsockopt(s->udp_fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) < 0)
+            ff_log_net_error(h, AV_LOG_WARNING, "setsockopt(SO_RXQ_OVFL)");
+    }
+#endif
+    return 0;
+}
+
+static void rx_ring_free(UDPContext *s)
+{
+    av_freep(&s->slots);
+    av_freep(&s->msgs);
+    av_freep(&s->iovs);
+    av_freep(&s->addrs);
+    av_freep(&s->slot_buf);
+    av_freep(&s->cmsg_buf);
+}
+
+static void rx_ring_update_drops(UDPContext *s, struct msghdr *hdr)
+{
+#ifdef SO_RXQ_OVFL
+    struct cmsghdr *cmsg;
+
+    for (cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t drops;
+            memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+            s->nb_rx_drops = drops;
+        }
+    }
+#endif
+}
+
+/**
+ * Same as circular_buffer_task_rx(), but receives up to rx_batch datagrams
+ * per system call directly into the slots of the ring.
+ */
+static void *circular_buffer_task_rx_ring(void *_URLContext)
 {
     URLContext *h = _URLContext;
     UDPContext *s = h->priv_data;
-    int64_t target_timestamp = av_gettime_relative();
-    int64_t start_timestamp = av_gettime_relative();
-    int64_t sent_bits = 0;
-    int64_t burst_interval = s->bitrate ? (s->burst_bits * 1000000 / s->bitrate) : 0;
-    int64_t max_delay = s->bitrate ?  ((int64_t)h->max_packet_size * 8 * 1000000 / s->bitrate + 1) : 0;
+    int old_cancelstate;
 
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
     pthread_mutex_lock(&s->mutex);
-
     if (ff_socket_nonblock(s->udp_fd, 0) < 0) {
         av_log(h, AV_LOG_ERROR, "Failed to set blocking mode");
         s->circular_buffer_error = AVERROR(EIO);
         goto end;
     }
+    while(1) {
+        int tail = (s->slot_head + s->slot_count) % s->nb_slots;
+        int n = FFMIN3(s->nb_slots - s->slot_count, s->nb_slots - tail, s->rx_batch);
+        int full = !n;
+        struct mmsghdr *msgs = full ? &s->msgs[s->nb_slots] : &s->msgs[tail];
+        int i, ret;
+
+        if (full)
+            n = 1;
+        for (i = 0; i < n; i++) {
+            msgs[i].msg_hdr.msg_namelen    = sizeof(struct sockaddr_storage);
+            msgs[i].msg_hdr.msg_controllen = UDP_CMSG_SIZE;
+        }
 
-    for(;;) {
-        int len;
-        const uint8_t *p;
-        uint8_t tmp[4];
-        int64_t timestamp;
+        pthread_mutex_unlock(&s->mutex);
+        /* Blocking operations are always cancellation points;
+           see "General Information" / "Thread Cancelation Overview"
+           in Single Unix. */
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
+        ret = recvmmsg(s->udp_fd, msgs, n, MSG_WAITFORONE, NULL);
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
+        pthread_mutex_lock(&s->mutex);
+        if (ret < 0) {
+            if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
+                s->circular_buffer_error = ff_neterrno();
+                goto end;
+            }
+            continue;
+        }
 
-        len = av_fifo_size(s->fifo);
+        for (i = 0; i < ret; i++) {
+            struct msghdr *hdr = &msgs[i].msg_hdr;
+            int accepted = !ff_ip_check_source_lists(hdr->msg_name, &s->filters);
 
-        while (len<4) {
-            if (s->close_req)
-                goto end;
-            if (pthread_cond_wait(&s->cond, &s->mutex) < 0) {
-                goto end;
+            rx_ring_update_drops(s, hdr);
+            if (accepted) {
+                s->nb_rx_packets++;
+                if (hdr->msg_flags & MSG_TRUNC)
+                    av_log(h, AV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
             }
-            len = av_fifo_size(s->fifo);
+            if (full) {
+                if (!accepted)
+                    continue;
+                /* No Space left */
+                s->nb_rx_overruns++;
+                if (s->overrun_nonfatal) {
+                    av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                            "Surviving due to overrun_nonfatal option\n");
+                    continue;
+                } else {
+                    av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                            "To avoid, increase fifo_size URL option. "
+                            "To survive in such case, use overrun_nonfatal option\n");
+                    s->circular_buffer_error = AVERROR(EIO);
+                    goto end;
+                }
+            }
+            s->slots[tail + i].len = accepted ? FFMIN(msgs[i].msg_len, s->slot_size) : -1;
+        }
+        if (!full) {
+            s->slot_count += ret;
+            pthread_cond_signal(&s->cond);
         }
+    }
 
-        av_fifo_generic_read(s->fifo, tmp, 4, NULL);
-        len = AV_RL32(tmp);
+end:
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    return NULL;
+}
+#endif
 
-        av_assert0(len >= 0);
-        av_assert0(len <= sizeof(s->tmp));
+/**
+ * Earliest time at which the next packet may be sent at s->bitrate, with
+ * bursts of up to burst_bits after the output fell behind.
+ */
+static int64_t pacer_departure(const UDPContext *s, int64_t now)
+{
+    int64_t t = s->pacer_start + av_rescale(s->pacer_bits, 1000000, s->bitrate);
+    return FFMAX(t, now);
+}
 
-        av_fifo_generic_read(s->fifo, s->tmp, len, NULL);
+static void pacer_add(UDPContext *s, int64_t now, int len)
+{
+    int64_t t = s->pacer_start + av_rescale(s->pacer_bits, 1000000, s->bitrate);
 
-        pthread_mutex_unlock(&s->mutex);
+    if (t < now - s->pacer_burst) {
+        s->pacer_start = now - s->pacer_burst;
+        s->pacer_bits  = 0;
+    }
+    s->pacer_bits += len * 8;
+}
 
-        if (s->bitrate) {
-            timestamp = av_gettime_relative();
-            if (timestamp < target_timestamp) {
-                int64_t delay = target_timestamp - timestamp;
-                if (delay > max_delay) {
-                    delay = max_delay;
-                    start_timestamp = timestamp + delay;
-                    sent_bits = 0;
-                }
-                av_usleep(delay);
-            } else {
-                if (timestamp - burst_interval > target_timestamp) {
-                    start_timestamp = timestamp - burst_interval;
-                    sent_bits = 0;
-                }
+#if UDP_TX_MMSG
+static int tx_batch_alloc(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    int i;
+
+    s->tx_slot_size = h->max_packet_size > 0 ? h->max_packet_size : UDP_MAX_PKT_SIZE;
+    s->tx_batch     = FFMAX(s->tx_batch, 1);
+    s->tx_msgs      = av_mallocz_array(s->tx_batch, sizeof(*s->tx_msgs));
+    s->tx_iovs      = av_malloc_array(s->tx_batch, sizeof(*s->tx_iovs));
+    s->tx_buf       = av_malloc_array(s->tx_batch, s->tx_slot_size);
+    if (!s->tx_msgs || !s->tx_iovs || !s->tx_buf)
+        return AVERROR(ENOMEM);
+
+#if UDP_TXTIME
+    if (s->txtime) {
+        struct sock_txtime cfg = { .clockid = CLOCK_MONOTONIC };
+
+        if (!av_gettime_relative_is_monotonic() ||
+            setsockopt(s->udp_fd, SOL_SOCKET, SO_TXTIME, &cfg, sizeof(cfg)) < 0) {
+            ff_log_net_error(h, AV_LOG_WARNING, "setsockopt(SO_TXTIME)");
+            s->txtime = 0;
+        } else {
+            s->tx_cmsg_buf = av_mallocz_array(s->tx_batch, UDP_TXTIME_CMSG_SIZE);
+            if (!s->tx_cmsg_buf)
+                return AVERROR(ENOMEM);
+        }
+    }
+#endif
+
+    for (i = 0; i < s->tx_batch; i++) {
+        struct msghdr *hdr = &s->tx_msgs[i].msg_hdr;
+
+        hdr->msg_iov    = &s->tx_iovs[i];
+        hdr->msg_iovlen = 1;
+#if UDP_TXTIME
+        if (s->txtime) {
+            struct cmsghdr *cmsg;
+
+            hdr->msg_control    = s->tx_cmsg_buf + (size_t)i * UDP_TXTIME_CMSG_SIZE;
+            hdr->msg_controllen = UDP_TXTIME_CMSG_SIZE;
+            cmsg = CMSG_FIRSTHDR(hdr);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type  = SCM_TXTIME;
+            cmsg->cmsg_len   = CMSG_LEN(sizeof(uint64_t));
+        }
+#endif
+    }
+    return 0;
+}
+
+static void tx_batch_free(UDPContext *s)
+{
+    av_freep(&s->tx_msgs);
+    av_freep(&s->tx_iovs);
+    av_freep(&s->tx_buf);
+    av_freep(&s->tx_cmsg_buf);
+}
+#endif
+
+static int circular_buffer_send(UDPContext *s, int nb_packets)
+{
+#if UDP_TX_MMSG
+    if (s->tx_msgs) {
+        struct mmsghdr *msgs = s->tx_msgs;
+        int i;
+
+        /* the destination may be changed by ff_udp_set_remote_url() */
+        for (i = 0; i < nb_packets && !s->is_connected; i++) {
+            msgs[i].msg_hdr.msg_name    = &s->dest_addr;
+            msgs[i].msg_hdr.msg_namelen = s->dest_addr_len;
+        }
+        while (nb_packets > 0) {
+            int ret = sendmmsg(s->udp_fd, msgs, nb_packets, 0);
+            if (ret < 0) {
+                ret = ff_neterrno();
+                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                    return ret;
+                continue;
             }
-            sent_bits += len * 8;
-            target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
+            msgs       += ret;
+            nb_packets -= ret;
         }
+        return 0;
+    }
+#endif
+    {
+        const uint8_t *p = s->tmp;
+        int len = s->tmp_len;
 
-        p = s->tmp;
         while (len) {
             int ret;
             av_assert0(len > 0);
@@ -601,13 +899,113 @@ static void *circular_buffer_task_tx( void *_URLContext)
                 p   += ret;
             } else {
                 ret = ff_neterrno();
-                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
-                    pthread_mutex_lock(&s->mutex);
-                    s->circular_buffer_error = ret;
-                    pthread_mutex_unlock(&s->mutex);
-                    return NULL;
+                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                    return ret;
+            }
+        }
+    }
+    return 0;
+}
+
+static void *circular_buffer_task_tx( void *_URLContext)
+{
+    URLContext *h = _URLContext;
+    UDPContext *s = h->priv_data;
+    int64_t lookahead = s->txtime ? UDP_TXTIME_LOOKAHEAD : 0;
+    int64_t burst_bits;
+    int max_batch = 1;
+
+#if UDP_TX_MMSG
+    if (s->tx_msgs)
+        max_batch = s->tx_batch;
+#endif
+    /* Allow sending a whole batch late, so that oversleeping does not
+     * lower the bitrate. */
+    burst_bits     = FFMAX(s->burst_bits, (int64_t)max_batch * h->max_packet_size * 8);
+    s->pacer_start = av_gettime_relative();
+    s->pacer_bits  = 0;
+    s->pacer_burst = s->bitrate ? av_rescale(burst_bits, 1000000, s->bitrate) : 0;
+
+    pthread_mutex_lock(&s->mutex);
+
+    if (ff_socket_nonblock(s->udp_fd, 0) < 0) {
+        av_log(h, AV_LOG_ERROR, "Failed to set blocking mode");
+        s->circular_buffer_error = AVERROR(EIO);
+        goto end;
+    }
+
+    for(;;) {
+        int len, ret, n = 0;
+        uint8_t tmp[4];
+        int64_t now, departure = 0;
+
+        len = av_fifo_size(s->fifo);
+
+        while (len<4) {
+            if (s->close_req)
+                goto end;
+            if (pthread_cond_wait(&s->cond, &s->mutex) < 0) {
+                goto end;
+            }
+            len = av_fifo_size(s->fifo);
+        }
+
+        /* take all packets which are due, up to the batch size */
+        now = av_gettime_relative();
+        while (n < max_batch && av_fifo_size(s->fifo) >= 4) {
+            uint8_t *dst = s->tmp;
+
+            av_fifo_generic_peek(s->fifo, tmp, 4, NULL);
+            len = AV_RL32(tmp);
+
+            av_assert0(len >= 0);
+            av_assert0(len <= sizeof(s->tmp));
+
+            if (s->bitrate) {
+                departure = pacer_departure(s, now);
+                if (departure > now + lookahead)
+                    break;
+            }
+
+#if UDP_TX_MMSG
+            if (s->tx_msgs) {
+                if (len > s->tx_slot_size && n)
+                    break;
+                if (len <= s->tx_slot_size)
+                    dst = s->tx_buf + (size_t)n * s->tx_slot_size;
+                s->tx_iovs[n].iov_base = dst;
+                s->tx_iovs[n].iov_len  = len;
+#if UDP_TXTIME
+                if (s->txtime) {
+                    uint64_t txtime = departure * 1000;
+                    memcpy(CMSG_DATA(CMSG_FIRSTHDR(&s->tx_msgs[n].msg_hdr)),
+                           &txtime, sizeof(txtime));
                 }
+#endif
             }
+#endif
+            /* only count the packet once it is part of the batch, a packet
+             * left for the next batch is paced again then */
+            if (s->bitrate)
+                pacer_add(s, now, len);
+            av_fifo_drain(s->fifo, 4);
+            av_fifo_generic_read(s->fifo, dst, len, NULL);
+            s->tmp_len = len;
+            n++;
+            if (dst == s->tmp)
+                break;
+        }
+
+        pthread_mutex_unlock(&s->mutex);
+
+        if (!n) {
+            /* the next packet is not due yet */
+            av_usleep(departure - lookahead - now);
+        } else if ((ret = circular_buffer_send(s, n)) < 0) {
+            pthread_mutex_lock(&s->mutex);
+            s->circular_buffer_error = ret;
+            pthread_mutex_unlock(&s->mutex);
+            return NULL;
         }
 
         pthread_mutex_lock(&s->mutex);
@@ -699,6 +1097,13 @@ static int udp_open(URLContext *h, const char *uri, int flags)
                        "'circular_buffer_size' option was set but it is not supported "
                        "on this build (pthread support is required)\n");
         }
+        if (av_find_info_tag(buf, sizeof(buf), "rx_batch", p)) {
+            s->rx_batch = av_clip(strtol(buf, NULL, 10), 0, UDP_MAX_RX_BATCH);
+            if (!UDP_RX_RING)
+                av_log(h, AV_LOG_WARNING,
+                       "'rx_batch' option was set but it is not supported "
+                       "on this build (recvmmsg and pthread support are required)\n");
+        }
         if (av_find_info_tag(buf, sizeof(buf), "bitrate", p)) {
             s->bitrate = strtoll(buf, NULL, 10);
             if (!HAVE_PTHREAD_CANCEL)
@@ -709,6 +1114,20 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "burst_bits", p)) {
             s->burst_bits = strtoll(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "tx_batch", p)) {
+            s->tx_batch = av_clip(strtol(buf, NULL, 10), 0, UDP_MAX_TX_BATCH);
+            if (!UDP_TX_MMSG)
+                av_log(h, AV_LOG_WARNING,
+                       "'tx_batch' option was set but it is not supported "
+                       "on this build (sendmmsg and pthread support are required)\n");
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "txtime", p)) {
+            s->txtime = strtol(buf, NULL, 10);
+            if (!UDP_TXTIME)
+                av_log(h, AV_LOG_WARNING,
+                       "'txtime' option was set but it is not supported "
+                       "on this build (SO_TXTIME support is required)\n");
+        }
         if (av_find_info_tag(buf, sizeof(buf), "localaddr", p)) {
             av_strlcpy(localaddr, buf, sizeof(localaddr));
         }
@@ -901,12 +1320,31 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     }
 
     if ((!is_output && s->circular_buffer_size) || (is_output && s->bitrate && s->circular_buffer_size)) {
+        void *(*task)(void *) = is_output ? circular_buffer_task_tx : circular_buffer_task_rx;
+
         /* start the task going */
-        s->fifo = av_fifo_alloc(s->circular_buffer_size);
-        if (!s->fifo) {
-            ret = AVERROR(ENOMEM);
-            goto fail;
+#if UDP_RX_RING
+        if (!is_output && s->rx_batch > 0) {
+            if ((ret = rx_ring_alloc(h)) < 0)
+                goto fail;
+            task = circular_buffer_task_rx_ring;
+        } else
+#endif
+        {
+            s->fifo = av_fifo_alloc(s->circular_buffer_size);
+            if (!s->fifo) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+        }
+        if (!UDP_TXTIME)
+            s->txtime = 0;
+#if UDP_TX_MMSG
+        if (is_output && (s->tx_batch > 0 || s->txtime)) {
+            if ((ret = tx_batch_alloc(h)) < 0)
+                goto fail;
         }
+#endif
         ret = pthread_mutex_init(&s->mutex, NULL);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", strerror(ret));
@@ -919,7 +1357,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             ret = AVERROR(ret);
             goto cond_fail;
         }
-        ret = pthread_create(&s->circular_buffer_thread, NULL, is_output?circular_buffer_task_tx:circular_buffer_task_rx, h);
+        ret = pthread_create(&s->circular_buffer_thread, NULL, task, h);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_create failed : %s\n", strerror(ret));
             ret = AVERROR(ret);
@@ -940,6 +1378,12 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep(&s->fifo);
+#if UDP_RX_RING
+    rx_ring_free(s);
+#endif
+#if UDP_TX_MMSG
+    tx_batch_free(s);
+#endif
     ff_ip_reset_filters(&s->filters);
     return ret;
 }
@@ -963,13 +1407,41 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
 #if HAVE_PTHREAD_CANCEL
     int avail, nonblock = h->flags & AVIO_FLAG_NONBLOCK;
 
-    if (s->fifo) {
+    if (s->fifo || UDP_RX_RING_ACTIVE(s)) {
         pthread_mutex_lock(&s->mutex);
         do {
+            s->rx_packets  = s->nb_rx_packets;
+            s->rx_overruns = s->nb_rx_overruns;
+            s->rx_drops    = s->nb_rx_drops;
+#if UDP_RX_RING
+            if (s->slots) {
+                while (s->slot_count && s->slots[s->slot_head].len < 0) {
+                    s->slot_head = (s->slot_head + 1) % s->nb_slots;
+                    s->slot_count--;
+                }
+                avail = s->slot_count;
+            } else
+#endif
             avail = av_fifo_size(s->fifo);
             if (avail) { // >=size) {
                 uint8_t tmp[4];
 
+#if UDP_RX_RING
+                if (s->slots) {
+                    const UDPSlot *slot = &s->slots[s->slot_head];
+
+                    avail = slot->len;
+                    if (avail > size) {
+                        av_log(h, AV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
+                        avail = size;
+                    }
+                    memcpy(buf, slot->data, avail);
+                    s->slot_head = (s->slot_head + 1) % s->nb_slots;
+                    s->slot_count--;
+                    pthread_mutex_unlock(&s->mutex);
+                    return avail;
+                }
+#endif
                 av_fifo_generic_read(s->fifo, tmp, 4, NULL);
                 avail = AV_RL32(tmp);
                 if(avail > size){
@@ -1015,6 +1487,7 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
         return ff_neterrno();
     if (ff_ip_check_source_lists(&addr, &s->filters))
         return AVERROR(EINTR);
+    s->rx_packets = ++s->nb_rx_packets;
     return ret;
 }
 
@@ -1108,6 +1581,12 @@ static int udp_close(URLContext *h)
 #endif
     closesocket(s->udp_fd);
     av_fifo_freep(&s->fifo);
+#if UDP_RX_RING
+    rx_ring_free(s);
+#endif
+#if UDP_TX_MMSG
+    tx_batch_free(s);
+#endif
     ff_ip_reset_filters(&s->filters);
     return 0;
 }
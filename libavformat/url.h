@@ -33,8 +33,21 @@
 #define URL_PROTOCOL_FLAG_NESTED_SCHEME 1 /*< The protocol name can be the first part of a nested protocol scheme */
 #define URL_PROTOCOL_FLAG_NETWORK       2 /*< The protocol uses network */
 
+/**
+ * Maximum number of buffers that can be passed to ffurl_writev() at once.
+ */
+#define URL_MAX_IOVEC 16
+
 extern const AVClass ffurl_context_class;
 
+/**
+ * One buffer of a scatter-gather write, see ffurl_writev().
+ */
+typedef struct URLIOVec {
+    const uint8_t *base;
+    int len;
+} URLIOVec;
+
 typedef struct URLContext {
     const AVClass *av_class;    /**< information for av_log(). Set by url_open(). */
     const struct URLProtocol *prot;
@@ -77,6 +90,13 @@ typedef struct URLProtocol {
      */
     int     (*url_read)( URLContext *h, unsigned char *buf, int size);
     int     (*url_write)(URLContext *h, const unsigned char *buf, int size);
+    /**
+     * Write the concatenation of nb_vec buffers, e.g. with writev().
+     * Optional; the same rules as for url_write apply, in particular a
+     * short write returns the number of bytes actually written and the
+     * remainder is handled by the calling function, see ffurl_writev().
+     */
+    int     (*url_writev)(URLContext *h, const URLIOVec *vec, int nb_vec);
     int64_t (*url_seek)( URLContext *h, int64_t pos, int whence);
     int     (*url_close)(URLContext *h);
     int (*url_read_pause)(URLContext *h, int pause);
@@ -199,6 +219,16 @@ int ffurl_read_complete(URLContext *h, unsigned char *buf, int size);
  */
 int ffurl_write(URLContext *h, const unsigned char *buf, int size);
 
+/**
+ * Write the concatenation of nb_vec buffers to the resource accessed by h,
+ * using a single scatter-gather call of the protocol when it supports it.
+ *
+ * @param nb_vec number of entries in vec, at most URL_MAX_IOVEC
+ * @return the number of bytes actually written, or a negative value
+ * corresponding to an AVERROR code in case of failure
+ */
+int ffurl_writev(URLContext *h, const URLIOVec *vec, int nb_vec);
+
 /**
  * Change the position that will be used by the next read/write
  * operation on the resource accessed by h.
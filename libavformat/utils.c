@@ -31,6 +31,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "libavutil/timestamp.h"
@@ -47,6 +48,8 @@
 #if CONFIG_NETWORK
 #include "network.h"
 #endif
+#include "packedindex.h"
+#include "probecache.h"
 #include "url.h"
 
 #include "libavutil/ffversion.h"
@@ -648,6 +651,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
     for (i = 0; i < s->nb_streams; i++)
         s->streams[i]->internal->orig_codec_id = s->streams[i]->codecpar->codec_id;
 
+    ff_probe_cache_open(s);
+
     if (options) {
         av_dict_free(options);
         *options = tmp;
@@ -861,6 +866,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
             continue;
         }
 
+        if (!pkt->buf)
+            s->nb_packet_copies++;
         err = av_packet_make_refcounted(pkt);
         if (err < 0) {
             av_packet_unref(pkt);
@@ -1468,6 +1475,7 @@ static int parse_packet(AVFormatContext *s, AVPacket *pkt,
                 goto fail;
             }
         } else {
+            s->nb_packet_copies++;
             ret = av_packet_make_refcounted(out_pkt);
             if (ret < 0)
                 goto fail;
@@ -1943,8 +1951,10 @@ void ff_reduce_index(AVFormatContext *s, int stream_index)
     AVStream *st             = s->streams[stream_index];
     unsigned int max_entries = s->max_index_size / sizeof(AVIndexEntry);
 
-    if ((unsigned) st->nb_index_entries >= max_entries) {
+    if ((unsigned) ff_index_nb_entries(st) >= max_entries) {
         int i;
+        if (ff_index_unpack(st) < 0)
+            return;
         for (i = 0; 2 * i < st->nb_index_entries; i++)
             st->index_entries[i] = st->index_entries[2 * i];
         st->nb_index_entries = i;
@@ -2013,6 +2023,10 @@ int ff_add_index_entry(AVIndexEntry **index_entries,
 int av_add_index_entry(AVStream *st, int64_t pos, int64_t timestamp,
                        int size, int distance, int flags)
 {
+    int ret;
+
+    if ((ret = ff_index_unpack(st)) < 0)
+        return ret;
     timestamp = wrap_timestamp(st, timestamp);
     return ff_add_index_entry(&st->index_entries, &st->nb_index_entries,
                               &st->index_entries_allocated_size, pos,
@@ -2091,13 +2105,13 @@ void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
             if (ist1 == ist2)
                 continue;
 
-            for (i1 = i2 = 0; i1 < st1->nb_index_entries; i1++) {
-                AVIndexEntry *e1 = &st1->index_entries[i1];
+            for (i1 = i2 = 0; i1 < ff_index_nb_entries(st1); i1++) {
+                AVIndexEntry tmp1, *e1 = ff_index_get_entry(st1, i1, &tmp1);
                 int64_t e1_pts = av_rescale_q(e1->timestamp, st1->time_base, AV_TIME_BASE_Q);
 
                 skip = FFMAX(skip, e1->size);
-                for (; i2 < st2->nb_index_entries; i2++) {
-                    AVIndexEntry *e2 = &st2->index_entries[i2];
+                for (; i2 < ff_index_nb_entries(st2); i2++) {
+                    AVIndexEntry tmp2, *e2 = ff_index_get_entry(st2, i2, &tmp2);
                     int64_t e2_pts = av_rescale_q(e2->timestamp, st2->time_base, AV_TIME_BASE_Q);
                     if (e2_pts < e1_pts || e2_pts - (uint64_t)e1_pts < time_tolerance)
                         continue;
@@ -2127,12 +2141,88 @@ void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
     }
 }
 
+int ff_index_pack(AVStream *st)
+{
+    FFPackedIndex *pi;
+
+    if (st->internal->packed_index || !st->nb_index_entries)
+        return 0;
+    pi = ff_packed_index_alloc(st->index_entries, st->nb_index_entries);
+    if (!pi)
+        return AVERROR(ENOMEM);
+    st->internal->packed_index      = pi;
+    st->internal->nb_packed_entries = st->nb_index_entries;
+    av_freep(&st->index_entries);
+    st->nb_index_entries             = 0;
+    st->index_entries_allocated_size = 0;
+    return 0;
+}
+
+int ff_index_unpack(AVStream *st)
+{
+    AVIndexEntry *entries;
+    int i;
+
+    if (!st->internal->packed_index)
+        return 0;
+    entries = av_malloc_array(st->internal->nb_packed_entries, sizeof(*entries));
+    if (!entries)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < st->internal->nb_packed_entries; i++)
+        entries[i] = *ff_packed_index_get(st->internal->packed_index, i);
+    ff_packed_index_free(&st->internal->packed_index);
+    st->index_entries    = entries;
+    st->nb_index_entries = st->internal->nb_packed_entries;
+    st->internal->nb_packed_entries = 0;
+    st->index_entries_allocated_size = st->nb_index_entries * sizeof(*entries);
+    return 0;
+}
+
+int ff_index_nb_entries(const AVStream *st)
+{
+    return st->internal->packed_index ? st->internal->nb_packed_entries
+                                      : st->nb_index_entries;
+}
+
+AVIndexEntry *ff_index_get_entry(AVStream *st, int idx, AVIndexEntry *tmp)
+{
+    if (!st->internal->packed_index)
+        return &st->index_entries[idx];
+    *tmp = *ff_packed_index_get(st->internal->packed_index, idx);
+    return tmp;
+}
+
 int av_index_search_timestamp(AVStream *st, int64_t wanted_timestamp, int flags)
 {
+    if (st->internal->packed_index)
+        return ff_packed_index_search(st->internal->packed_index,
+                                      wanted_timestamp, flags);
     return ff_index_search_timestamp(st->index_entries, st->nb_index_entries,
                                      wanted_timestamp, flags);
 }
 
+int avformat_index_get_entries_count(const AVStream *st)
+{
+    return ff_index_nb_entries(st);
+}
+
+const AVIndexEntry *avformat_index_get_entry(AVStream *st, int idx)
+{
+    if (idx < 0 || idx >= ff_index_nb_entries(st))
+        return NULL;
+    if (st->internal->packed_index)
+        return ff_packed_index_get(st->internal->packed_index, idx);
+    return &st->index_entries[idx];
+}
+
+const AVIndexEntry *avformat_index_get_entry_from_timestamp(AVStream *st,
+                                                            int64_t wanted_timestamp,
+                                                            int flags)
+{
+    return avformat_index_get_entry(st,
+               av_index_search_timestamp(st, wanted_timestamp, flags));
+}
+
 static int64_t ff_read_timestamp(AVFormatContext *s, int stream_index, int64_t *ppos, int64_t pos_limit,
                                  int64_t (*read_timestamp)(struct AVFormatContext *, int , int64_t *, int64_t ))
 {
@@ -2162,15 +2252,15 @@ int ff_seek_frame_binary(AVFormatContext *s, int stream_index,
     pos_limit = -1; // GCC falsely says it may be uninitialized.
 
     st = s->streams[stream_index];
-    if (st->index_entries) {
-        AVIndexEntry *e;
+    if (st->index_entries || st->internal->packed_index) {
+        AVIndexEntry *e, tmp;
 
         /* FIXME: Whole function must be checked for non-keyframe entries in
          * index case, especially read_timestamp(). */
         index = av_index_search_timestamp(st, target_ts,
                                           flags | AVSEEK_FLAG_BACKWARD);
         index = FFMAX(index, 0);
-        e     = &st->index_entries[index];
+        e     = ff_index_get_entry(st, index, &tmp);
 
         if (e->timestamp <= target_ts || e->pos == e->min_distance) {
             pos_min = e->pos;
@@ -2183,9 +2273,9 @@ int ff_seek_frame_binary(AVFormatContext *s, int stream_index,
 
         index = av_index_search_timestamp(st, target_ts,
                                           flags & ~AVSEEK_FLAG_BACKWARD);
-        av_assert0(index < st->nb_index_entries);
+        av_assert0(index < ff_index_nb_entries(st));
         if (index >= 0) {
-            e = &st->index_entries[index];
+            e = ff_index_get_entry(st, index, &tmp);
             av_assert1(e->timestamp >= target_ts);
             pos_max   = e->pos;
             ts_max    = e->timestamp;
@@ -2380,23 +2470,23 @@ static int seek_frame_generic(AVFormatContext *s, int stream_index,
     int index;
     int64_t ret;
     AVStream *st;
-    AVIndexEntry *ie;
+    AVIndexEntry *ie, tmp;
 
     st = s->streams[stream_index];
 
     index = av_index_search_timestamp(st, timestamp, flags);
 
-    if (index < 0 && st->nb_index_entries &&
-        timestamp < st->index_entries[0].timestamp)
+    if (index < 0 && ff_index_nb_entries(st) &&
+        timestamp < ff_index_get_entry(st, 0, &tmp)->timestamp)
         return -1;
 
-    if (index < 0 || index == st->nb_index_entries - 1) {
+    if (index < 0 || index == ff_index_nb_entries(st) - 1) {
         AVPacket *pkt = s->internal->pkt;
         int nonkey = 0;
 
-        if (st->nb_index_entries) {
-            av_assert0(st->index_entries);
-            ie = &st->index_entries[st->nb_index_entries - 1];
+        if (ff_index_nb_entries(st)) {
+            av_assert0(st->index_entries || st->internal->packed_index);
+            ie = ff_index_get_entry(st, ff_index_nb_entries(st) - 1, &tmp);
             if ((ret = avio_seek(s->pb, ie->pos, SEEK_SET)) < 0)
                 return ret;
             ff_update_cur_dts(s, st, ie->timestamp);
@@ -2434,7 +2524,7 @@ static int seek_frame_generic(AVFormatContext *s, int stream_index,
     if (s->iformat->read_seek)
         if (s->iformat->read_seek(s, stream_index, timestamp, flags) >= 0)
             return 0;
-    ie = &st->index_entries[index];
+    ie = ff_index_get_entry(st, index, &tmp);
     if ((ret = avio_seek(s->pb, ie->pos, SEEK_SET)) < 0)
         return ret;
     ff_update_cur_dts(s, st, ie->timestamp);
@@ -3024,6 +3114,7 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st,
     AVSubtitle subtitle;
     AVPacket pkt = *avpkt;
     int do_skip_frame = 0;
+    int fast_probe = s->flags & AVFMT_FLAG_FAST_PROBE;
     enum AVDiscard skip_frame;
 
     if (!frame)
@@ -3073,11 +3164,13 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st,
         avctx->skip_frame = AVDISCARD_ALL;
     }
 
+    /* With fast probing, decode only as long as parameters are missing. */
     while ((pkt.size > 0 || (!pkt.data && got_picture)) &&
            ret >= 0 &&
-           (!has_codec_parameters(st, NULL) || !has_decode_delay_been_guessed(st) ||
+           (!has_codec_parameters(st, NULL) ||
+            !fast_probe && (!has_decode_delay_been_guessed(st) ||
             (!st->codec_info_nb_frames &&
-             (avctx->codec->capabilities & AV_CODEC_CAP_CHANNEL_CONF)))) {
+             (avctx->codec->capabilities & AV_CODEC_CAP_CHANNEL_CONF))))) {
         got_picture = 0;
         if (avctx->codec_type == AVMEDIA_TYPE_VIDEO ||
             avctx->codec_type == AVMEDIA_TYPE_AUDIO) {
@@ -3599,6 +3692,144 @@ static int add_coded_side_data(AVStream *st, AVCodecContext *avctx)
     return 0;
 }
 
+/**
+ * Fill in what the parser of a video stream found in its headers, and
+ * which the decoder would otherwise have to be run for.
+ */
+static void update_stream_avctx_from_parser(AVStream *st)
+{
+    AVCodecContext *avctx = st->internal->avctx;
+    AVCodecParserContext *pc = st->parser;
+
+    if (!pc || avctx->codec_type != AVMEDIA_TYPE_VIDEO)
+        return;
+    if (!avctx->width && pc->width > 0 && pc->height > 0) {
+        avctx->width  = pc->width;
+        avctx->height = pc->height;
+        if (pc->coded_width > 0 && pc->coded_height > 0) {
+            avctx->coded_width  = pc->coded_width;
+            avctx->coded_height = pc->coded_height;
+        }
+    }
+    if (avctx->pix_fmt == AV_PIX_FMT_NONE && pc->format >= 0)
+        avctx->pix_fmt = pc->format;
+}
+
+typedef struct ProbeDecodeContext {
+    AVFormatContext *ic;
+    AVDictionary **options;
+    int orig_nb_streams;
+    AVSliceThread *slicethread;
+    int nb_threads;
+    AVStream **streams;
+    int nb_streams;
+} ProbeDecodeContext;
+
+static void probe_decode_stream(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    ProbeDecodeContext *pd = priv;
+    AVStream *st = pd->streams[jobnr];
+    AVDictionary **options = pd->options && st->index < pd->orig_nb_streams ?
+                             &pd->options[st->index] : NULL;
+    PacketList *pktl;
+
+    for (pktl = st->internal->info->probe_pkts;
+         pktl && !has_codec_parameters(st, NULL); pktl = pktl->next)
+        try_decode_frame(pd->ic, st, &pktl->pkt, options);
+    avpriv_packet_list_free(&st->internal->info->probe_pkts,
+                            &st->internal->info->probe_pkts_end);
+}
+
+/**
+ * Decode the packets queued for fast probing, each stream in a job of
+ * its own. The jobs only touch the state of their stream.
+ */
+static int probe_decode(ProbeDecodeContext *pd)
+{
+    AVFormatContext *ic = pd->ic;
+    AVStream **streams;
+    int i;
+
+    streams = av_realloc_array(pd->streams, ic->nb_streams, sizeof(*streams));
+    if (!streams)
+        return AVERROR(ENOMEM);
+    pd->streams    = streams;
+    pd->nb_streams = 0;
+    for (i = 0; i < ic->nb_streams; i++)
+        if (ic->streams[i]->internal->info->probe_pkts)
+            pd->streams[pd->nb_streams++] = ic->streams[i];
+    if (!pd->nb_streams)
+        return 0;
+
+    if (!pd->nb_threads && pd->nb_streams > 1) {
+        pd->nb_threads = avpriv_slicethread_create(&pd->slicethread, pd,
+                                                   probe_decode_stream, NULL,
+                                                   ic->probe_threads);
+        if (pd->nb_threads < 0)
+            av_log(ic, AV_LOG_VERBOSE,
+                   "Decoding the streams one after the other\n");
+    }
+    if (pd->slicethread && pd->nb_streams > 1) {
+        avpriv_slicethread_execute(pd->slicethread, pd->nb_streams, 0);
+    } else {
+        for (i = 0; i < pd->nb_streams; i++)
+            probe_decode_stream(pd, i, 0, pd->nb_streams, 1);
+    }
+    return 0;
+}
+
+/**
+ * Whether every stream that still lacks parameters, and can be decoded,
+ * has packets queued, so that nothing is gained by reading on first.
+ */
+static int probe_decode_ready(AVFormatContext *ic)
+{
+    int i, queued = 0;
+
+    for (i = 0; i < ic->nb_streams; i++) {
+        AVStream *st = ic->streams[i];
+        if (st->internal->info->probe_pkts)
+            queued = 1;
+        else if (st->internal->info->found_decoder >= 0 &&
+                 !has_codec_parameters(st, NULL))
+            return 0;
+    }
+    return queued;
+}
+
+static int find_stream_info_from_cache(AVFormatContext *ic)
+{
+    int i, ret = ff_probe_cache_get_info(ic);
+
+    if (ret <= 0)
+        return ret;
+    for (i = 0; i < ic->nb_streams; i++) {
+        AVStream *st = ic->streams[i];
+        AVCodecContext *avctx = st->internal->avctx;
+
+        ret = avcodec_parameters_to_context(avctx, st->codecpar);
+        if (ret < 0)
+            return ret;
+        if ((st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ||
+             st->codecpar->codec_type == AVMEDIA_TYPE_SUBTITLE) &&
+            !avctx->time_base.num)
+            avctx->time_base = st->time_base;
+#if FF_API_LAVF_AVCTX
+FF_DISABLE_DEPRECATION_WARNINGS
+        ret = avcodec_parameters_to_context(st->codec, st->codecpar);
+        if (ret < 0)
+            return ret;
+        st->codec->time_base       = avctx->time_base;
+        st->codec->ticks_per_frame = avctx->ticks_per_frame;
+        st->codec->framerate       = st->avg_frame_rate;
+FF_ENABLE_DEPRECATION_WARNINGS
+#endif
+    }
+
+    ret = compute_chapters_end(ic);
+    return ret < 0 ? ret : 1;
+}
+
 int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
 {
     int i, count = 0, ret = 0, j;
@@ -3616,6 +3847,13 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     int64_t probesize = ic->probesize;
     int eof_reached = 0;
     int *missing_streams = av_opt_ptr(ic->iformat->priv_class, ic->priv_data, "missing_streams");
+    int fast_probe = ic->flags & AVFMT_FLAG_FAST_PROBE;
+    ProbeDecodeContext pd = { .ic = ic, .options = options,
+                              .orig_nb_streams = orig_nb_streams };
+    int cache_info = 1;
+
+    if ((ret = find_stream_info_from_cache(ic)))
+        return FFMIN(ret, 0);
 
     flush_codecs = probesize > 0;
 
@@ -3736,6 +3974,12 @@ FF_ENABLE_DEPRECATION_WARNINGS
             break;
         }
 
+        if (fast_probe && probe_decode_ready(ic)) {
+            ret = probe_decode(&pd);
+            if (ret < 0)
+                goto find_stream_info_err;
+        }
+
         /* check if one codec still needs to be handled */
         for (i = 0; i < ic->nb_streams; i++) {
             int fps_analyze_framecount = 20;
@@ -3755,6 +3999,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
                 fps_analyze_framecount = ic->fps_probe_size;
             if (st->disposition & AV_DISPOSITION_ATTACHED_PIC)
                 fps_analyze_framecount = 0;
+            /* the frame rate in the headers is used instead */
+            if (fast_probe && st->internal->avctx->framerate.num > 0)
+                fps_analyze_framecount = 0;
             /* variable fps and no guess at the real fps */
             count = (ic->iformat->flags & AVFMT_NOTIMESTAMPS) ?
                        st->internal->info->codec_info_duration_fields/2 :
@@ -3937,6 +4184,19 @@ FF_ENABLE_DEPRECATION_WARNINGS
                 goto unref_then_goto_end;
         }
 
+        if (fast_probe) {
+            update_stream_avctx_from_parser(st);
+            /* decoded later, together with the other streams */
+            if (!has_codec_parameters(st, NULL) &&
+                st->internal->info->found_decoder >= 0) {
+                ret = avpriv_packet_list_put(&st->internal->info->probe_pkts,
+                                             &st->internal->info->probe_pkts_end,
+                                             (AVPacket *)pkt, av_packet_ref, 0);
+                if (ret < 0)
+                    goto unref_then_goto_end;
+            }
+        }
+
         /* If still no information, we try to open the codec and to
          * decompress the frame. We try to avoid that in most cases as
          * it takes longer and uses more memory. For MPEG-4, we need to
@@ -3946,8 +4206,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+        if (!fast_probe)
+            try_decode_frame(ic, st, pkt,
+                             (options && i < orig_nb_streams) ? &options[i] : NULL);
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
             av_packet_unref(pkt1);
@@ -3956,6 +4217,14 @@ FF_ENABLE_DEPRECATION_WARNINGS
         count++;
     }
 
+    if (fast_probe) {
+        int err = probe_decode(&pd);
+        if (err < 0) {
+            ret = err;
+            goto find_stream_info_err;
+        }
+    }
+
     if (eof_reached) {
         int stream_index;
         for (stream_index = 0; stream_index < ic->nb_streams; stream_index++) {
@@ -4061,6 +4330,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
                               best_fps, 12 * 1001, INT_MAX);
             }
 
+            if (fast_probe && !st->avg_frame_rate.num &&
+                avctx->framerate.num > 0 && avctx->framerate.den > 0)
+                st->avg_frame_rate = avctx->framerate;
+
             if (!st->r_frame_rate.num) {
                 if (    avctx->time_base.den * (int64_t) st->time_base.num
                     <= avctx->time_base.num * (uint64_t)avctx->ticks_per_frame * st->time_base.den) {
@@ -4124,6 +4397,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
         if (!has_codec_parameters(st, &errmsg)) {
             char buf[256];
+            cache_info = 0;
             avcodec_string(buf, sizeof(buf), st->internal->avctx, 0);
             av_log(ic, AV_LOG_WARNING,
                    "Could not find codec parameters for stream %d (%s): %s\n"
@@ -4190,11 +4464,19 @@ FF_ENABLE_DEPRECATION_WARNINGS
         st->internal->avctx_inited = 0;
     }
 
+    if (cache_info)
+        ff_probe_cache_set_info(ic);
+
 find_stream_info_err:
+    avpriv_slicethread_free(&pd.slicethread);
+    av_freep(&pd.streams);
     for (i = 0; i < ic->nb_streams; i++) {
         st = ic->streams[i];
-        if (st->internal->info)
+        if (st->internal->info) {
             av_freep(&st->internal->info->duration_error);
+            avpriv_packet_list_free(&st->internal->info->probe_pkts,
+                                    &st->internal->info->probe_pkts_end);
+        }
         avcodec_close(ic->streams[i]->internal->avctx);
         av_freep(&ic->streams[i]->internal->info);
         av_bsf_free(&ic->streams[i]->internal->extract_extradata.bsf);
@@ -4397,6 +4679,7 @@ static void free_stream(AVStream **pst)
         av_bsf_free(&st->internal->bsfc);
         av_freep(&st->internal->priv_pts);
         av_freep(&st->index_entries);
+        ff_packed_index_free(&st->internal->packed_index);
         av_freep(&st->internal->probe_data.buf);
 
         av_bsf_free(&st->internal->extract_extradata.bsf);
@@ -4443,6 +4726,12 @@ void avformat_free_context(AVFormatContext *s)
     if (s->oformat && s->oformat->deinit && s->internal->initialized)
         s->oformat->deinit(s);
 
+    if (s->nb_packet_copies)
+        av_log(s, AV_LOG_DEBUG, "%"PRId64" packets were copied instead of referenced\n",
+               s->nb_packet_copies);
+
+    ff_probe_cache_close(s);
+
     av_opt_free(s);
     if (s->iformat && s->iformat->priv_class && s->priv_data)
         av_opt_free(s->priv_data);
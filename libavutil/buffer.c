@@ -258,6 +258,7 @@ AVBufferPool *av_buffer_pool_init2(buffer_size_t size, void *opaque,
     pool->alloc     = av_buffer_alloc; // fallback
     pool->pool_free = pool_free;
 
+    atomic_init(&pool->pool, 0);
     atomic_init(&pool->refcount, 1);
 
     return pool;
@@ -274,19 +275,84 @@ AVBufferPool *av_buffer_pool_init(buffer_size_t size, AVBufferRef* (*alloc)(buff
     pool->size     = size;
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
 
+    atomic_init(&pool->pool, 0);
     atomic_init(&pool->refcount, 1);
 
     return pool;
 }
 
+/* The free list head holds its ABA tag, so it needs lock-free 64-bit
+ * atomics, otherwise pushing and popping entries takes the mutex. */
+#if defined(ATOMIC_LLONG_LOCK_FREE) && ATOMIC_LLONG_LOCK_FREE == 2
+#define POOL_LOCK_FREE 1
+#else
+#define POOL_LOCK_FREE 0
+#endif
+
+static BufferPoolEntry *pool_entry(AVBufferPool *pool, unsigned index)
+{
+    unsigned chunk = av_log2(((index - 1) >> POOL_CHUNK_BITS) + 1);
+    return &pool->chunks[chunk][index - 1 + POOL_CHUNK_SIZE - (POOL_CHUNK_SIZE << chunk)];
+}
+
+static void pool_push(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    uint64_t head, new_head;
+
+    if (!POOL_LOCK_FREE)
+        ff_mutex_lock(&pool->mutex);
+
+    head = atomic_load_explicit(&pool->pool, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&buf->next, head & POOL_INDEX_MASK, memory_order_relaxed);
+        new_head = ((head + (1ULL << POOL_INDEX_BITS)) & ~POOL_INDEX_MASK) | buf->index;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->pool, &head, new_head,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+
+    if (!POOL_LOCK_FREE)
+        ff_mutex_unlock(&pool->mutex);
+}
+
+static BufferPoolEntry *pool_pop(AVBufferPool *pool)
+{
+    uint64_t head, new_head;
+    BufferPoolEntry *buf;
+
+    if (!POOL_LOCK_FREE)
+        ff_mutex_lock(&pool->mutex);
+
+    head = atomic_load_explicit(&pool->pool, memory_order_acquire);
+    do {
+        if (!(head & POOL_INDEX_MASK)) {
+            buf = NULL;
+            break;
+        }
+        buf = pool_entry(pool, head & POOL_INDEX_MASK);
+        new_head = ((head + (1ULL << POOL_INDEX_BITS)) & ~POOL_INDEX_MASK) |
+                   atomic_load_explicit(&buf->next, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->pool, &head, new_head,
+                                                    memory_order_acquire,
+                                                    memory_order_acquire));
+
+    if (!POOL_LOCK_FREE)
+        ff_mutex_unlock(&pool->mutex);
+
+    return buf;
+}
+
+/* free the buffers of all the entries currently in the free list */
 static void buffer_pool_flush(AVBufferPool *pool)
 {
-    while (pool->pool) {
-        BufferPoolEntry *buf = pool->pool;
-        pool->pool = buf->next;
+    unsigned index = atomic_exchange_explicit(&pool->pool, 0, memory_order_acquire) &
+                     POOL_INDEX_MASK;
+
+    while (index) {
+        BufferPoolEntry *buf = pool_entry(pool, index);
+        index = atomic_load_explicit(&buf->next, memory_order_relaxed);
 
         buf->free(buf->opaque, buf->data);
-        av_freep(&buf);
+        buf->data = NULL;
     }
 }
 
@@ -296,9 +362,14 @@ static void buffer_pool_flush(AVBufferPool *pool)
  */
 static void buffer_pool_free(AVBufferPool *pool)
 {
+    int i;
+
     buffer_pool_flush(pool);
     ff_mutex_destroy(&pool->mutex);
 
+    for (i = 0; i < POOL_MAX_CHUNKS; i++)
+        av_freep(&pool->chunks[i]);
+
     if (pool->pool_free)
         pool->pool_free(pool->opaque);
 
@@ -314,9 +385,7 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
     pool   = *ppool;
     *ppool = NULL;
 
-    ff_mutex_lock(&pool->mutex);
     buffer_pool_flush(pool);
-    ff_mutex_unlock(&pool->mutex);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -327,13 +396,15 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     BufferPoolEntry *buf = opaque;
     AVBufferPool *pool = buf->pool;
 
-    if(CONFIG_MEMORY_POISONING)
-        memset(buf->data, FF_MEMORY_POISON, pool->size);
+    if (!buf->index) {
+        buf->free(buf->opaque, buf->data);
+        av_free(buf);
+    } else {
+        if(CONFIG_MEMORY_POISONING)
+            memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+        pool_push(pool, buf);
+    }
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -345,24 +416,43 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
 {
     BufferPoolEntry *buf;
     AVBufferRef     *ret;
+    int pooled = pool->nb_entries < POOL_MAX_ENTRIES;
+    unsigned chunk;
 
     av_assert0(pool->alloc || pool->alloc2);
 
+    /* once the pool is full, further buffers get an entry of their own and
+     * are freed instead of being returned to it */
+    if (!pooled) {
+        buf = av_mallocz(sizeof(*buf));
+        if (!buf)
+            return NULL;
+    } else {
+        chunk = av_log2((pool->nb_entries >> POOL_CHUNK_BITS) + 1);
+        if (!pool->chunks[chunk]) {
+            pool->chunks[chunk] = av_mallocz_array(POOL_CHUNK_SIZE << chunk,
+                                                   sizeof(*pool->chunks[chunk]));
+            if (!pool->chunks[chunk])
+                return NULL;
+        }
+        buf = pool_entry(pool, pool->nb_entries + 1);
+    }
+
     ret = pool->alloc2 ? pool->alloc2(pool->opaque, pool->size) :
                          pool->alloc(pool->size);
-    if (!ret)
-        return NULL;
-
-    buf = av_mallocz(sizeof(*buf));
-    if (!buf) {
-        av_buffer_unref(&ret);
+    if (!ret) {
+        if (!pooled)
+            av_free(buf);
         return NULL;
     }
 
+    if (pooled)
+        buf->index = ++pool->nb_entries;
     buf->data   = ret->buffer->data;
     buf->opaque = ret->buffer->opaque;
     buf->free   = ret->buffer->free;
     buf->pool   = pool;
+    atomic_init(&buf->next, 0);
 
     ret->buffer->opaque = buf;
     ret->buffer->free   = pool_release_buffer;
@@ -375,19 +465,17 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
     AVBufferRef *ret;
     BufferPoolEntry *buf;
 
-    ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
+    buf = pool_pop(pool);
     if (buf) {
         ret = av_buffer_create(buf->data, pool->size, pool_release_buffer,
                                buf, 0);
-        if (ret) {
-            pool->pool = buf->next;
-            buf->next = NULL;
-        }
+        if (!ret)
+            pool_push(pool, buf);
     } else {
+        ff_mutex_lock(&pool->mutex);
         ret = pool_alloc_buffer(pool);
+        ff_mutex_unlock(&pool->mutex);
     }
-    ff_mutex_unlock(&pool->mutex);
 
     if (ret)
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
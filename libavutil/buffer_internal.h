@@ -61,6 +61,20 @@ struct AVBuffer {
     int flags_internal;
 };
 
+/**
+ * Entries of a buffer pool are referred to by their index, so that the free
+ * list head can carry an ABA tag next to the index of the top entry in a
+ * single 64-bit atomic. They are stored in chunks allocated on demand, chunk
+ * n holding POOL_CHUNK_SIZE << n entries, so that a small fixed table of
+ * chunks covers the whole 32-bit index range.
+ */
+#define POOL_CHUNK_BITS 4
+#define POOL_CHUNK_SIZE (1 << POOL_CHUNK_BITS)
+#define POOL_MAX_CHUNKS (32 - POOL_CHUNK_BITS)
+#define POOL_MAX_ENTRIES (((1U << POOL_MAX_CHUNKS) - 1) << POOL_CHUNK_BITS)
+#define POOL_INDEX_BITS 32
+#define POOL_INDEX_MASK ((1ULL << POOL_INDEX_BITS) - 1)
+
 typedef struct BufferPoolEntry {
     uint8_t *data;
 
@@ -72,12 +86,36 @@ typedef struct BufferPoolEntry {
     void (*free)(void *opaque, uint8_t *data);
 
     AVBufferPool *pool;
-    struct BufferPoolEntry *next;
+
+    /**
+     * Index of this entry in the pool plus one, 0 for a buffer allocated
+     * outside of the pool once it holds POOL_MAX_ENTRIES entries.
+     */
+    unsigned index;
+
+    /**
+     * Index plus one of the next entry in the free list, 0 for the last one.
+     */
+    atomic_uint next;
 } BufferPoolEntry;
 
 struct AVBufferPool {
+    /**
+     * Protects allocation of new entries. Getting and releasing buffers
+     * already in the pool does not take it, unless 64-bit atomics are not
+     * lock-free.
+     */
     AVMutex mutex;
-    BufferPoolEntry *pool;
+
+    /**
+     * Head of the lock-free free list: index plus one of the top entry in
+     * the low POOL_INDEX_BITS bits, 0 if the list is empty, and a counter
+     * incremented on each update in the upper 32 bits to avoid ABA races.
+     */
+    atomic_uint_least64_t pool;
+
+    BufferPoolEntry *chunks[POOL_MAX_CHUNKS];
+    unsigned nb_entries;
 
     /*
      * This is used to track when the pool is to be freed.
@@ -26,6 +26,7 @@
 #include "config.h"
 #include "opt.h"
 #include "common.h"
+#include "slicethread.h"
 
 #if HAVE_SCHED_GETAFFINITY
 #ifndef _GNU_SOURCE
@@ -320,6 +321,11 @@ int av_cpu_count(void)
     return nb_cpus;
 }
 
+int av_set_shared_thread_pool(int nb_threads)
+{
+    return avpriv_slicethread_set_shared_pool(nb_threads);
+}
+
 size_t av_cpu_max_align(void)
 {
     if (ARCH_MIPS)
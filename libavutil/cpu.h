@@ -119,6 +119,21 @@ int av_parse_cpu_caps(unsigned *flags, const char *s);
  */
 int av_cpu_count(void);
 
+/**
+ * Run the slice threads of codec and filter graph contexts on a single
+ * process-wide pool of worker threads, so that the total number of threads
+ * stays bounded when many contexts are active at once. Only contexts opened
+ * after this call are affected; those that need a dedicated main thread keep
+ * their own workers.
+ *
+ * @param nb_threads number of threads in the pool, 0 for one per logical
+ *                   core, negative to stop using the shared pool for new
+ *                   contexts
+ * @return 0 on success, AVERROR(EBUSY) if a pool already exists, another
+ *         negative AVERROR on failure
+ */
+int av_set_shared_thread_pool(int nb_threads);
+
 /**
  * Get the maximum data alignment that may be required by FFmpeg.
  *
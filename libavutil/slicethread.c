@@ -24,6 +24,8 @@
 
 #if HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS2THREADS
 
+typedef struct SharedPool SharedPool;
+
 typedef struct WorkerContext {
     AVSliceThread   *ctx;
     pthread_mutex_t mutex;
@@ -48,8 +50,36 @@ struct AVSliceThread {
     void            *priv;
     void            (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
     void            (*main_func)(void *priv);
+
+    /* fields below are only used when running on the shared pool and are
+     * protected by its mutex */
+    SharedPool      *shared;
+    AVSliceThread   *next_queued;   ///< next context in the shared pool queue
+    int             queued;
+    int             next_threadnr;  ///< next thread index handed to a runner
+    int             nb_runners;     ///< pool workers currently running jobs
+    pthread_cond_t  shared_cond;
+};
+
+/**
+ * Process-wide pool of worker threads. Contexts attached to it queue
+ * themselves when executing, and idle workers pick jobs from the first
+ * queued context that still has some, so that the total number of threads
+ * stays bounded however many contexts exist.
+ */
+struct SharedPool {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    pthread_t       *threads;
+    int             nb_threads;
+    int             refcount;       ///< attached contexts, plus one while enabled
+    int             finished;
+    AVSliceThread   *queue;
 };
 
+static AVMutex shared_pool_lock = AV_MUTEX_INITIALIZER;
+static SharedPool *shared_pool;
+
 static int run_jobs(AVSliceThread *ctx)
 {
     unsigned nb_jobs    = ctx->nb_jobs;
@@ -91,15 +121,211 @@ static void *attribute_align_arg thread_worker(void *v)
     }
 }
 
+static void shared_pool_dequeue(SharedPool *pool, AVSliceThread *ctx)
+{
+    AVSliceThread **p = &pool->queue;
+
+    if (!ctx->queued)
+        return;
+    while (*p != ctx)
+        p = &(*p)->next_queued;
+    *p = ctx->next_queued;
+    ctx->next_queued = NULL;
+    ctx->queued = 0;
+}
+
+static void run_shared_jobs(AVSliceThread *ctx, int threadnr)
+{
+    unsigned nb_jobs = ctx->nb_jobs;
+    unsigned job;
+
+    while ((job = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs)
+        ctx->worker_func(ctx->priv, job, threadnr, nb_jobs, ctx->nb_active_threads);
+}
+
+static void *attribute_align_arg shared_worker(void *v)
+{
+    SharedPool *pool = v;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (1) {
+        AVSliceThread *ctx;
+        int threadnr;
+
+        while (!pool->finished && !pool->queue)
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+        if (pool->finished)
+            break;
+
+        ctx = pool->queue;
+        threadnr = ctx->next_threadnr++;
+        if (ctx->next_threadnr >= ctx->nb_active_threads)
+            shared_pool_dequeue(pool, ctx);
+        ctx->nb_runners++;
+        pthread_mutex_unlock(&pool->mutex);
+
+        run_shared_jobs(ctx, threadnr);
+
+        pthread_mutex_lock(&pool->mutex);
+        /* all jobs have been handed out, nothing left for other workers */
+        shared_pool_dequeue(pool, ctx);
+        if (!--ctx->nb_runners)
+            pthread_cond_signal(&ctx->shared_cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+static void shared_pool_unref(SharedPool *pool)
+{
+    int i, last;
+
+    pthread_mutex_lock(&pool->mutex);
+    last = !--pool->refcount;
+    if (last) {
+        pool->finished = 1;
+        pthread_cond_broadcast(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    if (!last)
+        return;
+
+    for (i = 0; i < pool->nb_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+    av_freep(&pool->threads);
+    av_free(pool);
+}
+
+int avpriv_slicethread_set_shared_pool(int nb_threads)
+{
+    SharedPool *pool;
+    int i, ret = 0;
+
+    ff_mutex_lock(&shared_pool_lock);
+    if (nb_threads < 0) {
+        if (shared_pool)
+            shared_pool_unref(shared_pool);
+        shared_pool = NULL;
+        goto end;
+    }
+    if (shared_pool) {
+        ret = AVERROR(EBUSY);
+        goto end;
+    }
+
+    if (!nb_threads)
+        nb_threads = av_cpu_count();
+
+    pool = av_mallocz(sizeof(*pool));
+    if (!pool || !(pool->threads = av_calloc(nb_threads, sizeof(*pool->threads)))) {
+        av_free(pool);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    pool->refcount = 1;
+
+    for (i = 0; i < nb_threads; i++) {
+        if ((ret = pthread_create(&pool->threads[i], NULL, shared_worker, pool))) {
+            ret = AVERROR(ret);
+            break;
+        }
+        pool->nb_threads++;
+    }
+    if (ret < 0) {
+        shared_pool_unref(pool);
+        goto end;
+    }
+    shared_pool = pool;
+
+end:
+    ff_mutex_unlock(&shared_pool_lock);
+    return ret;
+}
+
+static int shared_slicethread_create(AVSliceThread *ctx, int nb_threads)
+{
+    ff_mutex_lock(&shared_pool_lock);
+    if (shared_pool) {
+        pthread_mutex_lock(&shared_pool->mutex);
+        shared_pool->refcount++;
+        pthread_mutex_unlock(&shared_pool->mutex);
+        ctx->shared = shared_pool;
+    }
+    ff_mutex_unlock(&shared_pool_lock);
+    if (!ctx->shared)
+        return 0;
+
+    /* the calling thread takes part in executing the jobs */
+    if (!nb_threads)
+        nb_threads = ctx->shared->nb_threads + 1;
+    ctx->nb_threads = FFMIN(nb_threads, ctx->shared->nb_threads + 1);
+    atomic_init(&ctx->current_job, 0);
+    pthread_cond_init(&ctx->shared_cond, NULL);
+    return ctx->nb_threads;
+}
+
+static void shared_slicethread_execute(AVSliceThread *ctx, int nb_jobs)
+{
+    SharedPool *pool = ctx->shared;
+
+    ctx->nb_jobs           = nb_jobs;
+    ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
+    atomic_store_explicit(&ctx->current_job, 0, memory_order_relaxed);
+
+    pthread_mutex_lock(&pool->mutex);
+    /* thread index 0 belongs to the caller */
+    ctx->next_threadnr = 1;
+    if (ctx->next_threadnr < ctx->nb_active_threads) {
+        AVSliceThread **p = &pool->queue;
+        int i;
+
+        while (*p)
+            p = &(*p)->next_queued;
+        *p = ctx;
+        ctx->queued = 1;
+        for (i = ctx->next_threadnr; i < ctx->nb_active_threads; i++)
+            pthread_cond_signal(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    /* The caller keeps running jobs until none is left, so the context
+     * completes even if all the pool workers are busy elsewhere. */
+    run_shared_jobs(ctx, 0);
+
+    pthread_mutex_lock(&pool->mutex);
+    shared_pool_dequeue(pool, ctx);
+    while (ctx->nb_runners)
+        pthread_cond_wait(&ctx->shared_cond, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
                               void (*main_func)(void *priv),
                               int nb_threads)
 {
     AVSliceThread *ctx;
-    int nb_workers, i;
+    int nb_workers, i, ret;
 
     av_assert0(nb_threads >= 0);
+    /* main_func may wait for jobs to progress, which a busy shared pool
+     * can not guarantee */
+    if (nb_threads != 1 && !main_func) {
+        *pctx = ctx = av_mallocz(sizeof(*ctx));
+        if (!ctx)
+            return AVERROR(ENOMEM);
+        ctx->priv        = priv;
+        ctx->worker_func = worker_func;
+        ctx->main_func   = main_func;
+        if ((ret = shared_slicethread_create(ctx, nb_threads)))
+            return ret;
+        av_freep(pctx);
+    }
+
     if (!nb_threads) {
         int nb_cpus = av_cpu_count();
         if (nb_cpus > 1)
@@ -166,6 +392,11 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
     int nb_workers, i, is_last = 0;
 
     av_assert0(nb_jobs > 0);
+    if (ctx->shared) {
+        shared_slicethread_execute(ctx, nb_jobs);
+        return;
+    }
+
     ctx->nb_jobs           = nb_jobs;
     ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
     atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
@@ -205,6 +436,13 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
         return;
 
     ctx = *pctx;
+    if (ctx->shared) {
+        shared_pool_unref(ctx->shared);
+        pthread_cond_destroy(&ctx->shared_cond);
+        av_freep(pctx);
+        return;
+    }
+
     nb_workers = ctx->nb_threads;
     if (!ctx->main_func)
         nb_workers--;
@@ -252,4 +490,9 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
     av_assert0(!pctx || !*pctx);
 }
 
+int avpriv_slicethread_set_shared_pool(int nb_threads)
+{
+    return nb_threads < 0 ? 0 : AVERROR(ENOSYS);
+}
+
 #endif /* HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS32THREADS */
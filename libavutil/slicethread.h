@@ -43,6 +43,16 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
  */
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main);
 
+/**
+ * Create or destroy the process-wide pool of worker threads. While it
+ * exists, contexts created by avpriv_slicethread_create() without main_func
+ * and with nb_threads != 1 run their jobs on it instead of their own threads.
+ * @param nb_threads number of worker threads, 0 for automatic,
+ *                   negative to destroy the pool once its contexts are freed
+ * @return 0 on success, negative AVERROR on failure
+ */
+int avpriv_slicethread_set_shared_pool(int nb_threads);
+
 /**
  * Destroy slice threading context.
  * @param pctx pointer to context
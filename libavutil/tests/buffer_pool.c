@@ -0,0 +1,236 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program gets and releases buffers of a shared AVBufferPool from
+ * several threads at once and checks that no buffer is ever handed out twice,
+ * both when each thread releases its own buffers and when buffers are
+ * released by another thread than the one which got them. It also checks that a pool holding many buffers at once hands out distinct
+ * ones. When given an argument, it also reports the time per get/release pair for
+ * an increasing number of threads.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+#include "libavutil/time.h"
+
+#define MAX_THREADS 16
+#define HANDOFF_PAIRS 4
+#define BUFS_PER_THREAD 4
+#define ITERATIONS 100000
+#define MANY_BUFS 1000
+
+typedef struct ThreadArg {
+    AVBufferPool *pool;
+    int id;
+    int iterations;
+    int errors;
+} ThreadArg;
+
+static void *thread_main(void *opaque)
+{
+    ThreadArg *arg = opaque;
+    AVBufferRef *bufs[BUFS_PER_THREAD];
+    int i, j;
+
+    for (i = 0; i < arg->iterations; i++) {
+        for (j = 0; j < BUFS_PER_THREAD; j++) {
+            bufs[j] = av_buffer_pool_get(arg->pool);
+            if (!bufs[j]) {
+                arg->errors++;
+                break;
+            }
+            memset(bufs[j]->data, arg->id, bufs[j]->size);
+        }
+        while (j--) {
+            if (bufs[j]->data[0] != arg->id ||
+                bufs[j]->data[bufs[j]->size - 1] != arg->id)
+                arg->errors++;
+            av_buffer_unref(&bufs[j]);
+        }
+    }
+    return NULL;
+}
+
+static int run(int nb_threads, int iterations, int64_t *time)
+{
+    AVBufferPool *pool = av_buffer_pool_init(64, NULL);
+    pthread_t threads[MAX_THREADS];
+    ThreadArg args[MAX_THREADS];
+    int64_t start;
+    int i, ret, errors = 0;
+
+    if (!pool)
+        return -1;
+
+    start = av_gettime_relative();
+    for (i = 0; i < nb_threads; i++) {
+        args[i] = (ThreadArg){ pool, i + 1, iterations, 0 };
+        if ((ret = pthread_create(&threads[i], NULL, thread_main, &args[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            return -1;
+        }
+    }
+    for (i = 0; i < nb_threads; i++) {
+        pthread_join(threads[i], NULL);
+        errors += args[i].errors;
+    }
+    *time = av_gettime_relative() - start;
+
+    av_buffer_pool_uninit(&pool);
+    return errors;
+}
+
+typedef struct HandoffArg {
+    AVBufferPool *pool;
+    AVThreadMessageQueue *queue;
+    int id;
+    int iterations;
+    int producer_errors;
+    int consumer_errors;
+} HandoffArg;
+
+/* fill buffers and pass them to the consumer thread, which releases them */
+static void *producer_main(void *opaque)
+{
+    HandoffArg *arg = opaque;
+    AVBufferRef *buf;
+    int i;
+
+    for (i = 0; i < arg->iterations; i++) {
+        buf = av_buffer_pool_get(arg->pool);
+        if (!buf) {
+            arg->producer_errors++;
+            break;
+        }
+        memset(buf->data, arg->id, buf->size);
+        memcpy(buf->data, &i, sizeof(i));
+        if (av_thread_message_queue_send(arg->queue, &buf, 0) < 0) {
+            av_buffer_unref(&buf);
+            arg->producer_errors++;
+            break;
+        }
+    }
+    av_thread_message_queue_set_err_recv(arg->queue, AVERROR_EOF);
+    return NULL;
+}
+
+static void *consumer_main(void *opaque)
+{
+    HandoffArg *arg = opaque;
+    AVBufferRef *buf;
+    int i;
+
+    for (i = 0; av_thread_message_queue_recv(arg->queue, &buf, 0) >= 0; i++) {
+        if (memcmp(buf->data, &i, sizeof(i)) ||
+            buf->data[buf->size - 1] != arg->id)
+            arg->consumer_errors++;
+        av_buffer_unref(&buf);
+    }
+    if (i != arg->iterations)
+        arg->consumer_errors++;
+    return NULL;
+}
+
+/* pairs of threads sharing one pool, where each buffer is released by
+ * another thread than the one which got it */
+static int run_handoff(int nb_pairs, int iterations)
+{
+    AVBufferPool *pool = av_buffer_pool_init(64, NULL);
+    pthread_t threads[2 * MAX_THREADS];
+    HandoffArg args[MAX_THREADS];
+    int i, ret, errors = 0;
+
+    if (!pool)
+        return -1;
+
+    for (i = 0; i < nb_pairs; i++) {
+        args[i] = (HandoffArg){ pool, NULL, i + 1, iterations, 0, 0 };
+        if (av_thread_message_queue_alloc(&args[i].queue, 8, sizeof(AVBufferRef *)) < 0)
+            return -1;
+        if ((ret = pthread_create(&threads[2 * i],     NULL, producer_main, &args[i])) ||
+            (ret = pthread_create(&threads[2 * i + 1], NULL, consumer_main, &args[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            return -1;
+        }
+    }
+    for (i = 0; i < nb_pairs; i++) {
+        pthread_join(threads[2 * i],     NULL);
+        pthread_join(threads[2 * i + 1], NULL);
+        errors += args[i].producer_errors + args[i].consumer_errors;
+        av_thread_message_queue_free(&args[i].queue);
+    }
+
+    av_buffer_pool_uninit(&pool);
+    return errors;
+}
+
+/* hold many buffers at once, so that entries span several chunks */
+static int run_many(void)
+{
+    AVBufferPool *pool = av_buffer_pool_init(sizeof(int), NULL);
+    AVBufferRef *bufs[MANY_BUFS];
+    int i, j, errors = 0;
+
+    if (!pool)
+        return -1;
+
+    for (j = 0; j < 2; j++) {
+        for (i = 0; i < MANY_BUFS; i++) {
+            bufs[i] = av_buffer_pool_get(pool);
+            if (!bufs[i])
+                return -1;
+            memcpy(bufs[i]->data, &i, sizeof(i));
+        }
+        for (i = 0; i < MANY_BUFS; i++) {
+            if (memcmp(bufs[i]->data, &i, sizeof(i)))
+                errors++;
+            av_buffer_unref(&bufs[i]);
+        }
+    }
+
+    av_buffer_pool_uninit(&pool);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    int64_t time;
+    int nb_threads;
+
+    if (run_many() || run(4, ITERATIONS / 10, &time) ||
+        run_handoff(HANDOFF_PAIRS, ITERATIONS / 10))
+        return 1;
+
+    if (argc < 2)
+        return 0;
+
+    for (nb_threads = 1; nb_threads <= MAX_THREADS; nb_threads *= 2) {
+        if (run(nb_threads, ITERATIONS, &time))
+            return 1;
+        printf("%2d threads: %6.1f ns per get/release\n", nb_threads,
+               time * 1000.0 / ((int64_t)ITERATIONS * BUFS_PER_THREAD));
+    }
+    return 0;
+}
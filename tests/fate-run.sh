@@ -110,6 +110,35 @@ probechapters(){
     run ffprobe${PROGSUF}${EXECSUF} -show_chapters "$@"
 }
 
+probecache(){
+    cachedir="${outdir}/${test}.cache"
+    logfile="${outdir}/${test}.cachelog"
+    cleanfiles="$cleanfiles $logfile"
+    rm -rf "$cachedir"
+    mkdir -p "$cachedir" || return
+    # the first run fills the cache, the second one must read from it
+    run ffprobe${PROGSUF}${EXECSUF} -bitexact -v 0 -probe_cache $(target_path $cachedir) "$@" || return
+    run ffprobe${PROGSUF}${EXECSUF} -bitexact -v verbose -probe_cache $(target_path $cachedir) "$@" 2> "$logfile" || return
+    grep -o "Read the [a-z ]* from the probe cache" "$logfile"
+}
+
+# remux a file with the given options, then print its streams as probed
+# normally and the differences found with -fflags +fastprobe
+fastprobe(){
+    src="$1"
+    remux_opts="$2"
+    shift 2
+    remuxed="${outdir}/${test}.remux"
+    probefile="${outdir}/${test}.probe"
+    fastfile="${outdir}/${test}.fastprobe"
+    cleanfiles="$cleanfiles $remuxed $probefile $fastfile"
+    ffmpeg -i $src -c copy $remux_opts -y $(target_path $remuxed) || return
+    run ffprobe${PROGSUF}${EXECSUF} -bitexact -v 0 "$@" -i $(target_path $remuxed) > "$probefile" || return
+    run ffprobe${PROGSUF}${EXECSUF} -bitexact -v 0 -fflags +fastprobe "$@" -i $(target_path $remuxed) > "$fastfile" || return
+    cat "$probefile"
+    diff -u "$probefile" "$fastfile"
+}
+
 probegaplessinfo(){
     filename="$1"
     shift
@@ -155,6 +184,16 @@ md5pipe(){
     ffmpeg "$@" md5:
 }
 
+# keep the final JSON progress report, one key per line, with the timings
+# masked out
+progress_json(){
+    ffmpeg -progress pipe:1 -progress_format json -stats_period 3600 "$@" -f null - |
+        grep '"progress":"end"' |
+        sed -E -e 's/"(elapsed_us|speed|time_us|avg_us|max_us)":(null|[0-9.]+)/"\1":X/g' \
+               -e 's/"(hist|queue_hist)":\[[0-9,]*\]/"\1":[X]/g' |
+        tr ',' '\n'
+}
+
 md5(){
     encfile="${outdir}/${test}.out"
     cleanfiles="$cleanfiles $encfile"
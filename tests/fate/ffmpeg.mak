@@ -41,6 +41,30 @@ fate-ffmpeg-filter_colorkey: CMD = framecrc -auto_conversion_filters -idct simpl
 FATE_FFMPEG-$(CONFIG_COLOR_FILTER) += fate-ffmpeg-lavfi
 fate-ffmpeg-lavfi: CMD = framecrc -lavfi color=d=1:r=5 -fflags +bitexact
 
+# The encoder and muxer threads must not change the output.
+FATE_FFMPEG-$(call ALLYES, TESTSRC2_FILTER SINE_FILTER MPEG4_ENCODER PCM_S16LE_ENCODER) += fate-ffmpeg-pipeline_threads-off fate-ffmpeg-pipeline_threads
+fate-ffmpeg-pipeline_threads-off: CMD = framecrc -filter_complex "testsrc2=d=1:r=25[v];sine=d=1[a]" -map "[v]" -map "[a]" -c:v mpeg4 -qscale:v 4 -c:a pcm_s16le
+fate-ffmpeg-pipeline_threads: CMD = framecrc -pipeline_threads -pipeline_queue_size 2 -filter_complex "testsrc2=d=1:r=25[v];sine=d=1[a]" -map "[v]" -map "[a]" -c:v mpeg4 -qscale:v 4 -c:a pcm_s16le
+fate-ffmpeg-pipeline_threads: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-pipeline_threads-off
+
+# Two outputs that share one filtergraph must get the frames they would
+# get from their own graphs.
+FATE_FFMPEG-$(call ALLYES, RAWVIDEO_DEMUXER RAWVIDEO_DECODER SCALE_FILTER RAWVIDEO_ENCODER FRAMECRC_MUXER MD5_PROTOCOL) += fate-ffmpeg-filter_sharing-off fate-ffmpeg-filter_sharing
+fate-ffmpeg-filter_sharing-off fate-ffmpeg-filter_sharing: tests/data/vsynth1.yuv
+fate-ffmpeg-filter_sharing-off: CMD = ffmpeg -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+  -vf scale=176:144 -sws_flags +accurate_rnd+bitexact -c:v rawvideo -fflags +bitexact -flags +bitexact -f framecrc md5: \
+  -vf scale=176:144 -sws_flags +accurate_rnd+bitexact -c:v rawvideo -fflags +bitexact -flags +bitexact -t 0.4 -f framecrc md5:
+fate-ffmpeg-filter_sharing: CMD = ffmpeg -filter_sharing -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+  -vf scale=176:144 -sws_flags +accurate_rnd+bitexact -c:v rawvideo -fflags +bitexact -flags +bitexact -f framecrc md5: \
+  -vf scale=176:144 -sws_flags +accurate_rnd+bitexact -c:v rawvideo -fflags +bitexact -flags +bitexact -t 0.4 -f framecrc md5:
+fate-ffmpeg-filter_sharing: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-filter_sharing-off
+
+# The keys of the final JSON progress report, with the timings masked.
+FATE_FFMPEG-$(call ALLYES, PCM_S16LE_DEMUXER PCM_S16LE_DECODER TESTSRC2_FILTER FORMAT_FILTER RAWVIDEO_ENCODER PCM_S16LE_ENCODER NULL_MUXER) += fate-ffmpeg-progress_json
+fate-ffmpeg-progress_json: $(AREF)
+fate-ffmpeg-progress_json: CMD = progress_json -f s16le -ar 44100 -ac 2 -i $(TARGET_PATH)/$(AREF) \
+  -filter_complex "testsrc2=d=1:r=10,format=yuv420p[v]" -map "[v]" -map 0:a -c:v rawvideo -c:a pcm_s16le
+
 FATE_SAMPLES_FFMPEG-$(CONFIG_RAWVIDEO_DEMUXER) += fate-force_key_frames
 fate-force_key_frames: tests/data/vsynth_lena.yuv
 fate-force_key_frames: CMD = enc_dec \
@@ -126,6 +126,9 @@ FATE_FILTER-$(call ALLYES, MINTERPOLATE_FILTER TESTSRC2_FILTER) += fate-filter-m
 fate-filter-minterpolate-up: CMD = framecrc -lavfi testsrc2=r=2:d=10,minterpolate=fps=10 -t 1
 fate-filter-minterpolate-down: CMD = framecrc -lavfi testsrc2=r=2:d=10,minterpolate=fps=1 -t 1
 
+FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER SINE_FILTER HFLIP_FILTER SCALE_FILTER ARESAMPLE_FILTER) += fate-filter-frame-recycle
+fate-filter-frame-recycle: CMD = framecrc -filter_complex "testsrc2=r=7:d=2,hflip,scale=160:120:flags=bicubic+accurate_rnd+bitexact[v];sine=d=2,aresample=22050[a]" -map "[v]" -map "[a]"
+
 FATE_FILTER_VSYNTH-$(CONFIG_BOXBLUR_FILTER) += fate-filter-boxblur
 fate-filter-boxblur: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf boxblur=2:1
 
@@ -211,6 +214,14 @@ FATE_FILTER_VSYNTH-$(CONFIG_VSTACK_FILTER) += fate-filter-vstack
 fate-filter-vstack: tests/data/filtergraphs/vstack
 fate-filter-vstack: CMD = framecrc -c:v pgmyuv -i $(SRC) -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/vstack
 
+FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER HFLIP_FILTER VFLIP_FILTER NEGATE_FILTER HSTACK_FILTER) += fate-filter-frame-threads
+fate-filter-frame-threads: tests/data/filtergraphs/frame-threads
+fate-filter-frame-threads: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_complex_threads 4 -filter_thread_type slice+frame -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/frame-threads
+
+FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER HFLIP_FILTER VFLIP_FILTER NEGATE_FILTER HSTACK_FILTER) += fate-filter-shared-threads
+fate-filter-shared-threads: tests/data/filtergraphs/frame-threads
+fate-filter-shared-threads: CMD = framecrc -shared_threads 2 -c:v pgmyuv -i $(SRC) -filter_complex_threads 4 -filter_thread_type slice+frame -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/frame-threads
+
 FATE_FILTER_VSYNTH-$(CONFIG_OVERLAY_FILTER) += fate-filter-overlay
 fate-filter-overlay: tests/data/filtergraphs/overlay
 fate-filter-overlay: CMD = framecrc -c:v pgmyuv -i $(SRC) -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/overlay
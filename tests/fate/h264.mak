@@ -188,7 +188,19 @@ FATE_H264_REINIT_TESTS := large_420_8-to-small_420_8                    \
                           small_420_9-to-small_420_8                    \
                           small_422_9-to-small_420_9                    \
 
+# multi-slice streams decoded with frame and slice threads combined
+FATE_H264_FRAME_SLICE_THREADS := ba1_ft_c                               \
+                                 ba_mw_d                                \
+                                 ci1_ft_b                               \
+
+# single-slice streams with the loop filter on its own slice thread
+FATE_H264_DEBLOCK_THREAD := cabac_mot_fld0_full                         \
+                            camp_mot_mbaff_l30                          \
+                            sva_ba1_b                                   \
+
 FATE_H264  := $(FATE_H264:%=fate-h264-conformance-%)                    \
+              $(FATE_H264_FRAME_SLICE_THREADS:%=fate-h264-conformance-%-frame-slice-threads) \
+              $(FATE_H264_DEBLOCK_THREAD:%=fate-h264-conformance-%-deblock-thread) \
               $(FATE_H264_REINIT_TESTS:%=fate-h264-reinit-%)            \
               fate-h264-extreme-plane-pred                              \
               fate-h264-intra-refresh-recovery                          \
@@ -421,6 +433,16 @@ fate-h264-conformance-sva_fm1_e:                  CMD = framecrc -i $(TARGET_SAM
 fate-h264-conformance-sva_nl1_b:                  CMD = framecrc -i $(TARGET_SAMPLES)/h264-conformance/SVA_NL1_B.264
 fate-h264-conformance-sva_nl2_e:                  CMD = framecrc -i $(TARGET_SAMPLES)/h264-conformance/SVA_NL2_E.264
 
+fate-h264-conformance-ba1_ft_c-frame-slice-threads: CMD = threads=4 thread_type=frame+slice framecrc -frame_threads 2 -framerate 19 -i $(TARGET_SAMPLES)/h264-conformance/BA1_FT_C.264
+fate-h264-conformance-ba_mw_d-frame-slice-threads:  CMD = threads=4 thread_type=frame+slice framecrc -frame_threads 2 -i $(TARGET_SAMPLES)/h264-conformance/BA_MW_D.264
+fate-h264-conformance-ci1_ft_b-frame-slice-threads: CMD = threads=4 thread_type=frame+slice framecrc -frame_threads 2 -i $(TARGET_SAMPLES)/h264-conformance/CI1_FT_B.264
+fate-h264-conformance-%-frame-slice-threads:        REF = $(SRC_PATH)/tests/ref/fate/$(@:fate-%-frame-slice-threads=%)
+
+fate-h264-conformance-cabac_mot_fld0_full-deblock-thread: CMD = threads=2 thread_type=slice framecrc -deblock_thread 1 -i $(TARGET_SAMPLES)/h264-conformance/camp_mot_fld0_full.26l
+fate-h264-conformance-camp_mot_mbaff_l30-deblock-thread:  CMD = threads=2 thread_type=slice framecrc -deblock_thread 1 -i $(TARGET_SAMPLES)/h264-conformance/CAMP_MOT_MBAFF_L30.26l
+fate-h264-conformance-sva_ba1_b-deblock-thread:           CMD = threads=2 thread_type=slice framecrc -deblock_thread 1 -i $(TARGET_SAMPLES)/h264-conformance/SVA_BA1_B.264
+fate-h264-conformance-%-deblock-thread:                   REF = $(SRC_PATH)/tests/ref/fate/$(@:fate-%-deblock-thread=%)
+
 fate-h264-bsf-mp4toannexb:                        CMD = md5 -i $(TARGET_SAMPLES)/h264/interlaced_crop.mp4 -c:v copy -f h264
 
 fate-h264-crop-to-container:                      CMD = framemd5 -i $(TARGET_SAMPLES)/h264/crop-to-container-dims-canon.mov
@@ -230,6 +230,32 @@ FATE_HEVC_LARGE += fate-hevc-conformance-$(1)
 fate-hevc-conformance-$(1): CMD = framecrc -flags unaligned -i $(TARGET_SAMPLES)/hevc-conformance/$(1).bit -pix_fmt yuv444p12le -vf scale
 endef
 
+# WPP streams decoded with frame and slice threads combined
+HEVC_SAMPLES_FRAME_SLICE_THREADS = \
+    WPP_A_ericsson_MAIN_2       \
+    WPP_B_ericsson_MAIN_2       \
+    WPP_C_ericsson_MAIN_2       \
+    WPP_D_ericsson_MAIN_2       \
+    WPP_E_ericsson_MAIN_2       \
+    WPP_F_ericsson_MAIN_2       \
+
+define FATE_HEVC_TEST_FRAME_SLICE_THREADS
+FATE_HEVC += fate-hevc-conformance-$(1)-frame-slice-threads
+fate-hevc-conformance-$(1)-frame-slice-threads: CMD = threads=4 thread_type=frame+slice framecrc -frame_threads 2 -flags unaligned -i $(TARGET_SAMPLES)/hevc-conformance/$(1).bit -pix_fmt yuv420p
+fate-hevc-conformance-$(1)-frame-slice-threads: REF = $(SRC_PATH)/tests/ref/fate/hevc-conformance-$(1)
+endef
+
+# tile streams whose tiles are decoded in parallel by slice threads
+HEVC_SAMPLES_SLICE_THREADS = \
+    TILES_A_Cisco_2             \
+    TILES_B_Cisco_1             \
+
+define FATE_HEVC_TEST_SLICE_THREADS
+FATE_HEVC += fate-hevc-conformance-$(1)-slice-threads
+fate-hevc-conformance-$(1)-slice-threads: CMD = threads=4 thread_type=slice framecrc -flags unaligned -i $(TARGET_SAMPLES)/hevc-conformance/$(1).bit -pix_fmt yuv420p
+fate-hevc-conformance-$(1)-slice-threads: REF = $(SRC_PATH)/tests/ref/fate/hevc-conformance-$(1)
+endef
+
 $(foreach N,$(HEVC_SAMPLES),$(eval $(call FATE_HEVC_TEST,$(N))))
 $(foreach N,$(HEVC_SAMPLES_10BIT),$(eval $(call FATE_HEVC_TEST_10BIT,$(N))))
 $(foreach N,$(HEVC_SAMPLES_422_10BIT),$(eval $(call FATE_HEVC_TEST_422_10BIT,$(N))))
@@ -238,6 +264,8 @@ $(foreach N,$(HEVC_SAMPLES_422_10BIN_LARGE),$(eval $(call FATE_HEVC_TEST_422_10B
 $(foreach N,$(HEVC_SAMPLES_444_8BIT),$(eval $(call FATE_HEVC_TEST_444_8BIT,$(N))))
 $(foreach N,$(HEVC_SAMPLES_444_12BIT),$(eval $(call FATE_HEVC_TEST_444_12BIT,$(N))))
 $(foreach N,$(HEVC_SAMPLES_444_12BIT_LARGE),$(eval $(call FATE_HEVC_TEST_444_12BIT_LARGE,$(N))))
+$(foreach N,$(HEVC_SAMPLES_FRAME_SLICE_THREADS),$(eval $(call FATE_HEVC_TEST_FRAME_SLICE_THREADS,$(N))))
+$(foreach N,$(HEVC_SAMPLES_SLICE_THREADS),$(eval $(call FATE_HEVC_TEST_SLICE_THREADS,$(N))))
 
 fate-hevc-paramchange-yuv420p-yuv420p10: CMD = framecrc -vsync 0 -i $(TARGET_SAMPLES)/hevc/paramchange_yuv420p_yuv420p10.hevc -sws_flags area+accurate_rnd+bitexact
 FATE_HEVC_LARGE += fate-hevc-paramchange-yuv420p-yuv420p10
@@ -63,6 +63,17 @@ FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILT
 fate-hls-segment-single: tests/data/hls_segment_single.m3u8
 fate-hls-segment-single: CMD = framecrc -auto_conversion_filters -flags +bitexact -i $(TARGET_PATH)/tests/data/hls_segment_single.m3u8 -vf setpts=N*23
 
+# same playlists, with segments downloaded ahead by the demuxer
+FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-hls-segment-size-prefetch
+fate-hls-segment-size-prefetch: tests/data/hls_segment_size.m3u8
+fate-hls-segment-size-prefetch: CMD = framecrc -auto_conversion_filters -flags +bitexact -prefetch 2 -prefetch_buffer_size 4096 -i $(TARGET_PATH)/tests/data/hls_segment_size.m3u8 -vf setpts=N*23
+fate-hls-segment-size-prefetch: REF = $(SRC_PATH)/tests/ref/fate/hls-segment-size
+
+FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-hls-segment-single-prefetch
+fate-hls-segment-single-prefetch: tests/data/hls_segment_single.m3u8
+fate-hls-segment-single-prefetch: CMD = framecrc -auto_conversion_filters -flags +bitexact -prefetch 2 -prefetch_buffer_size 4096 -i $(TARGET_PATH)/tests/data/hls_segment_single.m3u8 -vf setpts=N*23
+fate-hls-segment-single-prefetch: REF = $(SRC_PATH)/tests/ref/fate/hls-segment-single
+
 tests/data/hls_init_time.m3u8: TAG = GEN
 tests/data/hls_init_time.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
 	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
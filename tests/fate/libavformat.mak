@@ -2,6 +2,10 @@
 #fate-async: libavformat/tests/async$(EXESUF)
 #fate-async: CMD = run libavformat/tests/async
 
+FATE_LIBAVFORMAT-$(CONFIG_DASH_DEMUXER) += fate-dashdec
+fate-dashdec: libavformat/tests/dashdec$(EXESUF)
+fate-dashdec: CMD = run libavformat/tests/dashdec$(EXESUF)
+
 FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/tests/noproxy$(EXESUF)
 fate-noproxy: CMD = run libavformat/tests/noproxy$(EXESUF)
@@ -111,8 +111,14 @@ fate-matroska-mpegts-remux: CMD = transcode mpegts $(TARGET_SAMPLES)/mpegts/pmtc
 FATE_MATROSKA_FFPROBE-$(call ALLYES, MATROSKA_DEMUXER) += fate-matroska-spherical-mono
 fate-matroska-spherical-mono: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -show_entries stream_side_data_list -select_streams v -v 0 $(TARGET_SAMPLES)/mkv/spherical.mkv
 
+# Open the same file twice with a probe cache, seeking to use the index
+FATE_MATROSKA_LAVF_FFPROBE-$(call ENCDEC2, MPEG4, MP2, MATROSKA) += fate-matroska-probe-cache
+fate-matroska-probe-cache: fate-lavf-mkv
+fate-matroska-probe-cache: CMD = probecache -show_entries stream=codec_name,width,height,sample_rate:packet=stream_index,pts,dts,pos,flags -read_intervals 0.5%+0.2 $(TARGET_PATH)/tests/data/lavf/lavf.mkv
+
 FATE_SAMPLES_AVCONV += $(FATE_MATROSKA-yes)
 FATE_SAMPLES_FFPROBE += $(FATE_MATROSKA_FFPROBE-yes)
 FATE_SAMPLES_FFMPEG_FFPROBE += $(FATE_MATROSKA_FFMPEG_FFPROBE-yes)
+FATE_FFPROBE += $(FATE_MATROSKA_LAVF_FFPROBE-yes)
 
-fate-matroska: $(FATE_MATROSKA-yes) $(FATE_MATROSKA_FFPROBE-yes) $(FATE_MATROSKA_FFMPEG_FFPROBE-yes)
+fate-matroska: $(FATE_MATROSKA-yes) $(FATE_MATROSKA_FFPROBE-yes) $(FATE_MATROSKA_FFMPEG_FFPROBE-yes) $(FATE_MATROSKA_LAVF_FFPROBE-yes)
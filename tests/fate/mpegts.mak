@@ -22,4 +22,17 @@ fate-mpegts-probe-pmt-merge: CMD = run $(PROBE_CODEC_NAME_COMMAND) -merge_pmt_ve
 
 FATE_SAMPLES_FFPROBE += $(FATE_MPEGTS_PROBE-yes)
 
-fate-mpegts: $(FATE_MPEGTS_PROBE-yes)
+
+# The MPEG-4 parser does not find the pixel format and no parser finds the
+# sample format, so both streams have to be decoded by the fast probe.
+FATE_MPEGTS_FFPROBE-$(call ALLYES, MPEG4_ENCODER MPEG4_DECODER MP2_ENCODER MP2_DECODER \
+                                   MATROSKA_MUXER MATROSKA_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER \
+                                   DUMP_EXTRADATA_BSF) += fate-mpegts-fastprobe
+fate-mpegts-fastprobe: fate-lavf-mkv
+fate-mpegts-fastprobe: CMD = fastprobe $(TARGET_PATH)/tests/data/lavf/lavf.mkv "-bsf:v dump_extra -f mpegts" \
+    -show_entries stream=codec_name,width,height,sample_aspect_ratio,pix_fmt,avg_frame_rate,sample_fmt,sample_rate,channels,channel_layout \
+    -print_format default
+
+FATE_FFPROBE += $(FATE_MPEGTS_FFPROBE-yes)
+
+fate-mpegts: $(FATE_MPEGTS_PROBE-yes) $(FATE_MPEGTS_FFPROBE-yes)
@@ -246,18 +246,54 @@ fate-seek-lavf-y4m:      SRC = lavf/lavf.y4m
 
 FATE_SEEK += $(FATE_SEEK_LAVF-yes:%=fate-seek-lavf-%)
 
+# same files, read through the io_uring read-ahead of the file protocol
+
+FATE_SEEK_IO_URING-$(CONFIG_FILE_PROTOCOL) += $(filter mkv mov mxf ts, $(FATE_SEEK_LAVF-yes))
+FATE_SEEK_IO_URING = $(FATE_SEEK_IO_URING-yes:%=fate-seek-io_uring-lavf-%)
+
+$(FATE_SEEK_IO_URING): fate-seek-io_uring-lavf-%: fate-lavf-% libavformat/tests/seek$(EXESUF)
+$(FATE_SEEK_IO_URING): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.$(@:fate-seek-io_uring-lavf-%=%) -io_uring 1 -io_uring_block_size 4096
+$(FATE_SEEK_IO_URING): REF = $(SRC_PATH)/tests/ref/seek/lavf-$(@:fate-seek-io_uring-lavf-%=%)
+
+FATE_AVCONV += $(FATE_SEEK_IO_URING)
+
+# same files, read through a memory mapping
+
+FATE_SEEK_MMAP-$(CONFIG_FILE_PROTOCOL) += $(filter mkv mov mxf ts, $(FATE_SEEK_LAVF-yes))
+FATE_SEEK_MMAP = $(FATE_SEEK_MMAP-yes:%=fate-seek-mmap-lavf-%)
+
+$(FATE_SEEK_MMAP): fate-seek-mmap-lavf-%: fate-lavf-% libavformat/tests/seek$(EXESUF)
+$(FATE_SEEK_MMAP): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.$(@:fate-seek-mmap-lavf-%=%) -mmap 1
+$(FATE_SEEK_MMAP): REF = $(SRC_PATH)/tests/ref/seek/lavf-$(@:fate-seek-mmap-lavf-%=%)
+
+FATE_AVCONV += $(FATE_SEEK_MMAP)
+
+# same files, with the index kept packed
+
+FATE_SEEK_COMPACT_INDEX-yes += $(filter mov, $(FATE_SEEK_LAVF-yes))
+FATE_SEEK_COMPACT_INDEX = $(FATE_SEEK_COMPACT_INDEX-yes:%=fate-seek-compact_index-lavf-%)
+
+$(FATE_SEEK_COMPACT_INDEX): fate-seek-compact_index-lavf-%: fate-lavf-% libavformat/tests/seek$(EXESUF)
+$(FATE_SEEK_COMPACT_INDEX): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.$(@:fate-seek-compact_index-lavf-%=%) -compact_index 1
+$(FATE_SEEK_COMPACT_INDEX): REF = $(SRC_PATH)/tests/ref/seek/lavf-$(@:fate-seek-compact_index-lavf-%=%)
+
+FATE_AVCONV += $(FATE_SEEK_COMPACT_INDEX)
+
 # extra files
 
 FATE_SEEK_EXTRA-$(CONFIG_MP3_DEMUXER)   += fate-seek-extra-mp3
 FATE_SEEK_EXTRA-$(call ALLYES, CACHE_PROTOCOL PIPE_PROTOCOL MP3_DEMUXER) += fate-seek-cache-pipe
 FATE_SEEK_EXTRA-$(CONFIG_MATROSKA_DEMUXER) += fate-seek-mkv-codec-delay
 FATE_SEEK_EXTRA-$(CONFIG_MOV_DEMUXER) += fate-seek-extra-mp4
+FATE_SEEK_EXTRA-$(CONFIG_MOV_DEMUXER) += fate-seek-lazy-index-mp4
 FATE_SEEK_EXTRA-$(CONFIG_MOV_DEMUXER) += fate-seek-empty-edit-mp4
 FATE_SEEK_EXTRA-$(CONFIG_MOV_DEMUXER) += fate-seek-test-iibbibb-mp4
 FATE_SEEK_EXTRA-$(CONFIG_MOV_DEMUXER) += fate-seek-test-iibbibb-neg-ctts-mp4
 
 fate-seek-extra-mp3:  CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_SAMPLES)/gapless/gapless.mp3 -fastseek 1
 fate-seek-extra-mp4:  CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_SAMPLES)/mov/buck480p30_na.mp4 -duration 180 -frames 4
+fate-seek-lazy-index-mp4: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_SAMPLES)/mov/buck480p30_na.mp4 -duration 180 -frames 4 -lazy_index 64
+fate-seek-lazy-index-mp4: REF = $(SRC_PATH)/tests/ref/seek/extra-mp4
 fate-seek-empty-edit-mp4:  CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_SAMPLES)/mov/empty_edit_5s.mp4 -duration 15 -frames 4
 fate-seek-test-iibbibb-mp4:  CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_SAMPLES)/mov/test_iibbibb.mp4 -duration 13 -frames 4
 fate-seek-test-iibbibb-neg-ctts-mp4:  CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_SAMPLES)/mov/test_iibbibb_neg_ctts.mp4 -duration 13 -frames 4
@@ -275,4 +311,4 @@ fate-seek-%: REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%=%)
 
 FATE_AVCONV += $(FATE_SEEK)
 FATE_SAMPLES_AVCONV += $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
-fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
+fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_IO_URING) $(FATE_SEEK_MMAP)